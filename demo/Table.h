@@ -7,14 +7,22 @@
 #include <circle.h>
 #include <cmath>
 #include <complex>
+#include <cstddef>
 #include <cstdint>
+#include <fof.h>
+#include <kahan.h>
 #include <newton.h>
 #include <optional>
+#include <packed.h>
+#include <query.h>
+#include <span>
 #include <type_traits>
 #include <utility>
 #include <vector>
 #include <verlet.h>
 
+#include "numa.h"
+
 namespace phy {
 
 struct Particle {
@@ -77,8 +85,8 @@ class Table : public std::vector<Particle> {
     /// Radius [L] and mass [M].
     float radius{}, mass{};
 
-    /// First particle.
-    I first;
+    /// First and past-the-last particles.
+    I first, last;
 
     /// Has many particles?
     bool many{};
@@ -91,7 +99,7 @@ class Table : public std::vector<Particle> {
     Physicals() = default;
 
     /// Given a range of particles (with an `xy` field), compute the quantities.
-    Physicals(I const first, I const last) : first{first} {
+    Physicals(I const first, I const last) : first{first}, last{last} {
       std::complex<double> xyd;
       unsigned char count{}; // (Only used to decide many particles vs. single.)
       for (auto i = first; i != last; ++i) {
@@ -120,6 +128,7 @@ class Table : public std::vector<Particle> {
       radius = std::max(radius, p.radius + std::abs(p.xy - xy));
       // No need to update `first`:
       // Assume that mergers come "in order."
+      last = p.last;
       return *this;
     }
 
@@ -127,17 +136,51 @@ class Table : public std::vector<Particle> {
     [[nodiscard]] dyn::Circle<float> circle() const { return {xy, radius}; }
   };
 
-  /// @brief Given a Barnes-Hut tree and a circle that represents a particle,
-  /// compute the acceleration onto the particle due to the data in the tree.
-  std::complex<float> accelerate(auto &&tree, dyn::Circle<> circle, auto i) {
+  /// @brief The tree built by the latest `step`, kept for queries until the
+  /// next one (see `visible`). Its groups describe the particles as they were
+  /// before the step; all particles have moved by at most `drift` [L] since.
+  /// A copy of a table does not get the tree (it refers to the original's
+  /// particles); a moved table keeps it.
+  struct Built {
+    using I = std::vector<Particle>::iterator;
+    using E = Physicals<I>;
+    dyn::bh32::Tree<E, I> root;
+    /// The same, packed for the force walk of `step` (see packed.h).
+    dyn::bh32::Packed packed;
+    /// The particles the tree was built over.
+    Particle const *data{};
+    size_t size{};
+    float drift{};
+
+    Built() = default;
+    Built(Built &&) noexcept = default;
+    Built &operator=(Built &&) noexcept = default;
+    Built(Built const &) noexcept {}
+    Built &operator=(Built const &) noexcept { return *this = Built{}; }
+  } built;
+
+  /// @brief The storage of the particles as `index` last placed it, and
+  /// whether the storage of the packed tree is placed (see `first_touch`).
+  struct {
+    Particle const *data{};
+    size_t size{};
+    bool tree{};
+  } placed;
+
+  /// @brief Given a packed Barnes-Hut tree and a circle that represents a
+  /// particle (whose node is `self`), compute the acceleration onto the
+  /// particle due to the data in the tree.
+  std::complex<float> accelerate(dyn::bh32::Packed const &tree,
+                                 dyn::Circle<> circle, uint32_t self) const {
     std::complex<float> a{};
-    tree->depth_first([this, circle, i, &a](auto &&group) {
+    tree.depth_first([this, circle, self, &a](dyn::bh32::View const &group) {
       auto const TRUNCATE = false;
       auto const square = [](auto x) { return x * x; };
-      if (!group.many && group.first == i)
+      if (!group.many && group.node == self)
         // Exclude self-interactions.
         return TRUNCATE;
-      auto norm = std::norm(group.xy - circle), rsq = square(group.radius);
+      auto norm = std::norm(group.circle - circle),
+           rsq = square(group.circle.radius);
       // If a non-singular group either:
       //  - contains the center of `circle` inside said group's circle, or
       //  - if circles are overlapping, resolve more detail, or
@@ -149,21 +192,61 @@ class Table : public std::vector<Particle> {
       // Compute the acceleration due to the group.
       // Also, insert the value of G, the universal gravitational constant, in a
       // way that doesn't stress the single-precision dynamic range.
-      a += gravity.field(circle, group.circle(), G * group.mass,
+      a += gravity.field(circle, group.circle, G * group.mass,
                          std::sqrt(norm));
       return TRUNCATE;
     });
     return a;
   }
 
+  /// @brief Given a Barnes-Hut tree and a circle that represents a particle,
+  /// compute the potential [LL/T/T] at the particle due to the data in the
+  /// tree: the potential of what `accelerate` sums, group by group.
+  float potential(auto &&tree, dyn::Circle<> circle, auto i) const {
+    float phi{};
+    tree->depth_first([this, circle, i, &phi](auto &&group) {
+      auto const square = [](auto x) { return x * x; };
+      if (!group.many && group.first == i)
+        return false;
+      auto norm = std::norm(group.xy - circle), rsq = square(group.radius);
+      // (The same criterion as `accelerate`.)
+      if (group.many && (norm < rsq || norm < square(circle.radius) ||
+                         square(tan_angle_threshold) < rsq / norm))
+        return true;
+      phi += gravity.potential(circle, group.circle(), G * group.mass,
+                               std::sqrt(norm));
+      return false;
+    });
+    return phi;
+  }
+
 public:
+  /// @brief The data of the groups of a tree over particles held elsewhere,
+  /// of any type with `xy`, `mass`, and `radius` (see view.h).
+  template <class I> using Moments = Physicals<I>;
+
   /// @brief Universal gravitational constant [LLL/M/T/T]. Modify freely.
   float G{1.0f};
   float tan_angle_threshold{0.12278456f}; // tan(7 deg)
 
-  /// @brief Perform an integration step.
-  /// @param dt Step size [units: T].
-  void step(float dt) noexcept {
+  /// @brief Before each step, merge the particles whose centers are closer
+  /// than this fraction of the sum of their radii (0 never to; see
+  /// `accrete`).
+  float accretion{};
+
+  /// @brief Number of particles merged away so far.
+  uint64_t accreted{};
+
+  /// @brief Have the threads of `step` write the particles and the packed
+  /// tree first (when they are moved to new storage), each its share, so that
+  /// on machines of several NUMA nodes they are near the threads that read
+  /// them most (see numa.h). With one node, nothing is placed.
+  bool first_touch{};
+
+  /// @brief Sort the particles in Z-order and build a tree over them, as
+  /// `step` does, for the queries (`visible`, `range`, `within`, `nearest`)
+  /// to use before the first step or after adding or removing particles.
+  void index() noexcept {
     namespace bh = dyn::bh32;
 
     // Compute the Morton code of all particles.
@@ -172,6 +255,11 @@ public:
     // Sort the particles in Z-order.
     std::ranges::stable_sort(begin(), end(), {},
                              [](auto &&p) { return p.morton; });
+    auto const placing = first_touch && numa::several();
+    if (placing && (placed.data != data() || placed.size != size())) {
+      numa::place(std::span{data(), size()});
+      placed.data = data(), placed.size = size();
+    }
 
     // Apply bitwise AND with the mask (m) to the particle (p).
     auto morton_masked = [](auto &&p, auto m) -> std::optional<uint64_t> {
@@ -182,30 +270,462 @@ public:
     };
 
     // Compute the Barnes-Hut tree over the particles this has.
-    using E = Physicals<decltype(begin())>;
-    auto const tree = bh::tree<E>(begin(), end(), morton_masked);
+    // (Drop the previous one first, to keep one tree in memory at a time, but
+    // for the storage of the packed one, which is packed again, in place.)
+    using E = typename Built::E;
+    auto packed = std::move(built.packed);
+    built = {};
+    built.root = bh::tree<E>(begin(), end(), morton_masked);
+    if (packed.pack(built.root, begin()))
+      placed.tree = false;
+    if (placing && !placed.tree) {
+      packed.place([](auto s) { numa::place(s); });
+      placed.tree = true;
+    }
+    built.packed = std::move(packed);
+    built.data = data(), built.size = size();
+  }
+
+  /// @brief Perform an integration step. The result does not depend on the
+  /// number of threads: the tree is built by one thread, and the forces on
+  /// each particle are summed by one thread in the order of the tree walk.
+  /// @param dt Step size [units: T].
+  void step(float dt) noexcept {
+    index();
+    // Merge deeply overlapping particles (if asked), and index what is left.
+    if (accretion > 0.0f && accrete())
+      index();
+    // Measure (if asked) while the tree and the particles agree.
+    if (measure)
+      measured = conserved(), measure = false;
+    auto const &tree = built.packed;
 
     // Iterate over the particles, summing up their forces.
-    auto const b = begin();
     auto const m = static_cast<int>(size());
     auto n = 0;
-#pragma omp parallel for
+    auto drift = 0.0f;
+    // (In contiguous chunks, as `first_touch` places them.)
+#pragma omp parallel for schedule(static) reduction(max : drift)
     for (n = 0; n < m; ++n) {
       auto &&p = (*this)[n];
       // Supposing that particle p is located at the position xy below, instead
       // of p's own xy, what is the acceleration experienced by p due to all the
       // other particles or approximations (g)?
       auto ig = Integrator{p.xy, p.v};
-      ig.step(dt, [this, &tree, &p, b, n](auto xy) {
-        return this->accelerate(tree, {xy, p.radius}, b + n);
+      auto const self = tree.leaf(size_t(n));
+      ig.step(dt, [this, &tree, &p, self](auto xy) {
+        return this->accelerate(tree, {xy, p.radius}, self);
       });
+      drift = std::max(drift, std::abs(ig.y0 - p.xy));
       p.xy = ig.y0, p.v = ig.y1;
     }
+    built.drift = drift;
+  }
+
+  /// @brief Forget the tree of the latest step. Call this after adding,
+  /// removing, or reordering particles other than through `step` if `visible`
+  /// is to be called before the next step. (Changes of the size or of the
+  /// storage are detected without it.)
+  void forget_tree() noexcept { built = {}; }
+
+  /// @brief Whether the tree of the latest step (or `index`) is there for the
+  /// queries to use. Without it, they test every particle.
+  [[nodiscard]] bool indexed() const noexcept {
+    return built.root && built.data == data() && built.size == size();
+  }
+
+  /// @brief Find what is visible in the rectangle with the less-less (ll) and
+  /// greater-greater (gg) corners, using the tree of the latest step to skip
+  /// whole groups of particles that are out of view.
+  /// @param lod Level of detail [L]: a visible group whose radius is under
+  /// this is reported as a whole (0 to always report particles).
+  /// @param particle Called with each visible particle.
+  /// @param group Called with the circle and the mass of each group reported
+  /// as a whole.
+  void visible(std::complex<float> ll, std::complex<float> gg, float lod,
+               auto &&particle, auto &&group) const {
+    namespace intersect = dyn::intersect;
+    auto constexpr FEW = 16;
+    if (!indexed()) {
+      // No tree to use. Test every particle.
+      for (auto &&p : *this)
+        if (intersect::disk_rectangle(p.circle(), ll, gg))
+          particle(p);
+      return;
+    }
+    built.root->depth_first([&](auto &&g) {
+      // Where the particles of the group may have moved since.
+      auto c = g.circle();
+      c.radius += built.drift;
+      if (!intersect::disk_rectangle(c, ll, gg))
+        return false;
+      if (!g.many) {
+        // A single particle: test where it is now.
+        if (intersect::disk_rectangle(g.first->circle(), ll, gg))
+          particle(*g.first);
+        return false;
+      }
+      if (c.radius < lod) {
+        group(c, g.mass);
+        return false;
+      }
+      // A group all in view: report its particles without looking further,
+      // unless the level of detail could merge some of them. (Merging a few
+      // particles is not worth looking further.)
+      auto const r = c.radius;
+      auto const inside =
+          ll.real() <= c.real() - r && c.real() + r <= gg.real() &&
+          ll.imag() <= c.imag() - r && c.imag() + r <= gg.imag();
+      if (inside && (lod <= 0.0f || g.last - g.first <= FEW)) {
+        for (auto i = g.first; i != g.last; ++i)
+          particle(*i);
+        return false;
+      }
+      return true;
+    });
+  }
+
+  /// @brief Visit each particle whose center is in the rectangle with the
+  /// less-less (ll) and greater-greater (gg) corners.
+  void range(std::complex<float> ll, std::complex<float> gg,
+             auto &&visit) const {
+    if (indexed())
+      return dyn::bh32::range(built.root, ll, gg, visit, built.drift);
+    for (auto &&p : *this)
+      if (ll.real() <= p.xy.real() && p.xy.real() <= gg.real() &&
+          ll.imag() <= p.xy.imag() && p.xy.imag() <= gg.imag())
+        visit(p);
+  }
+
+  /// @brief Visit each particle whose center is within `radius` [L] of xy.
+  void within(std::complex<float> xy, float radius, auto &&visit) const {
+    if (indexed())
+      return dyn::bh32::within(built.root, xy, radius, visit, built.drift);
+    for (auto &&p : *this)
+      if (std::norm(p.xy - xy) <= radius * radius)
+        visit(p);
+  }
+
+  /// @brief Find the indices of the k particles nearest to xy (fewer if there
+  /// are fewer), nearest first.
+  [[nodiscard]] std::vector<size_t> nearest(std::complex<float> xy,
+                                            size_t k) const {
+    std::vector<size_t> v;
+    if (indexed()) {
+      std::vector<typename Built::I> found;
+      dyn::bh32::nearest(built.root, xy, k, found, built.drift);
+      for (auto i : found)
+        v.push_back(size_t(&*i - data()));
+      return v;
+    }
+    v.resize(size());
+    for (size_t i = 0; i < size(); i++)
+      v[i] = i;
+    auto const nearer = [this, xy](size_t i, size_t j) {
+      return std::norm((*this)[i].xy - xy) < std::norm((*this)[j].xy - xy);
+    };
+    k = std::min(k, size());
+    std::ranges::partial_sort(v, v.begin() + ptrdiff_t(k), nearer);
+    v.resize(k);
+    return v;
+  }
+
+  /// @brief Find the pairs of particles whose disks overlap, as indices
+  /// (i, j) with i < j, each pair once. Without the tree of the latest step,
+  /// build one first (see `index`; the particles are reordered).
+  [[nodiscard]] std::vector<std::pair<size_t, size_t>> overlaps() {
+    if (!indexed())
+      index();
+    std::vector<std::pair<typename Built::I, typename Built::I>> found;
+    dyn::bh32::overlaps(built.root, found, built.drift);
+    std::vector<std::pair<size_t, size_t>> v;
+    v.reserve(found.size());
+    auto const b = begin();
+    for (auto [i, j] : found)
+      v.emplace_back(size_t(i - b), size_t(j - b));
+    return v;
+  }
+
+  /// @brief What `map` samples: the gravitational potential [LL/T/T] or the
+  /// magnitude of the gravitational field [L/T/T].
+  enum class Map : uint8_t { potential, field };
+
+  /// @brief Sample the potential or the field on a grid of w by h points: the
+  /// centers of the cells of the rectangle with the less-less (ll) and
+  /// greater-greater (gg) corners, row by row from ll. The particles are
+  /// taken as the packed tree of the latest step has them, groups and
+  /// particles alike: where they were at its start. Without a tree, build one
+  /// first (see `index`).
+  ///
+  /// The grid is split into tiles of 8 by 8 points, evaluated in parallel.
+  /// The points of a tile share a list of the groups and particles to sum
+  /// over, made by the acceptance criterion of `step` as it would be at the
+  /// point of the tile nearest to each group.
+  /// @param out Set to the w * h samples (its storage is reused).
+  void map(Map what, std::complex<float> ll, std::complex<float> gg, int w,
+           int h, std::vector<float> &out) {
+    auto constexpr TILE = 8;
+    if (!indexed())
+      index();
+    w = std::max(w, 0), h = std::max(h, 0);
+    out.assign(size_t(w) * size_t(h), 0.0f);
+    if (!built.root)
+      return;
+    auto const cell = std::complex{(gg.real() - ll.real()) / float(w),
+                                   (gg.imag() - ll.imag()) / float(h)};
+    auto const tw = (w + TILE - 1) / TILE, th = (h + TILE - 1) / TILE;
+    auto const m = tw * th;
+    auto n = 0;
+#pragma omp parallel for schedule(dynamic, 4)
+    for (n = 0; n < m; ++n) {
+      auto const x0 = n % tw * TILE, y0 = n / tw * TILE;
+      auto const x1 = std::min(x0 + TILE, w), y1 = std::min(y0 + TILE, h);
+      auto const point = [ll, cell](int x, int y) {
+        return ll + std::complex{(float(x) + 0.5f) * cell.real(),
+                                 (float(y) + 0.5f) * cell.imag()};
+      };
+      // The circle through the tile's corner points.
+      auto const center = 0.5f * (point(x0, y0) + point(x1 - 1, y1 - 1));
+      auto const reach = std::abs(point(x0, y0) - center);
+
+      // What the points of the tile interact with: circles and masses.
+      std::vector<std::pair<dyn::Circle<float>, float>> list;
+      built.packed.depth_first([&](dyn::bh32::View const &g) {
+        auto const square = [](auto x) { return x * x; };
+        if (!g.many) {
+          list.emplace_back(g.circle, g.mass);
+          return false;
+        }
+        // The nearest point of the tile may be this close to the group.
+        auto const d = std::abs(g.circle - center) - reach;
+        auto const rsq = square(g.circle.radius);
+        if (d <= 0.0f || square(d) < rsq ||
+            square(tan_angle_threshold) * square(d) < rsq)
+          return true;
+        list.emplace_back(g.circle, g.mass);
+        return false;
+      });
+
+      for (auto y = y0; y < y1; y++)
+        for (auto x = x0; x < x1; x++) {
+          auto const xy = point(x, y);
+          auto &&o = out[size_t(y) * size_t(w) + size_t(x)];
+          if (what == Map::potential) {
+            auto phi = 0.0f;
+            for (auto &&[c, mass] : list)
+              phi += gravity.potential(xy, c, mass);
+            o = G * phi;
+          } else {
+            std::complex<float> a{};
+            for (auto &&[c, mass] : list)
+              a += gravity.field({xy, 0.0f}, c, mass);
+            o = G * std::abs(a);
+          }
+        }
+    }
+  }
+
+  /// @brief Find the clusters of particles by friends-of-friends (see
+  /// `dyn::fof`), with the indices of the particles. Without the tree of the
+  /// latest step, build one first (see `index`; the particles are reordered).
+  /// @param linking Linking length [L].
+  /// @param min_members Report only clusters of at least this many particles.
+  [[nodiscard]] dyn::fof::Catalog clusters(float linking,
+                                           size_t min_members = 1) {
+    if (!indexed())
+      index();
+    return dyn::fof::clusters(built.root, linking, min_members, built.drift);
+  }
+
+  /// @brief Merge each pair of particles whose centers are closer than
+  /// `accretion` times the sum of their radii into one. The merger keeps the
+  /// mass, the center of mass, and the momentum, and its area is the sum of
+  /// the areas. A particle that absorbed another may absorb more.
+  /// @return Number of particles merged away.
+  size_t accrete() {
+    std::vector<bool> gone(size());
+    size_t n{};
+    for (auto [i, j] : overlaps()) {
+      auto &&a = (*this)[i], &&b = (*this)[j];
+      auto const d = accretion * (a.radius + b.radius);
+      if (gone[i] || gone[j] || std::norm(a.xy - b.xy) >= d * d)
+        continue;
+      auto const m = a.mass + b.mass;
+      a.xy = (a.mass * a.xy + b.mass * b.xy) / m;
+      a.v = (a.mass * a.v + b.mass * b.v) / m;
+      a.mass = m, a.radius = std::hypot(a.radius, b.radius);
+      gone[j] = true, ++n;
+    }
+    if (!n)
+      return 0;
+    // Remove the particles merged away, all at once.
+    size_t k{};
+    for (size_t i = 0; i < size(); i++)
+      if (!gone[i])
+        (*this)[k++] = (*this)[i];
+    erase(begin() + ptrdiff_t(k), end());
+    forget_tree();
+    accreted += n;
+    return n;
+  }
+
+  /// @brief Compute the acceleration [L/T/T] of particle i at the start of a
+  /// step, as `step` does, with the tree built by `index` (call it first, for
+  /// the tree to describe the particles where they are now; without a tree,
+  /// see `direct`).
+  [[nodiscard]] std::complex<float> acceleration(size_t i) const {
+    return acceleration(i, (*this)[i].xy);
+  }
+
+  /// @brief Compute the acceleration [L/T/T] that particle i would have at
+  /// xy, as the second force evaluation of `step` does (the others where they
+  /// were when the tree was built).
+  [[nodiscard]] std::complex<float> acceleration(size_t i,
+                                                 std::complex<float> xy) const {
+    auto &&p = (*this)[i];
+    if (!indexed()) {
+      std::complex<float> a{};
+      for (size_t j = 0; j < size(); j++)
+        if (j != i)
+          a += gravity.field({xy, p.radius}, (*this)[j].circle(),
+                             G * (*this)[j].mass);
+      return a;
+    }
+    return accelerate(built.packed, {xy, p.radius}, built.packed.leaf(i));
+  }
+
+  /// @brief Compute the acceleration [L/T/T] of a particle of the given
+  /// circle whose node is `self` due to the others in a packed tree, as
+  /// `step` does, for particles held elsewhere (see view.h).
+  [[nodiscard]] std::complex<float>
+  acceleration(dyn::bh32::Packed const &tree, dyn::Circle<> circle,
+               uint32_t self) const {
+    return accelerate(tree, circle, self);
+  }
+
+  /// @brief Find what a particle of radius up to `reach` [L] anywhere in the
+  /// rectangle with the less-less (ll) and greater-greater (gg) corners would
+  /// sum over in `step`: the groups that the acceptance criterion takes as a
+  /// whole from every point of the rectangle, and the particles of the
+  /// others (a locally essential tree). Uses the tree of the latest step or
+  /// `index`; without it, every particle is reported.
+  /// @param group Called with the circle and the mass of each group taken as
+  /// a whole.
+  /// @param particle Called with each particle.
+  void essential(std::complex<float> ll, std::complex<float> gg, float reach,
+                 auto &&group, auto &&particle) const {
+    if (!indexed()) {
+      for (auto &&p : *this)
+        particle(p);
+      return;
+    }
+    built.root->depth_first([&](auto &&g) {
+      auto const square = [](auto x) { return x * x; };
+      if (!g.many) {
+        particle(*g.first);
+        return false;
+      }
+      // The nearest point of the rectangle is this close to the group.
+      auto const norm = dyn::bh32::detail::norm_to_rectangle(g.xy, ll, gg);
+      auto const rsq = square(g.radius);
+      // (The criterion of `accelerate` at that point.)
+      if (norm < rsq || norm < square(reach) ||
+          square(tan_angle_threshold) * norm < rsq)
+        return true;
+      group(g.circle(), g.mass);
+      return false;
+    });
+  }
+
+  /// @brief Compute the acceleration [L/T/T] of particle i exactly, by
+  /// summing over every other particle with the kernel that `step` uses.
+  [[nodiscard]] std::complex<float> direct(size_t i) const {
+    auto &&p = (*this)[i];
+    std::complex<float> a{};
+    for (size_t j = 0; j < size(); j++)
+      if (j != i)
+        a += gravity.field(p.circle(), (*this)[j].circle(),
+                           G * (*this)[j].mass);
+    return a;
+  }
+
+  /// @brief Quantities that the dynamics conserves (see `conserved`).
+  struct Conserved {
+    /// Kinetic and potential energy [MLL/T/T].
+    double kinetic{}, potential{};
+
+    /// Momentum [ML/T], and angular momentum about the origin [MLL/T].
+    std::complex<double> momentum;
+    double angular{};
+
+    /// Total energy [MLL/T/T].
+    [[nodiscard]] double energy() const noexcept { return kinetic + potential; }
+  };
+
+  /// @brief Have the next `step` measure the conserved quantities into
+  /// `measured`, at its start: with the tree it builds for its forces, at no
+  /// extra sort or build (see `conserved`).
+  bool measure{};
+  std::optional<Conserved> measured;
+
+  /// @brief Measure the energy, the momentum, and the angular momentum. The
+  /// potential energy is summed over a tree walk like that of `step` (the
+  /// same acceptance criterion and the same model of overlapping particles),
+  /// so it is what the forces of a step are the gradient of. Without a tree
+  /// of the particles where they are now (before the first step, or after
+  /// one has moved them), builds one first (see `index`; the particles are
+  /// reordered); to measure every few steps, set `measure` instead.
+  ///
+  /// The particles are summed in chunks in parallel, and the chunks in
+  /// order, with compensated sums: the result does not depend on the number
+  /// of threads.
+  [[nodiscard]] Conserved conserved() {
+    auto constexpr CHUNK = size_t(1024);
+    if (!indexed() || built.drift > 0.0f)
+      index();
+    auto const &tree = built.root;
+    auto const b = begin();
+    std::vector<Conserved> chunks((size() + CHUNK - 1) / CHUNK);
+    auto const m = static_cast<int>(chunks.size());
+    auto n = 0;
+#pragma omp parallel for schedule(dynamic, 1)
+    for (n = 0; n < m; ++n) {
+      dyn::Kahan<double> kinetic, potential, angular;
+      dyn::Kahan<std::complex<double>> momentum;
+      auto const first = size_t(n) * CHUNK;
+      for (auto i = first; i < std::min(first + CHUNK, size()); i++) {
+        auto &&p = (*this)[i];
+        auto const xy = std::complex<double>{p.xy};
+        auto const v = std::complex<double>{p.v}, mv = double(p.mass) * v;
+        kinetic += 0.5 * double(p.mass) * std::norm(v);
+        // Each pair is counted from both ends.
+        potential += 0.5 * double(p.mass) *
+                     double(this->potential(tree, p.circle(),
+                                            b + ptrdiff_t(i)));
+        momentum += mv;
+        angular += xy.real() * mv.imag() - xy.imag() * mv.real();
+      }
+      chunks[size_t(n)] = {kinetic(), potential(), momentum(), angular()};
+    }
+    dyn::Kahan<double> kinetic, potential, angular;
+    dyn::Kahan<std::complex<double>> momentum;
+    for (auto &&c : chunks) {
+      kinetic += c.kinetic, potential += c.potential;
+      momentum += c.momentum, angular += c.angular;
+    }
+    return {kinetic(), potential(), momentum(), angular()};
   }
 
   /// @brief Refresh the "disk" used for parts of the calculation.
   void refresh_disk() noexcept { gravity.refresh_disk(); }
 
+  /// @brief Take the constant of gravitation, the angle threshold, the
+  /// accretion, and the "disk" of another table, but not its particles.
+  void use_physics_of(Table const &other) noexcept {
+    G = other.G, tan_angle_threshold = other.tan_angle_threshold;
+    accretion = other.accretion, gravity = other.gravity;
+  }
+
   /// @brief Test whether the simulation is in "good state."
   bool good() noexcept {
     auto constexpr finite = [](std::complex<float> f) {
@@ -0,0 +1,91 @@
+#ifndef GRASS_ACCURACY_H
+#define GRASS_ACCURACY_H
+
+/// @file accuracy.h
+/// @brief Measure how accurate a force engine is: compare the accelerations
+/// it computes for a random sample of particles with exact ones, by direct
+/// summation with the same kernel, and report the distribution of the
+/// relative errors.
+///
+/// The engine is given as two functions of the index of a particle: its
+/// approximate acceleration and its exact one (see `Table::acceleration` and
+/// `Table::direct`). Both are evaluated for the sample in parallel (with
+/// OpenMP), so the exact sums over all particles take O(kN) time in all.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <philox.h>
+#include <vector>
+
+namespace phy::accuracy {
+
+/// @brief Relative errors of the accelerations, |a - exact| / |exact|.
+struct Report {
+  /// Number of particles sampled.
+  size_t samples{};
+
+  /// Median, 99th percentile, and maximum.
+  double median{}, p99{}, max{};
+};
+
+/// @brief Pick k distinct indices under n (all of them if k >= n), in
+/// increasing order, as a pure function of the seed (Floyd's algorithm).
+inline std::vector<size_t> sample(size_t n, size_t k, uint64_t seed) {
+  std::vector<size_t> out;
+  if (k >= n) {
+    for (size_t i = 0; i < n; i++)
+      out.push_back(i);
+    return out;
+  }
+  dyn::Philox<> const rng{seed};
+  auto s = rng.stream(0);
+  for (auto j = n - k; j < n; j++) {
+    auto const hi = uint64_t(s.bits());
+    auto const t = size_t((hi << 32 | s.bits()) % (j + 1));
+    out.push_back(std::ranges::find(out, t) == out.end() ? t : j);
+  }
+  std::ranges::sort(out);
+  return out;
+}
+
+/// @brief Compare the accelerations of a sample of the particles.
+/// @param n Number of particles.
+/// @param k Number of particles to sample.
+/// @param approx Called with the index of a particle; returns the
+/// acceleration [L/T/T] to test.
+/// @param exact Likewise, the exact acceleration.
+Report compare(size_t n, size_t k, uint64_t seed, auto &&approx,
+               auto &&exact) {
+  auto const which = sample(n, k, seed);
+  std::vector<double> errors(which.size());
+  auto const m = static_cast<int>(which.size());
+  auto i = 0;
+#pragma omp parallel for schedule(dynamic, 4)
+  for (i = 0; i < m; ++i) {
+    auto const a = std::complex<double>{approx(which[size_t(i)])};
+    auto const e = std::complex<double>{exact(which[size_t(i)])};
+    auto const d = std::abs(a - e);
+    errors[size_t(i)] = std::abs(e) > 0.0 ? d / std::abs(e)
+                        : d > 0.0 ? std::numeric_limits<double>::infinity()
+                                  : 0.0;
+  }
+  Report r{errors.size()};
+  if (errors.empty())
+    return r;
+  std::ranges::sort(errors);
+  // (Nearest rank.)
+  auto const rank = [&errors](double q) {
+    auto const k = size_t(std::ceil(q * double(errors.size())));
+    return errors[std::max(k, size_t(1)) - 1];
+  };
+  r.median = rank(0.5), r.p99 = rank(0.99), r.max = errors.back();
+  return r;
+}
+
+} // namespace phy::accuracy
+
+#endif // GRASS_ACCURACY_H
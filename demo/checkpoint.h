@@ -0,0 +1,252 @@
+#ifndef GRASS_CHECKPOINT_H
+#define GRASS_CHECKPOINT_H
+
+/// @file checkpoint.h
+/// @brief Versioned binary checkpoint of a `Table`.
+///
+/// Layout (native byte order, checked through the `endian` field):
+///
+///  - a 64-byte header (`checkpoint::Header`),
+///  - then five arrays in structure-of-arrays layout, each starting at a
+///  multiple of 64 bytes: Morton codes (uint64), positions (2 x float),
+///  velocities (2 x float), masses (float), and radii (float).
+///
+/// The particles are stored in Morton order together with their codes, so
+/// restoring a checkpoint is mapping the file and validating the header; no
+/// parsing and no sorting are involved.
+
+#include <algorithm>
+#include <array>
+#include <barnes_hut.h>
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Table.h"
+#include "mapped.h"
+
+namespace phy::checkpoint {
+
+/// @brief Magic bytes at the start of every checkpoint.
+inline constexpr std::array<char, 8> MAGIC{'G', 'R', 'A', 'S',
+                                           'S', 'C', 'K', 'P'};
+
+/// @brief Current version of the layout.
+inline constexpr uint32_t VERSION = 1;
+
+/// @brief Written as-is; reads back differently on a foreign byte order.
+inline constexpr uint32_t ENDIAN = 0x01020304;
+
+/// @brief Stored in place of a Morton code when a particle has none.
+inline constexpr uint64_t NO_MORTON = ~uint64_t{};
+
+/// @brief Alignment of each array [bytes].
+inline constexpr uint64_t ALIGN = 64;
+
+/// @brief The fixed-size header.
+struct Header {
+  std::array<char, 8> magic{MAGIC};
+  uint32_t version{VERSION}, endian{ENDIAN};
+  /// @brief Number of particles.
+  uint64_t count{};
+  /// @brief Universal gravitational constant and opening threshold.
+  float G{}, tan_angle_threshold{};
+  /// @brief Sizes of a particle's fields [bytes], as a sanity check.
+  uint32_t key_bytes{sizeof(uint64_t)}, xy_bytes{sizeof(std::complex<float>)};
+  std::array<char, 24> reserved{};
+};
+static_assert(sizeof(Header) == ALIGN);
+
+/// @brief Byte offsets of the arrays for a given number of particles. The last
+/// entry is the total file size.
+struct Layout {
+  uint64_t morton, xy, v, mass, radius, end;
+
+  explicit constexpr Layout(uint64_t n) noexcept {
+    auto const up = [](uint64_t a) { return (a + ALIGN - 1) / ALIGN * ALIGN; };
+    morton = ALIGN;
+    xy = up(morton + n * sizeof(uint64_t));
+    v = up(xy + n * sizeof(std::complex<float>));
+    mass = up(v + n * sizeof(std::complex<float>));
+    radius = up(mass + n * sizeof(float));
+    end = up(radius + n * sizeof(float));
+  }
+};
+
+/// @brief Write the table to `path`. The particles are written in Morton
+/// order with fresh codes; the table itself is left untouched. The file is
+/// written next to `path` first and then renamed over it, so an interrupted
+/// save never clobbers the previous checkpoint.
+/// @throws std::runtime_error On I/O failure.
+template <typename... Args>
+void save(Table<Args...> const &table, std::string const &path) {
+  auto const n = table.size();
+  std::vector<uint64_t> key(n);
+  for (size_t i = 0; i < n; i++)
+    key[i] = dyn::bh32::morton(table[i].xy).value_or(NO_MORTON);
+  std::vector<size_t> order(n);
+  std::iota(order.begin(), order.end(), size_t{});
+  std::ranges::stable_sort(order, {}, [&key](auto i) { return key[i]; });
+
+  Header h;
+  h.count = n;
+  h.G = table.G;
+  h.tan_angle_threshold = table.tan_angle_threshold;
+  Layout const l{n};
+
+  auto const tmp = path + ".tmp";
+  {
+    std::ofstream f{tmp, std::ios::binary | std::ios::trunc};
+    if (!f)
+      throw std::runtime_error{tmp + ": cannot open for writing"};
+    auto const put = [&f](void const *p, size_t bytes) {
+      f.write(static_cast<char const *>(p), std::streamsize(bytes));
+    };
+    auto const pad = [&f](uint64_t offset) {
+      std::array<char, ALIGN> zero{};
+      if (auto gap = offset - uint64_t(f.tellp()))
+        f.write(zero.data(), std::streamsize(gap));
+    };
+    // Gather one field at a time (in Morton order) into a small buffer.
+    auto const column = [&](uint64_t offset, auto &&field) {
+      pad(offset);
+      using T = std::remove_cvref_t<decltype(field(size_t{}))>;
+      std::array<T, 1024> buf;
+      for (size_t i = 0; i < n; i += buf.size()) {
+        auto const m = std::min(buf.size(), n - i);
+        for (size_t j = 0; j < m; j++)
+          buf[j] = field(order[i + j]);
+        put(buf.data(), m * sizeof(T));
+      }
+    };
+    put(&h, sizeof h);
+    column(l.morton, [&key](size_t i) { return key[i]; });
+    column(l.xy, [&table](size_t i) { return table[i].xy; });
+    column(l.v, [&table](size_t i) { return table[i].v; });
+    column(l.mass, [&table](size_t i) { return table[i].mass; });
+    column(l.radius, [&table](size_t i) { return table[i].radius; });
+    pad(l.end);
+    if (!f.flush())
+      throw std::runtime_error{tmp + ": write failed"};
+  }
+  std::error_code e;
+  std::filesystem::rename(tmp, path, e);
+  if (e)
+    throw std::runtime_error{path + ": " + e.message()};
+}
+
+/// @brief A validated, memory-mapped checkpoint. Opening costs the same
+/// regardless of the number of particles; the arrays are paged in on access.
+class Checkpoint {
+  MappedFile file;
+  Header h;
+
+  template <typename T> std::span<T const> array(uint64_t offset) const {
+    return {reinterpret_cast<T const *>(file.data() + offset), h.count};
+  }
+
+public:
+  /// @brief Map and validate the checkpoint at `path`.
+  /// @throws std::runtime_error If the file cannot be mapped or is not a
+  /// checkpoint this build understands.
+  explicit Checkpoint(std::string const &path) : file{path} {
+    auto const fail = [&path](char const *what) {
+      return std::runtime_error{path + ": " + what};
+    };
+    if (file.size() < sizeof h)
+      throw fail("too short to be a checkpoint");
+    std::memcpy(&h, file.data(), sizeof h);
+    if (h.magic != MAGIC)
+      throw fail("not a checkpoint");
+    if (h.endian != ENDIAN)
+      throw fail("written on a machine of a different byte order");
+    if (h.version != VERSION)
+      throw fail("unsupported checkpoint version");
+    if (h.key_bytes != sizeof(uint64_t) ||
+        h.xy_bytes != sizeof(std::complex<float>))
+      throw fail("unsupported field sizes");
+    // Guard the multiplications in Layout against overflow.
+    if (h.count > file.size() / sizeof(uint64_t) ||
+        Layout{h.count}.end != file.size())
+      throw fail("size does not match the particle count");
+  }
+
+  /// @brief Number of particles.
+  [[nodiscard]] size_t size() const noexcept { return h.count; }
+
+  /// @brief Stored constants.
+  [[nodiscard]] float G() const noexcept { return h.G; }
+  [[nodiscard]] float tan_angle_threshold() const noexcept {
+    return h.tan_angle_threshold;
+  }
+
+  /// @brief Arrays, in Morton order.
+  [[nodiscard]] std::span<uint64_t const> morton() const {
+    return array<uint64_t>(Layout{h.count}.morton);
+  }
+  [[nodiscard]] std::span<std::complex<float> const> xy() const {
+    return array<std::complex<float>>(Layout{h.count}.xy);
+  }
+  [[nodiscard]] std::span<std::complex<float> const> v() const {
+    return array<std::complex<float>>(Layout{h.count}.v);
+  }
+  [[nodiscard]] std::span<float const> mass() const {
+    return array<float>(Layout{h.count}.mass);
+  }
+  [[nodiscard]] std::span<float const> radius() const {
+    return array<float>(Layout{h.count}.radius);
+  }
+
+  /// @brief Hint that the particles [first, first + count) will be read soon
+  /// (or, with `need` false, not again soon); see `MappedFile::advise`.
+  void advise(size_t first, size_t count, bool need = true) const noexcept {
+    Layout const l{h.count};
+    for (auto [offset, bytes] :
+         {std::pair{l.morton, sizeof(uint64_t)},
+          {l.xy, sizeof(std::complex<float>)},
+          {l.v, sizeof(std::complex<float>)},
+          {l.mass, sizeof(float)},
+          {l.radius, sizeof(float)}})
+      file.advise(offset + first * bytes, count * bytes, need);
+  }
+
+  /// @brief Copy the checkpoint into a table (a straight copy; the particles
+  /// and their Morton codes are already in order).
+  template <typename... Args> void restore(Table<Args...> &table) const {
+    auto const n = size();
+    auto const z = morton();
+    auto const x = xy(), u = v();
+    auto const m = mass(), r = radius();
+    table.clear();
+    table.G = h.G;
+    table.tan_angle_threshold = h.tan_angle_threshold;
+    table.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      auto &&p = table[i];
+      p = Particle{x[i], u[i], m[i], r[i]};
+      if (z[i] != NO_MORTON)
+        p.morton = z[i];
+    }
+  }
+};
+
+/// @brief Map, validate, and restore the checkpoint at `path`.
+/// @throws std::runtime_error See `Checkpoint`.
+template <typename... Args> Table<Args...> load(std::string const &path) {
+  Table<Args...> table;
+  Checkpoint{path}.restore(table);
+  return table;
+}
+
+} // namespace phy::checkpoint
+
+#endif // GRASS_CHECKPOINT_H
@@ -0,0 +1,672 @@
+#ifndef GRASS_DISTRIBUTED_H
+#define GRASS_DISTRIBUTED_H
+
+/// @file distributed.h
+/// @brief Step a simulation across several processes (ranks) on one machine,
+/// each with the particles of a contiguous range of Morton codes.
+///
+/// The ranks are connected pairwise by Unix-domain stream sockets (see
+/// `mesh`), either as processes (see `Launch` and `spawned`) or as threads of
+/// one process (the tests). A step of each rank:
+///
+///  1. sends the particles that left its range of codes to their owners,
+///  2. builds its tree (see `Table::index`), and sends each other rank what
+///     its particles would sum over in that tree (see `Table::essential`):
+///     the groups far enough from the other rank's particles as a whole
+///     (their moments, as single particles), and the particles of the others,
+///  3. steps its own particles (as `Table::step`) with a tree over them and
+///     what it received.
+///
+/// Every few steps, the ranks move the boundaries of their ranges so that
+/// each gets about the same share of the time that the forces took, by the
+/// time that each rank measured (rebalancing).
+///
+/// Particles are never merged (see `Table::accretion`). The rectangles that
+/// groups are accepted from are padded by twice the distance the fastest
+/// particle of a rank goes in a step, for the second force evaluation; a
+/// particle that goes further (from near rest) may take a group as a whole a
+/// little closer than `Table::step` would.
+
+#include <algorithm>
+#include <chrono>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "Table.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRASS_DISTRIBUTED 1
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __APPLE__
+#include <mach-o/dyld.h>
+#endif
+
+extern char **environ;
+#endif
+
+namespace phy::distributed {
+
+/// @brief A particle as sent between ranks.
+struct Body {
+  std::complex<float> xy, v;
+  float mass, radius;
+};
+
+static_assert(sizeof(Body) == 24 && std::is_trivially_copyable_v<Body>);
+
+/// @brief Morton code of the particles that have none (the last rank's).
+inline constexpr uint64_t NO_MORTON = ~uint64_t{};
+
+/// @brief What to run (sent by rank 0 to the others).
+struct Plan {
+  /// Number of steps and step size [T].
+  uint64_t steps{1'000};
+  float dt{1.0f / 90.0f};
+
+  /// Rebalance every this many steps (never if 0).
+  uint64_t rebalance_every{10};
+
+  /// Report every this many steps (never if 0).
+  uint64_t report_every{100};
+};
+
+/// @brief What a rank did since the previous report.
+struct Stats {
+  /// Own particles, and particles and groups received for the latest step.
+  uint64_t own{}, imported{};
+
+  /// Particles sent to other ranks (as they left the range), all told.
+  uint64_t migrated{};
+
+  /// Wall time [s] of the forces and of the whole steps.
+  double forces{}, steps{};
+};
+
+using Message = std::vector<std::byte>;
+
+namespace detail {
+
+template <class T> void append(Message &m, std::span<T> v) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  auto const n = m.size();
+  m.resize(n + v.size_bytes());
+  if (!v.empty())
+    std::memcpy(m.data() + n, v.data(), v.size_bytes());
+}
+
+template <class T> std::vector<T> read(std::span<std::byte const> m) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  std::vector<T> v(m.size() / sizeof(T));
+  if (!v.empty())
+    std::memcpy(v.data(), m.data(), v.size() * sizeof(T));
+  return v;
+}
+
+inline Body body(Particle const &p) { return {p.xy, p.v, p.mass, p.radius}; }
+
+inline uint64_t morton(std::complex<float> xy) {
+  return dyn::bh32::morton(xy).value_or(NO_MORTON);
+}
+
+} // namespace detail
+
+/// @brief The connections of a rank to the others.
+class Comm {
+  int r{};
+  /// The socket to each rank (-1 for this one).
+  std::vector<int> fd;
+
+  void close() noexcept {
+#ifdef GRASS_DISTRIBUTED
+    for (auto f : fd)
+      if (f >= 0)
+        ::close(f);
+#endif
+    fd.clear();
+  }
+
+public:
+  /// @param rank This rank.
+  /// @param fds A connected socket to each rank (ignored for this one), of
+  /// which this takes ownership.
+  Comm(int rank, std::vector<int> fds) : r{rank}, fd{std::move(fds)} {
+#ifdef GRASS_DISTRIBUTED
+    for (auto j = 0; j < size(); j++)
+      if (j == r)
+        fd[size_t(j)] = -1;
+      else
+        ::fcntl(fd[size_t(j)], F_SETFL,
+                ::fcntl(fd[size_t(j)], F_GETFL) | O_NONBLOCK);
+#endif
+  }
+
+  Comm(Comm &&c) noexcept { *this = std::move(c); }
+  Comm &operator=(Comm &&c) noexcept {
+    if (this != &c)
+      close(), r = c.r, fd = std::exchange(c.fd, {});
+    return *this;
+  }
+  Comm(Comm const &) = delete;
+  Comm &operator=(Comm const &) = delete;
+  ~Comm() { close(); }
+
+  [[nodiscard]] int rank() const noexcept { return r; }
+  [[nodiscard]] int size() const noexcept { return int(fd.size()); }
+
+  /// @brief Send out[j] to each rank j and receive in[j] from each, all at
+  /// once (so that no rank waits for another to read first, whatever the
+  /// sizes). Every rank calls this together.
+  /// @throws std::runtime_error If a rank is gone.
+  void exchange(std::vector<Message> const &out, std::vector<Message> &in) {
+    auto const n = size_t(size());
+    in.assign(n, {});
+    in[size_t(r)] = out[size_t(r)];
+#ifdef GRASS_DISTRIBUTED
+    auto const fail = [](size_t j, char const *what) {
+      return std::runtime_error{"rank " + std::to_string(j) + ": " + what};
+    };
+    // Each message is preceded by its size.
+    std::vector<uint64_t> size_out(n), size_in(n);
+    std::vector<size_t> sent(n), received(n);
+    auto const HEAD = sizeof(uint64_t);
+    for (size_t j = 0; j < n; j++)
+      size_out[j] = out[j].size();
+    auto const sending = [&](size_t j) {
+      return j != size_t(r) && sent[j] < HEAD + size_out[j];
+    };
+    auto const receiving = [&](size_t j) {
+      return j != size_t(r) &&
+             (received[j] < HEAD || received[j] < HEAD + size_in[j]);
+    };
+    std::vector<pollfd> polls;
+    std::vector<size_t> peer;
+    for (;;) {
+      polls.clear(), peer.clear();
+      for (size_t j = 0; j < n; j++) {
+        short events = (sending(j) ? POLLOUT : 0) | (receiving(j) ? POLLIN : 0);
+        if (events)
+          polls.push_back({fd[j], events, 0}), peer.push_back(j);
+      }
+      if (polls.empty())
+        return;
+      if (::poll(polls.data(), nfds_t(polls.size()), -1) < 0) {
+        if (errno == EINTR)
+          continue;
+        throw std::runtime_error{"poll failed"};
+      }
+      for (size_t k = 0; k < polls.size(); k++) {
+        auto const j = peer[k];
+        auto const ev = polls[k].revents;
+        if ((ev & POLLOUT) && sending(j)) {
+          auto const *p = sent[j] < HEAD
+                              ? reinterpret_cast<std::byte const *>(
+                                    &size_out[j]) + sent[j]
+                              : out[j].data() + (sent[j] - HEAD);
+          auto const left = sent[j] < HEAD ? HEAD - sent[j]
+                                           : HEAD + size_out[j] - sent[j];
+#ifdef MSG_NOSIGNAL
+          auto const w = ::send(fd[j], p, left, MSG_NOSIGNAL);
+#else
+          auto const w = ::send(fd[j], p, left, 0);
+#endif
+          if (w < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+              errno != EINTR)
+            throw fail(j, "cannot send (gone?)");
+          sent[j] += w > 0 ? size_t(w) : 0;
+        }
+        if ((ev & (POLLIN | POLLHUP | POLLERR)) && receiving(j)) {
+          auto *p = received[j] < HEAD
+                        ? reinterpret_cast<std::byte *>(&size_in[j]) +
+                              received[j]
+                        : in[j].data() + (received[j] - HEAD);
+          auto const left = received[j] < HEAD
+                                ? HEAD - received[j]
+                                : HEAD + size_in[j] - received[j];
+          auto const got = ::recv(fd[j], p, left, 0);
+          if (got == 0)
+            throw fail(j, "connection closed");
+          if (got < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+              errno != EINTR)
+            throw fail(j, "cannot receive");
+          received[j] += got > 0 ? size_t(got) : 0;
+          if (got > 0 && received[j] == HEAD)
+            in[j].resize(size_in[j]);
+        } else if ((ev & (POLLERR | POLLNVAL)) && sending(j)) {
+          throw fail(j, "connection lost");
+        }
+      }
+    }
+#else
+    throw std::runtime_error{"sockets are not supported on this platform"};
+#endif
+  }
+
+  /// @brief Send m to every rank and receive every rank's (in[j] from j).
+  std::vector<Message> allgather(Message const &m) {
+    std::vector<Message> in;
+    exchange(std::vector<Message>(size_t(size()), m), in);
+    return in;
+  }
+};
+
+/// @brief Connect n ranks pairwise: the sockets of rank i are `mesh(n)[i]`
+/// (-1 for itself).
+/// @throws std::runtime_error If the sockets cannot be made.
+inline std::vector<std::vector<int>> mesh(int n) {
+  std::vector<std::vector<int>> fds(size_t(n), std::vector<int>(size_t(n), -1));
+#ifdef GRASS_DISTRIBUTED
+  for (auto i = 0; i < n; i++)
+    for (auto j = i + 1; j < n; j++) {
+      int pair[2];
+      if (::socketpair(AF_UNIX, SOCK_STREAM, 0, pair)) {
+        for (auto &&row : fds)
+          for (auto f : row)
+            if (f >= 0)
+              ::close(f);
+        throw std::runtime_error{"cannot make sockets"};
+      }
+      fds[size_t(i)][size_t(j)] = pair[0], fds[size_t(j)][size_t(i)] = pair[1];
+    }
+#else
+  if (n > 1)
+    throw std::runtime_error{"sockets are not supported on this platform"};
+#endif
+  return fds;
+}
+
+/// @brief Run the plan as the rank of `comm`, all ranks together. Rank 0
+/// passes the table (with the constants), whose particles are spread across
+/// the ranks and gathered back in it at the end, and the plan; the others
+/// pass null, and get the plan and the constants from rank 0.
+/// @param report Called by rank 0 every `Plan::report_every` steps with the
+/// step number and the `Stats` of each rank.
+/// @throws std::runtime_error If a rank is gone.
+inline void run(Comm &comm, Table<> *table, Plan plan, auto &&report) {
+  using clock = std::chrono::steady_clock;
+  auto const rank = size_t(comm.rank()), ranks = size_t(comm.size());
+  auto const seconds = [](auto t) {
+    return std::chrono::duration<double>(clock::now() - t).count();
+  };
+
+  // The plan, the constants, and the first ranges (of equal counts).
+  struct Setup {
+    Plan plan;
+    float G, tan_angle_threshold;
+  };
+  /// Rank r has the codes in [bounds[r - 1], bounds[r]) (the first from 0 and
+  /// the last to the end).
+  std::vector<uint64_t> bounds;
+  Table<> own;
+  {
+    Message m;
+    if (rank == 0) {
+      Setup const setup{plan, table->G, table->tan_angle_threshold};
+      detail::append(m, std::span{&setup, 1});
+      std::vector<uint64_t> keys(table->size());
+      for (size_t i = 0; i < keys.size(); i++)
+        keys[i] = detail::morton((*table)[i].xy);
+      std::ranges::sort(keys);
+      for (size_t k = 1; k < ranks; k++)
+        bounds.push_back(keys.empty() ? 0 : keys[keys.size() * k / ranks]);
+      detail::append(m, std::span<uint64_t const>{bounds});
+      own.assign(table->begin(), table->end());
+      table->clear();
+    }
+    auto const all = comm.allgather(m);
+    auto const setup = detail::read<Setup>(all[0]).at(0);
+    plan = setup.plan;
+    own.G = setup.G, own.tan_angle_threshold = setup.tan_angle_threshold;
+    bounds = detail::read<uint64_t>(std::span{all[0]}.subspan(sizeof(Setup)));
+  }
+  Table<> work;
+  work.G = own.G, work.tan_angle_threshold = own.tan_angle_threshold;
+  auto const owner = [&bounds](uint64_t key) {
+    return size_t(std::ranges::upper_bound(bounds, key) - bounds.begin());
+  };
+
+  Stats stats;
+  // Time of the forces since the latest rebalancing [s].
+  double cost{};
+  std::vector<Message> out(ranks), in;
+  std::vector<std::vector<Body>> bodies(ranks);
+  std::vector<bool> mine;
+  std::vector<std::complex<float>> xy1, v1;
+  for (uint64_t step = 1; step <= plan.steps; step++) {
+    auto const t_step = clock::now();
+
+    // 1. Send the particles that left the range to their owners.
+    for (auto &&b : bodies)
+      b.clear();
+    size_t kept{};
+    for (auto &&p : own) {
+      auto const o = owner(detail::morton(p.xy));
+      if (o == rank)
+        own[kept++] = p;
+      else
+        bodies[o].push_back(detail::body(p));
+    }
+    own.erase(own.begin() + ptrdiff_t(kept), own.end());
+    for (size_t j = 0; j < ranks; j++) {
+      stats.migrated += bodies[j].size();
+      out[j].clear();
+      detail::append(out[j], std::span<Body const>{bodies[j]});
+    }
+    comm.exchange(out, in);
+    for (size_t j = 0; j < ranks; j++)
+      if (j != rank)
+        for (auto &&b : detail::read<Body>(in[j]))
+          own.push_back({b.xy, b.v, b.mass, b.radius});
+
+    // 2. Send each rank what its particles would sum over here: within the
+    // rectangle of its particles (padded for the second force evaluation),
+    // with their largest radius.
+    struct Box {
+      std::complex<float> ll, gg;
+      float reach;
+      uint32_t empty;
+    } box{{}, {}, 0.0f, own.empty()};
+    if (!own.empty()) {
+      box.ll = box.gg = own.front().xy;
+      auto fastest = 0.0f;
+      for (auto &&p : own) {
+        box.ll = {std::min(box.ll.real(), p.xy.real()),
+                  std::min(box.ll.imag(), p.xy.imag())};
+        box.gg = {std::max(box.gg.real(), p.xy.real()),
+                  std::max(box.gg.imag(), p.xy.imag())};
+        box.reach = std::max(box.reach, p.radius);
+        fastest = std::max(fastest, std::abs(p.v));
+      }
+      auto const pad = 2.0f * fastest * plan.dt;
+      box.ll -= std::complex{pad, pad}, box.gg += std::complex{pad, pad};
+    }
+    Message m;
+    detail::append(m, std::span{&box, 1});
+    auto const boxes = comm.allgather(m);
+    own.index();
+    for (size_t j = 0; j < ranks; j++) {
+      bodies[j].clear();
+      Box b;
+      std::memcpy(&b, boxes[j].data(), sizeof b);
+      if (j == rank || b.empty)
+        continue;
+      own.essential(
+          b.ll, b.gg, b.reach,
+          [&](dyn::Circle<float> c, float mass) {
+            bodies[j].push_back({c, {}, mass, c.radius});
+          },
+          [&](Particle const &p) { bodies[j].push_back(detail::body(p)); });
+    }
+    for (size_t j = 0; j < ranks; j++) {
+      out[j].clear();
+      detail::append(out[j], std::span<Body const>{bodies[j]});
+    }
+    comm.exchange(out, in);
+
+    // 3. Step the own particles with a tree over them and what came in. The
+    // particles are put in the order `index` sorts them in (stably), so that
+    // they stay where they are put and the own ones can be told apart.
+    auto const t_forces = clock::now();
+    std::vector<std::pair<Particle, bool>> all;
+    for (auto &&p : own)
+      all.emplace_back(p, true);
+    stats.imported = 0;
+    for (size_t j = 0; j < ranks; j++)
+      if (j != rank)
+        for (auto &&b : detail::read<Body>(in[j])) {
+          all.emplace_back(Particle{b.xy, b.v, b.mass, b.radius}, false);
+          ++stats.imported;
+        }
+    for (auto &&[p, _] : all)
+      p.morton = dyn::bh32::morton(p.xy);
+    std::ranges::stable_sort(all, {}, [](auto &&a) { return a.first.morton; });
+    work.clear(), mine.clear();
+    for (auto &&[p, m] : all)
+      work.push_back(p), mine.push_back(m);
+    work.index();
+    std::vector<size_t> at;
+    for (size_t i = 0; i < work.size(); i++)
+      if (mine[i])
+        at.push_back(i);
+    own.clear();
+    for (auto i : at)
+      own.push_back(work[i]);
+    xy1.resize(at.size()), v1.resize(at.size());
+    auto const count = static_cast<int>(at.size());
+    auto n = 0;
+#pragma omp parallel for
+    for (n = 0; n < count; ++n) {
+      auto const i = at[size_t(n)];
+      auto ig = dyn::Verlet<float>{work[i].xy, work[i].v};
+      ig.step(plan.dt,
+              [&work, i](auto xy) { return work.acceleration(i, xy); });
+      xy1[size_t(n)] = ig.y0, v1[size_t(n)] = ig.y1;
+    }
+    for (size_t k = 0; k < own.size(); k++)
+      own[k].xy = xy1[k], own[k].v = v1[k];
+    own.forget_tree();
+    work.refresh_disk();
+    auto const forces = seconds(t_forces);
+    stats.forces += forces, cost += forces;
+
+    // 4. Rebalance: move the bounds so that each rank gets about the same
+    // share of the time of the forces, supposing that each of its particles
+    // took the same time.
+    if (plan.rebalance_every && step % plan.rebalance_every == 0 &&
+        ranks > 1) {
+      auto constexpr SAMPLES = size_t(1024);
+      std::vector<uint64_t> keys(own.size());
+      for (size_t i = 0; i < own.size(); i++)
+        keys[i] = detail::morton(own[i].xy);
+      std::ranges::sort(keys);
+      auto const every = std::max(size_t(1), keys.size() / SAMPLES);
+      // (Weigh by the number of particles if no time was measured.)
+      auto const each = keys.empty() ? 0.0
+                        : cost > 0.0 ? cost / double(keys.size())
+                                     : 1.0;
+      struct Sample {
+        uint64_t key;
+        double weight;
+      };
+      std::vector<Sample> samples;
+      for (size_t i = 0; i < keys.size(); i += every)
+        samples.push_back(
+            {keys[i], each * double(std::min(every, keys.size() - i))});
+      Message s;
+      detail::append(s, std::span{samples});
+      samples.clear();
+      for (auto &&a : comm.allgather(s))
+        for (auto &&sample : detail::read<Sample>(a))
+          samples.push_back(sample);
+      std::ranges::sort(samples, {}, &Sample::key);
+      auto total = 0.0;
+      for (auto &&sample : samples)
+        total += sample.weight;
+      auto sum = 0.0;
+      size_t k = 1;
+      for (auto &&[key, weight] : samples) {
+        // A bound at the sample that passes each share.
+        for (; k < ranks && sum + weight > total * double(k) / double(ranks);
+             k++)
+          bounds[k - 1] = key;
+        sum += weight;
+      }
+      for (; k < ranks; k++)
+        bounds[k - 1] = NO_MORTON;
+      cost = 0.0;
+    }
+
+    stats.own = own.size();
+    stats.steps += seconds(t_step);
+    if (plan.report_every && step % plan.report_every == 0) {
+      Message r;
+      detail::append(r, std::span{&stats, 1});
+      auto const gathered = comm.allgather(r);
+      if (rank == 0) {
+        std::vector<Stats> each;
+        for (auto &&a : gathered)
+          each.push_back(detail::read<Stats>(a).at(0));
+        report(step, std::span<Stats const>{each});
+      }
+      stats = {};
+    }
+  }
+
+  // Gather the particles back at rank 0.
+  for (auto &&m : out)
+    m.clear();
+  std::vector<Body> mine_bodies;
+  for (auto &&p : own)
+    mine_bodies.push_back(detail::body(p));
+  detail::append(out[0], std::span<Body const>{mine_bodies});
+  comm.exchange(out, in);
+  if (rank == 0) {
+    table->clear();
+    table->G = own.G, table->tan_angle_threshold = own.tan_angle_threshold;
+    for (auto &&a : in)
+      for (auto &&b : detail::read<Body>(a))
+        table->push_back({b.xy, b.v, b.mass, b.radius});
+  }
+}
+
+#ifdef GRASS_DISTRIBUTED
+/// @brief Ranks 1 to n - 1 as processes running this program, started by
+/// rank 0 (this one). Each child learns its rank and its sockets from the
+/// environment (see `spawned`), so it must check that first thing in `main`.
+///
+/// (The children are started anew rather than forked: a forked child of a
+/// process that ran OpenMP threads hangs at its first parallel region. They
+/// run the executable of this one: /proc/self/exe on Linux, the path from
+/// `_NSGetExecutablePath` on macOS.)
+class Launch {
+  std::vector<pid_t> pids;
+
+  /// The path of the executable of this process.
+  static std::string executable() {
+#ifdef __APPLE__
+    uint32_t size{};
+    _NSGetExecutablePath(nullptr, &size);
+    std::string path(size, '\0');
+    if (_NSGetExecutablePath(path.data(), &size))
+      throw std::runtime_error{"cannot find the executable"};
+    path.resize(std::strlen(path.c_str()));
+    return path;
+#else
+    return "/proc/self/exe";
+#endif
+  }
+
+public:
+  /// Rank 0 of the ranks started.
+  Comm comm;
+
+  /// @throws std::runtime_error If a process cannot be started.
+  explicit Launch(int n) : comm{0, {}} {
+    auto path = executable();
+    auto fds = mesh(n);
+    for (auto i = 1; i < n; i++) {
+      auto const &mine = fds[size_t(i)];
+      std::string list;
+      for (auto f : mine)
+        list += (list.empty() ? "" : ",") + std::to_string(f);
+      // The environment of the child: this one's, and the rank.
+      std::vector<std::string> env{"GRASS_RANK=" + std::to_string(i),
+                                   "GRASS_RANK_FDS=" + list};
+      for (auto e = environ; *e; ++e)
+        if (std::strncmp(*e, "GRASS_RANK", 10))
+          env.emplace_back(*e);
+      std::vector<char *> envp;
+      for (auto &&e : env)
+        envp.push_back(e.data());
+      envp.push_back(nullptr);
+      // Close the sockets of the other ranks in the child.
+      posix_spawn_file_actions_t actions;
+      posix_spawn_file_actions_init(&actions);
+      for (auto j = 0; j < n; j++)
+        if (j != i)
+          for (auto f : fds[size_t(j)])
+            if (f >= 0)
+              posix_spawn_file_actions_addclose(&actions, f);
+      char *argv[] = {path.data(), nullptr};
+      pid_t pid{};
+      auto const e = posix_spawn(&pid, path.c_str(), &actions, nullptr, argv,
+                                 envp.data());
+      posix_spawn_file_actions_destroy(&actions);
+      if (e) {
+        for (auto &&row : fds)
+          for (auto f : row)
+            if (f >= 0)
+              ::close(f);
+        join();
+        throw std::runtime_error{"cannot start rank " + std::to_string(i)};
+      }
+      pids.push_back(pid);
+    }
+    for (auto i = 1; i < n; i++)
+      for (auto f : fds[size_t(i)])
+        if (f >= 0)
+          ::close(f);
+    comm = Comm{0, std::move(fds[0])};
+  }
+
+  Launch(Launch const &) = delete;
+  Launch &operator=(Launch const &) = delete;
+  ~Launch() {
+    try {
+      join();
+    } catch (...) {
+    }
+  }
+
+  /// @brief Wait for the other ranks to exit.
+  /// @throws std::runtime_error If one failed.
+  void join() {
+    comm = Comm{0, {}};
+    auto failed = 0;
+    for (auto pid : std::exchange(pids, {})) {
+      int status{};
+      while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+        ;
+      if (!WIFEXITED(status) || WEXITSTATUS(status))
+        ++failed;
+    }
+    if (failed)
+      throw std::runtime_error{std::to_string(failed) + " rank(s) failed"};
+  }
+};
+#endif
+
+/// @brief The connections of this process if it is a rank started by
+/// `Launch`, or none.
+inline std::optional<Comm> spawned() {
+  auto const rank = std::getenv("GRASS_RANK");
+  auto const list = std::getenv("GRASS_RANK_FDS");
+  if (!rank || !list)
+    return {};
+  std::vector<int> fds;
+  for (std::string s = list; !s.empty();) {
+    auto const comma = s.find(',');
+    fds.push_back(std::stoi(s.substr(0, comma)));
+    s = comma == std::string::npos ? "" : s.substr(comma + 1);
+  }
+  return Comm{std::stoi(rank), std::move(fds)};
+}
+
+} // namespace phy::distributed
+
+#endif // GRASS_DISTRIBUTED_H
@@ -0,0 +1,420 @@
+#ifndef GRASS_ENSEMBLE_H
+#define GRASS_ENSEMBLE_H
+
+/// @file ensemble.h
+/// @brief Run many small, independent simulations (an ensemble, such as a
+/// parameter sweep) at full throughput, and collect their results.
+///
+/// Each member is a table with its own step size and number of steps. Members
+/// too small to gain from a tree are stepped in batches of `LANES` members of
+/// the same size: their particles are interleaved member by member, so that
+/// the force kernel sums each pair (i, j) for all the members of the batch at
+/// once, in SIMD lanes. Larger members (and members that merge particles) are
+/// stepped alone with `Table::step`.
+///
+/// Batches and members stepped alone are whole jobs, spread across the
+/// threads (with OpenMP), the most expensive first; a job runs on one thread
+/// from the first step to the last, so no thread waits for another within a
+/// step. A batch follows the scheme of `Table::step` (velocity Verlet, the
+/// second force evaluation with the others where they were at the start of
+/// the step) with the same kernel (`dyn::Gravity`), but sums over every pair
+/// instead of walking a tree.
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <newton.h>
+#include <philox.h>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "Table.h"
+#include "initial.h"
+#include "loader.h"
+
+namespace phy::ensemble {
+
+/// Members are stepped in batches of this many (SIMD lanes).
+inline constexpr size_t LANES = 8;
+
+/// @brief One simulation of an ensemble.
+struct Member {
+  /// A label for the results (for example, the initial conditions).
+  std::string label;
+
+  Table<> table;
+
+  /// Step size [T], and number of steps.
+  float dt{1.0f / 90.0f};
+  uint64_t steps{1'000};
+
+  /// Results: the conserved quantities before and after (see
+  /// `Table::conserved`), the steps taken, and the first step after which the
+  /// table was not good (0 if none; the member stopped there).
+  Table<>::Conserved before, after;
+  uint64_t taken{}, failed{};
+};
+
+struct Options {
+  /// Step members of up to this many particles in batches (0 never to).
+  size_t batch_limit{64};
+};
+
+/// @brief What `run` did.
+struct Stats {
+  /// Members stepped in batches, the number of batches, and the number of
+  /// members stepped alone.
+  size_t batched{}, batches{}, alone{};
+
+  /// Particle-steps taken, and the wall time [s].
+  uint64_t particle_steps{};
+  double seconds{};
+};
+
+namespace detail {
+
+/// @brief Members of the same size, stepped together. Particle i of lane l is
+/// at i * LANES + l; lanes without a member repeat the first one, frozen.
+class Batch {
+  size_t n;
+  std::span<Member *const> members;
+  std::vector<float> x, y, vx, vy, m, r;
+  std::array<float, LANES> G{}, dt{};
+  std::array<uint64_t, LANES> steps{}, failed{};
+  dyn::Gravity<> gravity;
+
+  /// Sum the accelerations [L/T/T] of the particles at (px, py) due to the
+  /// others at (sx, sy) into (ax, ay).
+  void accelerate(float const *px, float const *py, float const *sx,
+                  float const *sy, float *ax, float *ay) const {
+    std::fill_n(ax, n * LANES, 0.0f), std::fill_n(ay, n * LANES, 0.0f);
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < n; j++) {
+        if (i == j)
+          continue;
+        auto const I = i * LANES, J = j * LANES;
+        auto overlap = 0;
+#pragma omp simd reduction(| : overlap)
+        for (size_t l = 0; l < LANES; l++) {
+          auto const dx = sx[J + l] - px[I + l], dy = sy[J + l] - py[I + l];
+          auto const rr = dx * dx + dy * dy, s = r[I + l] + r[J + l];
+          // Disjoint: the usual law. Overlapping: see below.
+          auto const disjoint = rr > 0.0f && s * s <= rr;
+          auto const inv = disjoint ? 1.0f / std::sqrt(rr) : 0.0f;
+          auto const f = G[l] * m[J + l] * inv * inv * inv;
+          ax[I + l] += f * dx, ay[I + l] += f * dy;
+          overlap |= rr > 0.0f && !disjoint;
+        }
+        if (!overlap)
+          continue;
+        for (size_t l = 0; l < LANES; l++) {
+          auto const c0 = dyn::Circle<float>{{px[I + l], py[I + l]}, r[I + l]};
+          auto const c1 = dyn::Circle<float>{{sx[J + l], sy[J + l]}, r[J + l]};
+          auto const s = c0.radius + c1.radius;
+          if (auto const rr = std::norm(c1 - c0); rr > 0.0f && rr < s * s) {
+            auto const a = gravity.field(c0, c1, G[l] * m[J + l]);
+            ax[I + l] += a.real(), ay[I + l] += a.imag();
+          }
+        }
+      }
+  }
+
+public:
+  /// @param members Up to `LANES` members, all of the same size.
+  explicit Batch(std::span<Member *const> members)
+      : n{members.front()->table.size()}, members{members}, x(n * LANES),
+        y(n * LANES), vx(n * LANES), vy(n * LANES), m(n * LANES),
+        r(n * LANES) {
+    for (size_t l = 0; l < LANES; l++) {
+      auto const &member = *members[l < members.size() ? l : 0];
+      for (size_t i = 0; i < n; i++) {
+        auto &&p = member.table[i];
+        auto const k = i * LANES + l;
+        x[k] = p.xy.real(), y[k] = p.xy.imag();
+        vx[k] = p.v.real(), vy[k] = p.v.imag();
+        m[k] = p.mass, r[k] = p.radius;
+      }
+      G[l] = member.table.G, dt[l] = member.dt;
+      steps[l] = l < members.size() ? member.steps : 0;
+    }
+  }
+
+  /// @brief Take the steps of all the members, and copy the particles back.
+  void run() {
+    auto const size = n * LANES;
+    std::vector<float> ax0(size), ay0(size), ax1(size), ay1(size), nx(size),
+        ny(size);
+    std::array<uint64_t, LANES> taken{};
+    auto const most = *std::ranges::max_element(steps);
+    for (uint64_t k = 0; k < most; k++) {
+      // The step of each lane (0 when done, or frozen after going wrong).
+      std::array<float, LANES> h{};
+      for (size_t l = 0; l < LANES; l++)
+        h[l] = k < steps[l] && !failed[l] ? dt[l] : 0.0f;
+
+      accelerate(x.data(), y.data(), x.data(), y.data(), ax0.data(),
+                 ay0.data());
+      for (size_t i = 0; i < n; i++) {
+#pragma omp simd
+        for (size_t l = 0; l < LANES; l++) {
+          auto const q = i * LANES + l;
+          nx[q] = x[q] + (h[l] * vx[q] + h[l] * h[l] * 0.5f * ax0[q]);
+          ny[q] = y[q] + (h[l] * vy[q] + h[l] * h[l] * 0.5f * ay0[q]);
+        }
+      }
+      accelerate(nx.data(), ny.data(), x.data(), y.data(), ax1.data(),
+                 ay1.data());
+      for (size_t i = 0; i < n; i++) {
+#pragma omp simd
+        for (size_t l = 0; l < LANES; l++) {
+          auto const q = i * LANES + l;
+          vx[q] += h[l] * 0.5f * (ax0[q] + ax1[q]);
+          vy[q] += h[l] * 0.5f * (ay0[q] + ay1[q]);
+        }
+      }
+      x.swap(nx), y.swap(ny);
+
+      for (size_t l = 0; l < LANES; l++) {
+        if (h[l] == 0.0f)
+          continue;
+        taken[l] = k + 1;
+        for (size_t i = 0; i < n && !failed[l]; i++) {
+          auto const q = i * LANES + l;
+          if (!std::isfinite(x[q]) || !std::isfinite(y[q]) ||
+              !std::isfinite(vx[q]) || !std::isfinite(vy[q]))
+            failed[l] = k + 1;
+        }
+      }
+      gravity.refresh_disk();
+    }
+
+    for (size_t l = 0; l < members.size(); l++) {
+      auto &&member = *members[l];
+      for (size_t i = 0; i < n; i++) {
+        auto &&p = member.table[i];
+        auto const q = i * LANES + l;
+        p.xy = {x[q], y[q]}, p.v = {vx[q], vy[q]};
+      }
+      member.table.forget_tree();
+      member.taken = taken[l], member.failed = failed[l];
+    }
+  }
+};
+
+/// @brief Take the steps of a member with `Table::step`.
+inline void run_alone(Member &member) {
+  for (uint64_t k = 1; k <= member.steps; k++) {
+    member.table.step(member.dt);
+    member.table.refresh_disk();
+    member.taken = k;
+    if (!member.table.good()) {
+      member.failed = k;
+      break;
+    }
+  }
+}
+
+} // namespace detail
+
+/// @brief Run all the members of an ensemble (see the top of the file), and
+/// fill in their results.
+inline Stats run(std::vector<Member> &members, Options const &o = {}) {
+  using clock = std::chrono::steady_clock;
+  auto const t0 = clock::now();
+  Stats stats;
+
+  // A job: a batch of members of the same size, or a member alone.
+  struct Job {
+    std::vector<Member *> members;
+    bool batched{};
+    double cost{};
+  };
+  std::vector<Member *> small;
+  std::vector<Job> jobs;
+  for (auto &&member : members) {
+    auto const n = member.table.size();
+    if (n && n <= o.batch_limit && member.table.accretion <= 0.0f) {
+      small.push_back(&member);
+      continue;
+    }
+    // (A rough estimate of the time a tree takes.)
+    auto const cost = double(member.steps) * double(n) *
+                      std::max(32.0 * std::log2(double(n) + 1.0), double(n));
+    jobs.push_back({{&member}, false, cost});
+    ++stats.alone;
+  }
+  std::ranges::stable_sort(small, {},
+                           [](Member const *m) { return m->table.size(); });
+  for (size_t i = 0; i < small.size();) {
+    auto const n = small[i]->table.size();
+    Job job{{}, true, 0.0};
+    for (; i < small.size() && small[i]->table.size() == n &&
+           job.members.size() < LANES;
+         i++) {
+      job.members.push_back(small[i]);
+      job.cost = std::max(job.cost, double(small[i]->steps) * double(n * n));
+    }
+    stats.batched += job.members.size(), ++stats.batches;
+    jobs.push_back(std::move(job));
+  }
+  std::ranges::stable_sort(jobs, std::ranges::greater{}, &Job::cost);
+
+  auto const m = static_cast<int>(jobs.size());
+  auto k = 0;
+#pragma omp parallel for schedule(dynamic, 1)
+  for (k = 0; k < m; ++k) {
+    auto &&job = jobs[size_t(k)];
+    for (auto *member : job.members)
+      member->before = member->table.conserved();
+    if (job.batched)
+      detail::Batch{job.members}.run();
+    else
+      detail::run_alone(*job.members.front());
+    for (auto *member : job.members)
+      member->after = member->table.conserved();
+  }
+
+  for (auto &&member : members)
+    stats.particle_steps += member.taken * member.table.size();
+  stats.seconds = std::chrono::duration<double>(clock::now() - t0).count();
+  return stats;
+}
+
+/// @brief Load the members of an ensemble from a CSV file: a header line, then
+/// one member per line, `initial, n, seed, G, dt, steps, jitter`.
+///
+///  - `initial` is `figure8`, `plummer`, `galaxies`, or the path of a file of
+///    initial conditions (see loader.h).
+///  - `n` is the number of particles of `plummer` and `galaxies`, and `seed`
+///    their seed.
+///  - `G` replaces the gravitational constant of the initial conditions, and
+///    `dt` and `steps` are the step size and the number of steps.
+///  - `jitter` scales each velocity by 1 plus this times a standard normal
+///    number (drawn from the seed).
+///
+/// Empty or missing fields take the defaults (500 particles, seed 0, the
+/// initial conditions' G, `Member`'s step size and steps, no jitter). Blank
+/// lines and lines starting with `#` are skipped.
+/// @throws std::runtime_error If the file cannot be read or a line is
+/// malformed (with the line number).
+inline std::vector<Member> load(std::string const &path) {
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{
+      std::fopen(path.c_str(), "r"), &std::fclose};
+  if (!f)
+    throw std::runtime_error{path + ": cannot open"};
+  std::vector<Member> members;
+  std::string line;
+  for (size_t number = 1;; number++) {
+    line.clear();
+    int c;
+    while ((c = std::fgetc(f.get())) != EOF && c != '\n')
+      line.push_back(char(c));
+    if (line.empty() && c == EOF)
+      break;
+    if (!line.empty() && line.back() == '\r')
+      line.pop_back();
+    if (number == 1 || line.empty() || line.front() == '#')
+      continue;
+    auto const fail = [&](std::string const &what) {
+      return std::runtime_error{path + ":" + std::to_string(number) + ": " +
+                                what};
+    };
+
+    std::vector<std::string> fields;
+    for (size_t p = 0;;) {
+      auto const q = line.find(',', p);
+      auto field = line.substr(p, q - p);
+      std::erase_if(field, [](char ch) { return ch == ' ' || ch == '\t'; });
+      fields.push_back(std::move(field));
+      if (q == std::string::npos)
+        break;
+      p = q + 1;
+    }
+    fields.resize(std::max(fields.size(), size_t(7)));
+    auto const number_or = [&](size_t i, auto fallback) {
+      auto const &s = fields[i];
+      if (s.empty())
+        return fallback;
+      auto t = fallback;
+      auto [p, e] = std::from_chars(s.data(), s.data() + s.size(), t);
+      if (e != std::errc{} || p != s.data() + s.size())
+        throw fail("not a number: " + s);
+      return t;
+    };
+
+    main_program::Constants constants;
+    // (They start with a fifth of their limit.)
+    if (auto const n = number_or(1, size_t{}))
+      constants.PARTICLES_LIMIT = 5 * n;
+    auto const seed = number_or(2, uint64_t{});
+    Member member;
+    auto const &initial = fields[0];
+    if (initial == "figure8")
+      member.table = main_program::figure8();
+    else if (initial == "plummer")
+      member.table = main_program::plummer(constants, seed);
+    else if (initial == "galaxies")
+      member.table = main_program::galaxies(constants, seed);
+    else if (!initial.empty())
+      loader::load(initial, member.table);
+    else
+      throw fail("no initial conditions");
+    member.label = initial;
+    member.table.G = number_or(3, member.table.G);
+    member.dt = number_or(4, member.dt);
+    member.steps = number_or(5, member.steps);
+    if (auto const jitter = number_or(6, 0.0f); jitter != 0.0f) {
+      dyn::Philox<> const rng{seed};
+      for (size_t i = 0; i < member.table.size(); i++) {
+        auto s = rng.stream(i, 1);
+        member.table[i].v *= 1.0f + jitter * s.normal();
+      }
+    }
+    members.push_back(std::move(member));
+  }
+  return members;
+}
+
+/// @brief Write the results of the members to a CSV file, one line each:
+/// the number and the label of the member, its number of particles, G, the
+/// step size, the steps taken, the step that went wrong (0 if none), the
+/// energy before and after and its drift (relative to the energy before),
+/// the momentum after, and the angular momentum before and after.
+/// @throws std::runtime_error If the file cannot be written.
+inline void write(std::vector<Member> const &members, std::string const &path) {
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{
+      std::fopen(path.c_str(), "w"), &std::fclose};
+  if (!f)
+    throw std::runtime_error{path + ": cannot open for writing"};
+  std::fprintf(f.get(), "member,label,n,G,dt,steps,failed,energy0,energy,"
+                        "drift,px,py,angular0,angular\n");
+  for (size_t i = 0; i < members.size(); i++) {
+    auto &&m = members[i];
+    auto const e0 = m.before.energy(), e = m.after.energy();
+    std::fprintf(f.get(),
+                 "%zu,%s,%zu,%.9g,%.9g,%llu,%llu,%.17g,%.17g,%.9g,%.9g,%.9g,"
+                 "%.17g,%.17g\n",
+                 i, m.label.c_str(), m.table.size(), double(m.table.G),
+                 double(m.dt), (unsigned long long)m.taken,
+                 (unsigned long long)m.failed, e0, e,
+                 e0 != 0.0 ? (e - e0) / std::abs(e0) : 0.0,
+                 m.after.momentum.real(), m.after.momentum.imag(),
+                 m.before.angular, m.after.angular);
+  }
+  if (std::fflush(f.get()))
+    throw std::runtime_error{path + ": cannot write"};
+}
+
+} // namespace phy::ensemble
+
+#endif // GRASS_ENSEMBLE_H
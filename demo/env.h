@@ -1,13 +1,15 @@
 #ifndef GRASS_ENV_H
 #define GRASS_ENV_H
 
+#include <charconv>
 #include <cstdlib>
 #include <optional>
 #include <string>
+#include <system_error>
 
 namespace env {
 
-std::optional<std::string> get(char const *sv) {
+inline std::optional<std::string> get(char const *sv) {
 #ifdef _WIN32
   char *s{};
   size_t n{};
@@ -31,6 +33,20 @@ std::optional<std::string> get(char const *sv) {
 #endif
 }
 
+/// Read an environment variable as a number. No value if the variable is unset
+/// or if its value (in full) is not a number of type T.
+template <typename T> std::optional<T> number(char const *sv) {
+  auto s = get(sv);
+  if (!s.has_value())
+    return {};
+  T t{};
+  auto const *first = s->data(), *last = first + s->size();
+  auto [p, e] = std::from_chars(first, last, t);
+  if (e != std::errc{} || p != last)
+    return {};
+  return t;
+}
+
 } // namespace env
 
 #endif // GRASS_ENV_H
@@ -0,0 +1,215 @@
+#ifndef GRASS_INITIAL_H
+#define GRASS_INITIAL_H
+
+/// @file initial.h
+/// @brief Initial conditions shared by the demo and the headless runner.
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numbers>
+#include <optional>
+#include <philox.h>
+#include <random>
+#include <vector>
+
+#include "Table.h"
+
+namespace main_program {
+
+using phy::Particle, phy::Table;
+
+/// Constants controlling the program.
+struct Constants {
+  /// Inclusive upper limit of the number of particles.
+  size_t PARTICLES_LIMIT = 2'500;
+
+  /// Uncorrected mean radius [L] and standard deviation [L].
+  float LOG_MEAN_RADIUS = std::log(0.05f), LOG_STDEV_RADIUS = std::log(1.25f);
+
+  /// Uncorrected mean mass [M] and standard deviation [M].
+  float LOG_MEAN_MASS = std::log(1.0f), LOG_STDEV_MASS = std::log(1.0f);
+
+  /// Squared distance for when a particle is too far [L^2].
+  float SQ_DISTANCE_TOO_FAR = 5'000.0f * 5'000.0f;
+
+  float G = 0.015625f;
+
+  /// Seed of the initial conditions (random if none).
+  std::optional<uint64_t> seed;
+
+  struct {
+    bool galaxies : 1 {};
+    bool plummer : 1 {};
+  } flags;
+
+  /// Decide whether the position vector is too far.
+  [[nodiscard]] constexpr bool too_far(std::complex<float> xy) const {
+    return std::norm(xy) > SQ_DISTANCE_TOO_FAR;
+  }
+
+  [[nodiscard]] Particle random_particle(auto &&rng) const {
+    using lognormal = std::lognormal_distribution<float>;
+    lognormal m{LOG_MEAN_MASS, LOG_STDEV_MASS},
+        r{LOG_MEAN_RADIUS, LOG_STDEV_RADIUS};
+    // xy, v, m, r.
+    return Particle{{}, {}, m(rng), r(rng)};
+  }
+
+  /// Same, but from a counter-based stream (see `dyn::Philox`).
+  [[nodiscard]] Particle random_particle(dyn::Philox<>::Stream &s) const {
+    auto m = s.lognormal(LOG_MEAN_MASS, LOG_STDEV_MASS);
+    auto r = s.lognormal(LOG_MEAN_RADIUS, LOG_STDEV_RADIUS);
+    return Particle{{}, {}, m, r};
+  }
+};
+
+template <typename... Args> constexpr Table<Args...> figure8() {
+  Table<Args...> table;
+
+  // Make the mystical figure-8 shape below work at first.
+  // (This G value is too large in most cases, so I will lower it once the
+  // user starts interacting with the world, exiting the demo mode.)
+  table.G = 1.0f;
+
+  // Positions (c...), and velocities (v...)
+  std::complex<float> c0{-0.97000436f, 0.24308753f},
+      v0{0.4662036850f, 0.4323657300f}, v1{-0.93240737f, -0.86473146f};
+
+  // Position, velocity, mass, radius
+  // Make the radius small enough so that the Barnes-Hut tree approximation
+  // doesn't group them and break the figure-8 orbit.
+  table.emplace_back(c0, v0, 1.0f, 0.05f);
+  table.emplace_back(.0f, v1, 1.0f, 0.05f);
+  table.emplace_back(-c0, v0, 1.0f, 0.05f);
+  return table;
+};
+
+namespace detail {
+
+/// Purposes of the random streams of the generators (see `dyn::Philox`).
+enum Purpose : uint32_t { PARTICLE, CLUMP, POSITION, VELOCITY };
+
+} // namespace detail
+
+/// Generate clumps of particles ("galaxies"). Particle i is a pure function of
+/// the seed and i, so the particles are generated in parallel, and the result
+/// does not depend on the number of threads.
+template <typename... Args>
+Table<Args...> galaxies(Constants constants,
+                        uint64_t seed = std::random_device{}()) {
+  using namespace detail;
+  auto const div_ceil = [](auto a, auto b) { return a / b + !!(a % b); };
+  auto const L = div_ceil(constants.PARTICLES_LIMIT, size_t(5));
+  dyn::Philox<> const rng{seed};
+
+  // Lay out the clumps first (few of them; serially).
+  struct Clump {
+    size_t first;
+    std::complex<float> ellipse, pan, spin;
+  };
+  std::vector<Clump> clumps;
+  auto const log_number = std::log(std::sqrt(float(L)));
+  size_t n{};
+  for (uint64_t c = 0; n <= L; c++) {
+    auto d = rng.stream(c, CLUMP);
+    auto const N = std::min(d.lognormal(log_number, 1.0f), float(L - n));
+    if (N <= 0.0f)
+      break;
+    auto ellipse =
+        std::complex{d.lognormal(-0.5f, 0.5f), d.lognormal(-0.5f, 0.5f)};
+    auto pan = d.normal_xy() * 5.0f;
+    // Line through (100, 1) and (2500, 3) [N, curve].
+    auto curve = 11.0f / 12.0f + N / 1200.0f;
+    auto angle = 2.0f * std::numbers::pi_v<float> * d.uniform();
+    auto spin = std::polar(curve, angle);
+    clumps.push_back({n, ellipse, pan, spin});
+    n += size_t(N);
+  }
+
+  Table<Args...> table;
+  table.G = constants.G;
+  table.resize(n);
+  auto const m = static_cast<long long>(n);
+  auto i = 0LL;
+#pragma omp parallel for
+  for (i = 0; i < m; ++i) {
+    auto const &c = *std::prev(std::ranges::upper_bound(
+        clumps, size_t(i), {}, [](auto &&c) { return c.first; }));
+    auto p = rng.stream(uint64_t(i), PARTICLE);
+    auto q = constants.random_particle(p);
+    // Make an ellipse.
+    auto z = p.normal_xy();
+    z = {z.real() * c.ellipse.real(), z.imag() * c.ellipse.imag()};
+    q.xy = (z / 2.0f + c.pan) * c.spin;
+    table[size_t(i)] = q;
+  }
+  return table;
+}
+
+/// Generate a rotating disk whose surface density follows the Plummer profile,
+/// Sigma(R) ~ (1 + R^2 / a^2)^-2, with a = `scale`. Each particle is set on a
+/// circular orbit about the enclosed mass, plus a small random velocity. Like
+/// `galaxies`, particle i is a pure function of the seed and i.
+template <typename... Args>
+Table<Args...> plummer(Constants constants,
+                       uint64_t seed = std::random_device{}(),
+                       float scale = 2.0f) {
+  using namespace detail;
+  auto const div_ceil = [](auto a, auto b) { return a / b + !!(a % b); };
+  auto const N = div_ceil(constants.PARTICLES_LIMIT, size_t(5));
+  dyn::Philox<> const rng{seed};
+
+  Table<Args...> table;
+  table.G = constants.G;
+  table.resize(N);
+  auto const m = static_cast<long long>(N);
+  auto i = 0LL;
+#pragma omp parallel for
+  for (i = 0; i < m; ++i) {
+    auto p = rng.stream(uint64_t(i), PARTICLE);
+    auto q = constants.random_particle(p);
+    // Invert the enclosed fraction R^2 / (R^2 + a^2). Cut the tail at 10 a.
+    auto x = rng.stream(uint64_t(i), POSITION);
+    auto u = std::min(x.uniform(), 0.99f);
+    auto R = scale * std::sqrt(u / (1.0f - u));
+    q.xy = std::polar(R, 2.0f * std::numbers::pi_v<float> * x.uniform());
+    table[size_t(i)] = q;
+  }
+
+  // Total mass (in a fixed order, so that it is reproducible).
+  double M{};
+  for (auto &&q : table)
+    M += q.mass;
+
+  // Circular velocity about the mass inside R (counterclockwise).
+  auto const GM = double(constants.G) * M;
+#pragma omp parallel for
+  for (i = 0; i < m; ++i) {
+    auto &&q = table[size_t(i)];
+    auto const R = double(std::abs(q.xy));
+    auto const vc = float(std::sqrt(GM * R / (R * R + double(scale * scale))));
+    auto v = rng.stream(uint64_t(i), VELOCITY);
+    auto const tangent = R > 0.0 ? q.xy / float(R) * std::complex{0.0f, 1.0f}
+                                 : std::complex<float>{};
+    q.v = vc * tangent + 0.05f * vc * v.normal_xy();
+  }
+  return table;
+}
+
+/// Generate the initial conditions chosen by the flags.
+template <typename... Args> Table<Args...> generate(Constants constants) {
+  auto const seed = constants.seed.value_or(std::random_device{}());
+  if (constants.flags.plummer)
+    return plummer<Args...>(constants, seed);
+  if (constants.flags.galaxies)
+    return galaxies<Args...>(constants, seed);
+  return figure8<Args...>();
+}
+
+} // namespace main_program
+
+#endif // GRASS_INITIAL_H
@@ -0,0 +1,260 @@
+#ifndef GRASS_LOADER_H
+#define GRASS_LOADER_H
+
+/// @file loader.h
+/// @brief Load initial conditions from large CSV or raw binary files.
+///
+/// CSV: one particle per line, `x, y, vx, vy[, mass[, radius]]` (the mass and
+/// the radius default to 1). Blank lines and lines starting with `#` are
+/// skipped; so is the first line if it starts with a letter (a header).
+///
+/// Raw binary: records of six native-endian 32-bit floats, `x, y, vx, vy, mass,
+/// radius` (the layout of `trajectory::Sample`).
+///
+/// The file is memory-mapped and split into chunks at line (or record)
+/// boundaries. The chunks are parsed in parallel straight into the table's
+/// storage, and the Morton codes are computed in the same pass.
+
+#include <algorithm>
+#include <barnes_hut.h>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <complex>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "Table.h"
+#include "mapped.h"
+
+namespace phy::loader {
+
+/// @brief A malformed line (or record).
+class Error : public std::runtime_error {
+public:
+  /// @brief Line (CSV) or record (binary) number, starting from 1.
+  size_t line;
+
+  Error(std::string const &what, size_t line)
+      : std::runtime_error{what}, line{line} {}
+};
+
+/// @brief Recognized file formats.
+enum class Format { guess, csv, binary };
+
+namespace detail {
+
+/// @brief Aim for chunks of about this many bytes.
+inline constexpr size_t CHUNK = size_t(1) << 20;
+
+/// @brief Bytes in a raw binary record.
+inline constexpr size_t RECORD = 6 * sizeof(float);
+
+/// @brief A piece of the file, and what was found in it.
+struct Chunk {
+  char const *first{}, *last{};
+  /// @brief Number of particles, and the number of lines before the chunk.
+  size_t particles{}, line0{};
+  /// @brief First error in the chunk (if any).
+  std::string error;
+  size_t error_line{};
+};
+
+inline bool blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+/// @brief Does the line [p, end) hold a particle (not blank nor a comment)?
+inline bool holds_particle(char const *p, char const *end) {
+  while (p != end && blank(*p))
+    ++p;
+  return p != end && *p != '#';
+}
+
+/// @brief Parse one CSV line into p.
+/// @returns An error message (empty on success).
+inline std::string parse_line(char const *p, char const *end, Particle &q) {
+  float f[6]{0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 1.0f};
+  int n = 0;
+  for (;; ++n) {
+    while (p != end && blank(*p))
+      ++p;
+    if (n == 6)
+      return "more than 6 numbers";
+    auto [r, e] = std::from_chars(p, end, f[n]);
+    if (e != std::errc{}) {
+      auto word = std::string{p, std::find_if(p, end, [](char c) {
+                                return c == ',' || blank(c);
+                              })};
+      return "not a number: '" + word + "'";
+    }
+    if (!std::isfinite(f[n]))
+      return "not a finite number: '" + std::string{p, r} + "'";
+    for (p = r; p != end && blank(*p);)
+      ++p;
+    if (p == end)
+      break;
+    if (*p++ != ',')
+      return "expected a comma after number " + std::to_string(n + 1);
+  }
+  if (n < 3)
+    return "expected at least 4 numbers (x, y, vx, vy), found " +
+           std::to_string(n + 1);
+  if (f[4] <= 0.0f || f[5] <= 0.0f)
+    return "the mass and the radius must be positive";
+  q = Particle{{f[0], f[1]}, {f[2], f[3]}, f[4], f[5]};
+  return {};
+}
+
+/// @brief Split [first, last) into chunks that end right after a newline.
+inline std::vector<Chunk> split(char const *first, char const *last) {
+  std::vector<Chunk> chunks;
+  for (auto p = first; p != last;) {
+    auto q = p + std::min(CHUNK, size_t(last - p));
+    q = std::find(q, last, '\n');
+    if (q != last)
+      ++q;
+    auto &&c = chunks.emplace_back();
+    c.first = p, c.last = p = q;
+  }
+  return chunks;
+}
+
+template <typename T>
+void load_csv(MappedFile const &file, std::string const &path, T &table) {
+  auto const *first = reinterpret_cast<char const *>(file.data());
+  auto const *last = first + file.size();
+  // Skip a header (a first line that starts with a letter).
+  size_t skipped{};
+  if (auto p = std::find_if_not(first, last, blank);
+      p != last && std::isalpha(static_cast<unsigned char>(*p))) {
+    first = std::find(first, last, '\n');
+    first += first != last, skipped = 1;
+  }
+  auto chunks = split(first, last);
+  auto const m = static_cast<int>(chunks.size());
+
+  // Pass 1: count the particles and the lines in each chunk.
+  std::vector<size_t> lines(chunks.size());
+  auto n = 0;
+#pragma omp parallel for schedule(dynamic)
+  for (n = 0; n < m; ++n) {
+    auto &&c = chunks[n];
+    for (auto p = c.first; p != c.last; ++lines[n]) {
+      auto e = std::find(p, c.last, '\n');
+      c.particles += holds_particle(p, e);
+      p = e + (e != c.last);
+    }
+  }
+  auto const base = table.size();
+  auto total = base;
+  for (size_t i = 0, line = skipped; i < chunks.size(); i++) {
+    chunks[i].line0 = line, line += lines[i];
+    std::swap(total, chunks[i].particles), total += chunks[i].particles;
+  }
+  // (Now each chunk's `particles` is the index of its first particle.)
+  table.resize(total);
+
+  // Pass 2: parse straight into place.
+#pragma omp parallel for schedule(dynamic)
+  for (n = 0; n < m; ++n) {
+    auto &&c = chunks[n];
+    auto i = c.particles, line = c.line0;
+    for (auto p = c.first; p != c.last && c.error.empty();) {
+      auto e = std::find(p, c.last, '\n');
+      ++line;
+      if (holds_particle(p, e)) {
+        auto &&q = table[i++];
+        if (auto s = parse_line(p, e, q); !s.empty())
+          c.error = std::move(s), c.error_line = line;
+        else
+          q.morton = dyn::bh32::morton(q.xy);
+      }
+      p = e + (e != c.last);
+    }
+  }
+  for (auto &&c : chunks)
+    if (!c.error.empty()) {
+      table.resize(base);
+      throw Error{path + ":" + std::to_string(c.error_line) + ": " + c.error,
+                  c.error_line};
+    }
+}
+
+template <typename T>
+void load_binary(MappedFile const &file, std::string const &path, T &table) {
+  if (file.size() % RECORD)
+    throw Error{path + ": size is not a multiple of " +
+                    std::to_string(RECORD) + " bytes",
+                file.size() / RECORD + 1};
+  auto const *bytes = file.data();
+  auto const records = file.size() / RECORD, base = table.size();
+  table.resize(base + records);
+  auto const per = CHUNK / RECORD;
+  auto const m = static_cast<int>((records + per - 1) / per);
+  // First bad record of each chunk (or `records` if none).
+  std::vector<size_t> bad(size_t(m), records);
+  auto n = 0;
+#pragma omp parallel for
+  for (n = 0; n < m; ++n) {
+    auto const end = std::min(records, (size_t(n) + 1) * per);
+    for (auto i = size_t(n) * per; i < end; i++) {
+      float f[6];
+      std::memcpy(f, bytes + i * RECORD, sizeof f);
+      auto finite = std::all_of(f, f + 6, [](float x) {
+        return std::isfinite(x);
+      });
+      if (!finite || f[4] <= 0.0f || f[5] <= 0.0f) {
+        bad[size_t(n)] = i;
+        break;
+      }
+      auto &&q = table[base + i];
+      q = Particle{{f[0], f[1]}, {f[2], f[3]}, f[4], f[5]};
+      q.morton = dyn::bh32::morton(q.xy);
+    }
+  }
+  auto i = records;
+  for (auto b : bad)
+    i = std::min(i, b);
+  if (i < records) {
+    table.resize(base);
+    throw Error{path + ": record " + std::to_string(i + 1) +
+                    ": not finite, or non-positive mass or radius",
+                i + 1};
+  }
+}
+
+} // namespace detail
+
+/// @brief Append the particles in the file at `path` to the table.
+/// @param format The format; by default, guessed from the extension (`.csv`
+/// or `.txt` for CSV; `.bin` for raw binary).
+/// @throws std::runtime_error If the file cannot be mapped or the format is
+/// unknown; `Error` (with the line number) if the file is malformed. The
+/// table is left as it was in either case.
+template <typename... Args>
+void load(std::string const &path, Table<Args...> &table,
+          Format format = Format::guess) {
+  if (format == Format::guess) {
+    auto const ends = [&path](std::string const &s) {
+      return path.size() >= s.size() &&
+             path.compare(path.size() - s.size(), s.size(), s) == 0;
+    };
+    if (ends(".csv") || ends(".txt"))
+      format = Format::csv;
+    else if (ends(".bin"))
+      format = Format::binary;
+    else
+      throw std::runtime_error{path + ": unknown format (use .csv or .bin)"};
+  }
+  MappedFile const file{path};
+  if (format == Format::csv)
+    detail::load_csv(file, path, table);
+  else
+    detail::load_binary(file, path, table);
+}
+
+} // namespace phy::loader
+
+#endif // GRASS_LOADER_H
@@ -1,8 +1,9 @@
+#include <algorithm>
 #include <circle.h>
 #include <cmath>
 #include <complex>
 #include <cstdlib>
-#include <random>
+#include <optional>
 #include <raylib.h>
 #include <stdexcept>
 #include <string>
@@ -11,8 +12,11 @@
 #include <emscripten/emscripten.h>
 #endif
 
-#include "Table.h"
 #include "env.h"
+#include "replay.h"
+#include "simulation.h"
+#include "splat.h"
+#include "trajectory.h"
 #include "user.h"
 #include <numbers>
 #include <utility>
@@ -21,134 +25,76 @@ using namespace phy;
 
 namespace main_program {
 
-/// Constants controlling the program.
-struct Constants {
-  /// Inclusive upper limit of the number of particles.
-  size_t PARTICLES_LIMIT = 2'500;
-
-  /// Uncorrected mean radius [L] and standard deviation [L].
-  float LOG_MEAN_RADIUS = std::log(0.05f), LOG_STDEV_RADIUS = std::log(1.25f);
-
-  /// Uncorrected mean mass [M] and standard deviation [M].
-  float LOG_MEAN_MASS = std::log(1.0f), LOG_STDEV_MASS = std::log(1.0f);
-
-  /// Squared distance for when a particle is too far [L^2].
-  float SQ_DISTANCE_TOO_FAR = 5'000.0f * 5'000.0f;
+struct State {
+  /// What to simulate (read from the environment).
+  Simulation::Settings settings;
 
-  float G = 0.015625f;
+  /// The simulation (on its own thread, except on the web).
+  std::optional<Simulation> sim;
+  User user;
 
-  struct {
-    bool galaxies : 1 {};
-  } flags;
+  /// Resets seen so far, and whether a reset was asked for since.
+  uint64_t resets{};
+  bool reset_sent{};
 
-  /// Decide whether the position vector is too far.
-  [[nodiscard]] constexpr bool too_far(std::complex<float> xy) const {
-    return std::norm(xy) > SQ_DISTANCE_TOO_FAR;
-  }
-
-  [[nodiscard]] Particle random_particle(auto &&rng) const {
-    using lognormal = std::lognormal_distribution<float>;
-    lognormal m{LOG_MEAN_MASS, LOG_STDEV_MASS},
-        r{LOG_MEAN_RADIUS, LOG_STDEV_RADIUS};
-    // xy, v, m, r.
-    return Particle{{}, {}, m(rng), r(rng)};
-  }
-};
-
-template <typename... Args> static constexpr Table<Args...> figure8() {
-  Table<Args...> table;
-
-  // Make the mystical figure-8 shape below work at first.
-  // (This G value is too large in most cases, so I will lower it once the
-  // user starts interacting with the world, exiting the demo mode.)
-  table.G = 1.0f;
-
-  // Positions (c...), and velocities (v...)
-  std::complex<float> c0{-0.97000436f, 0.24308753f},
-      v0{0.4662036850f, 0.4323657300f}, v1{-0.93240737f, -0.86473146f};
-
-  // Position, velocity, mass, radius
-  // Make the radius small enough so that the Barnes-Hut tree approximation
-  // doesn't group them and break the figure-8 orbit.
-  table.emplace_back(c0, v0, 1.0f, 0.05f);
-  table.emplace_back(.0f, v1, 1.0f, 0.05f);
-  table.emplace_back(-c0, v0, 1.0f, 0.05f);
-  return table;
-};
-
-template <typename... Args>
-static Table<Args...> galaxies(Constants constants) {
-  using lognormal = std::lognormal_distribution<float>;
-  using normal = std::normal_distribution<float>;
-  using uniform = std::uniform_real_distribution<float>;
-
-  auto const div_ceil = [](auto a, auto b) { return a / b + !!(a % b); };
-  auto const L = div_ceil(constants.PARTICLES_LIMIT, size_t(5));
-  std::mt19937 rng{std::random_device{}()};
-  struct {
-    lognormal axes{-0.5f, 0.5f}, number{}, radial{};
-    normal norm{};
-    uniform angle{0.0f, 2.0f * std::numbers::pi_v<float>};
-    [[nodiscard]] std::complex<float> normal_xy(std::mt19937 &rng) {
-      return {norm(rng), norm(rng)};
-    }
-  } d{.number{lognormal{std::log(std::sqrt(float(L)))}}};
-
-  Table table;
-  table.G = constants.G;
-  table.reserve(L);
-  while (table.size() <= L) {
-    auto const N = std::min(d.number(rng), float(L - table.size()));
-    if (N <= 0.0f)
-      break;
-    auto first = table.size();
-    for (size_t i = 0; i < size_t(N); i++)
-      table.push_back(constants.random_particle(rng));
-    auto ellipse = std::complex{d.axes(rng), d.axes(rng)};
-    auto dot = [](auto a, auto b) -> std::complex<float> {
-      return {a.real() * b.real(), a.imag() * b.imag()};
-    };
-    auto pan = d.normal_xy(rng) * 5.0f;
-    // Line through (100, 1) and (2500, 3) [N, curve].
-    auto curve = 11.0f / 12.0f + N / 1200.0f;
-    auto spin = std::polar(curve, d.angle(rng));
-    // Make an ellipse.
-    for (auto i = first; i < table.size(); i++)
-      table[i].xy = (dot(d.normal_xy(rng), ellipse) / 2.0f + pan) * spin;
-  }
-  return table;
-}
+  /// What the simulation was told is in view.
+  View shown;
 
-struct State {
-  std::mt19937 rng{std::random_device{}()};
-  Constants constants;
-  Table<> table;
-  User user;
+  /// The map of the potential or the field drawn behind the particles (if
+  /// asked for), and the number of the map in it.
+  Texture2D background{};
+  uint64_t background_number{};
 
-  State() : constants{}, table{make_table()}, user{make_user()} {}
+#if !defined(PLATFORM_WEB)
+  /// Trajectory to play back instead of simulating (if asked for).
+  std::optional<trajectory::Player> replay;
+#endif
 
   void loop() {
-    float dt = user.control.target_dt();
+#if !defined(PLATFORM_WEB)
+    if (replay)
+      return play(replay.value());
+#endif
+    auto &&s = sim.value();
+    if (!s.threaded())
+      s.tick();
+    using enum Command::Kind;
 
-    // Reset the simulation (R) or if in demo for long enough.
-    if (user.wants_reset() ||
-        (user.control.demo && user.elapsed_sec() >= 30.0f))
-      goto reset_sim;
+    // Start over after a reset (asked for, or after a NaN).
+    auto const &snapshot = s.latest();
+    if (snapshot.resets != resets)
+      resets = snapshot.resets, reset_sent = false, user = make_user();
 
-    // Particles too far from the origin will be removed.
-    std::erase_if(table, [this](auto &&p) { return constants.too_far(p.xy); });
+    // Reset the simulation (R) or if in demo for long enough.
+    if (!reset_sent && (user.wants_reset() || (user.control.demo &&
+                                               user.elapsed_sec() >= 30.0f)))
+      reset_sent = s.send({reset});
 
     // General interactions.
-    user.rotate_debug_opts(), user.adjust_fly(), user.pan(), user.zoom();
-
-    // Spawn particles when asked.
-    // Also, clear user.control.demo, and lower the gravitational constant.
+    user.rotate_debug_opts(), user.pan(), user.zoom();
+    auto const flying = user.control.fly;
+    user.adjust_fly();
+    if (flying != user.control.fly)
+      s.send({fly, {}, user.control.fly});
+
+    // Save a checkpoint when asked.
+    if (user.wants_checkpoint())
+      s.send({save});
+
+    // Tell the simulation what is in view. Add a margin, as its snapshots
+    // lag a frame or two behind panning and zooming. Groups of particles
+    // under a pixel in radius are drawn as one.
+    auto constexpr MARGIN = 0.25f, LOD_PIXELS = 1.0f;
+    auto const w = user.window();
+    auto const m = MARGIN * (w.gg - w.ll);
+    if (auto v = View{w.ll - m, w.gg + m, LOD_PIXELS / user.cam.zoom};
+        v != shown && s.send({view, {}, {}, v}))
+      shown = v;
+
+    // Spawn particles when asked. Also, clear user.control.demo.
     if (auto xy = user.wants_spawn_particle(); xy.has_value()) {
       user.control.demo = false;
 
-      // When user controls, reset the gravitational constant.
-      table.G = constants.G;
-
       // Make sure the mouse is moving quickly (pixels per frame).
       // (Prevent cramping).
       auto constexpr FAST_ENOUGH = 4.0f;
@@ -157,73 +103,103 @@ struct State {
           std::hypot(delta.x, delta.y) < FAST_ENOUGH) {
         // Resume a normal course of action.
         user.control.spawned_last_frame = false;
-        goto simulate;
-      }
-      // Spawn a random particle at the mouse location.
-      auto p = constants.random_particle(rng); // Mass and radius only.
-      p.xy = xy.value();
-      table.push_back(p);
-
-      // If too many particles, remove a random particle.
-      if (table.size() > constants.PARTICLES_LIMIT) {
-        std::uniform_int_distribution<size_t> d{0, table.size()};
-        table.erase(table.begin() + d(rng));
+      } else {
+        // The simulation lowers the gravitational constant, too.
+        s.send({spawn, xy.value()});
+        user.control.spawned_last_frame = true;
       }
-
-      user.control.spawned_last_frame = true;
     } else {
       user.control.spawned_last_frame = false;
     }
 
-  simulate:
-    // Do the simulation!
-    if (user.control.fly) {
-      table.step(dt);
-
-      // Remove statistical bias in collision handling routine.
-      // (See refresh_disk()'s comments for details.)
-      table.refresh_disk();
-
-      // Inspect for such things as NaN and Infinity.
-      if (!table.good())
-        // NaN or infinity somewhere. Reset the simulation.
-        goto reset_sim;
-    }
+    if (snapshot.map_number != background_number)
+      show_map(snapshot);
 
     BeginDrawing();
     ClearBackground(BLACK);
 
-    // Draw all particles (p) visible in the window (w).
+    // Draw what the simulation found in view.
     BeginMode2D(user.cam);
-    for (auto w = user.window(); auto &&p : table)
-      if (auto c = p.circle(); dyn::intersect::disk_rectangle(c, w.ll, w.gg))
-        user.particle(c);
+    if (background.id) {
+      auto const size = snapshot.map_gg - snapshot.map_ll;
+      DrawTexturePro(background,
+                     {0.0f, 0.0f, float(background.width),
+                      float(background.height)},
+                     {snapshot.map_ll.real(), snapshot.map_ll.imag(),
+                      size.real(), size.imag()},
+                     {}, 0.0f, WHITE);
+    }
+    for (auto &&c : snapshot.circles)
+      user.particle(c);
     EndMode2D();
 
     // Compose text and show it.
-    user.hud(table.size(), constants.PARTICLES_LIMIT);
+    user.hud(snapshot.particles, settings.constants.PARTICLES_LIMIT,
+             snapshot.circles.size(), snapshot.conserved, snapshot.energy0);
     EndDrawing();
-    return;
+  }
 
-  reset_sim:
-    user = make_user();
-    table = make_table();
+  /// Tone-map the latest map of the snapshot into the background texture.
+  void show_map(Snapshot const &snapshot) {
+    auto const w = snapshot.map_width, h = snapshot.map_height;
+    splat::Image image{w, h};
+    if (settings.map == Table<>::Map::potential) {
+      // The depth of the potential below its highest point in view.
+      auto const top = std::ranges::max(snapshot.map);
+      std::ranges::transform(snapshot.map, image.data(),
+                             [top](float x) { return top - x; });
+    } else {
+      std::ranges::copy(snapshot.map, image.data());
+    }
+    auto rgb = image.rgb();
+    if (background.id && (background.width != w || background.height != h))
+      UnloadTexture(background), background = {};
+    if (background.id)
+      UpdateTexture(background, rgb.data());
+    else
+      background = LoadTextureFromImage(
+          {rgb.data(), w, h, 1, PIXELFORMAT_UNCOMPRESSED_R8G8B8});
+    background_number = snapshot.map_number;
+  }
+
+#if !defined(PLATFORM_WEB)
+  /// Show a recorded trajectory (no simulation; decode and draw).
+  void play(trajectory::Player &player) {
+    user.rotate_debug_opts(), user.pan(), user.zoom();
+    if (IsKeyPressed(KEY_SPACE))
+      player.toggle();
+    if (auto n = user.wants_step())
+      player.seek(int64_t(player.position()) + n);
+    if (auto j = user.wants_jump())
+      player.seek(j > 0 ? int64_t(player.size()) : 0);
+    if (auto k = user.wants_speed())
+      player.scale_speed(k > 0 ? 2.0 : 0.5);
+    if (user.wants_reverse())
+      player.reverse();
+    player.advance(GetFrameTime());
 
-    // (Do this or else hang.)
     BeginDrawing();
+    ClearBackground(BLACK);
+    auto const *frame = player.frame();
+    BeginMode2D(user.cam);
+    if (frame)
+      for (auto w = user.window(); auto &&s : frame->particles)
+        if (auto c = dyn::Circle<float>{s.xy, s.radius};
+            dyn::intersect::disk_rectangle(c, w.ll, w.gg))
+          user.particle(c);
+    EndMode2D();
+    user.hud_replay(player, frame);
     EndDrawing();
   }
+#endif
 
   User make_user() const {
     User u;
-    if (constants.flags.galaxies)
+    auto const &f = settings.constants.flags;
+    if (f.galaxies || f.plummer || settings.resume || settings.initial)
       u.control.demo = false;
     return u;
   }
-
-  Table<> make_table() {
-    return constants.flags.galaxies ? galaxies(constants) : figure8();
-  }
 } state;
 } // namespace main_program
 
@@ -236,15 +212,19 @@ static int do_main() {
   InitWindow(600, 600, "Grass Gravity Simulation");
 
 #if defined(PLATFORM_WEB)
-  state.constants.flags.galaxies = true;
-  state.constants.PARTICLES_LIMIT = 2500;
+  state.settings.constants.flags.galaxies = true;
+  state.settings.constants.PARTICLES_LIMIT = 2500;
   state.user = state.make_user();
-  state.table = state.make_table();
+  // (No threads; the main loop ticks the simulation.)
+  state.sim.emplace(state.settings);
   emscripten_set_main_loop(do_loop, 0, 1);
 #else
-  state.constants = []() {
+  auto &&settings = state.settings;
+  settings.constants = []() {
     Constants c;
     c.flags.galaxies = env::get("GRASS_GALAXIES").has_value();
+    c.flags.plummer = env::get("GRASS_PLUMMER").has_value();
+    c.seed = env::number<uint64_t>("GRASS_SEED");
     if (auto s = env::get("GRASS_PARTICLES_LIMIT"); s.has_value()) {
       try {
         auto n = size_t(std::stoul(s.value()));
@@ -258,10 +238,63 @@ static int do_main() {
     }
     return c;
   }();
+  if (auto s = env::get("GRASS_CHECKPOINT"); s.has_value() && !s->empty())
+    settings.checkpoint = s.value(), settings.resume = true;
+  if (auto s = env::get("GRASS_LOAD"); s.has_value() && !s->empty())
+    settings.initial = s;
+  if (auto r = env::number<double>("GRASS_SIM_RATE"))
+    settings.rate = r.value();
+  if (auto a = env::number<float>("GRASS_ACCRETION"); a && *a > 0.0f)
+    settings.accretion = *a;
+  if (auto k = env::number<uint64_t>("GRASS_ROLLBACK_EVERY"); k && *k)
+    settings.rollback.every = *k;
+  if (auto k = env::number<unsigned>("GRASS_ROLLBACK_DEPTH"))
+    settings.rollback.depth = *k;
+  if (auto k = env::number<uint64_t>("GRASS_CONSERVED_EVERY"))
+    settings.conserved_every = *k;
+  if (auto s = env::get("GRASS_BACKGROUND"); s == "potential")
+    settings.map = Table<>::Map::potential;
+  else if (s == "field")
+    settings.map = Table<>::Map::field;
+  state.user = state.make_user();
+  auto &&sim = state.sim.emplace(settings);
+  if (auto s = env::get("GRASS_REPLAY"); s.has_value() && !s->empty()) {
+    try {
+      state.replay.emplace(s.value());
+    } catch (std::runtime_error const &e) {
+      TraceLog(LOG_WARNING, "%s", e.what());
+    }
+  }
+  if (auto s = env::get("GRASS_RECORD"); s.has_value() && !s->empty()) {
+    trajectory::Recorder::Options o;
+    o.every = std::max(env::number<uint32_t>("GRASS_RECORD_EVERY").value_or(1),
+                       uint32_t(1));
+    o.reserve = settings.constants.PARTICLES_LIMIT;
+    try {
+      sim.record(s.value(), o);
+    } catch (std::runtime_error const &e) {
+      TraceLog(LOG_WARNING, "%s", e.what());
+    }
+  }
+  if (auto s = env::get("GRASS_SHM"); s.has_value() && !s->empty()) {
+    try {
+      sim.share(s.value());
+    } catch (std::runtime_error const &e) {
+      TraceLog(LOG_WARNING, "%s", e.what());
+    }
+  }
+  // Simulate at the simulation's rate and draw at the display's.
+  if (!state.replay)
+    sim.start();
   SetTargetFPS(state.user.control.target_fps);
   while (!WindowShouldClose()) {
     do_loop();
   }
+  // Stop the simulation and finish writing the trajectory (if any).
+  state.sim.reset();
+  state.replay.reset();
+  if (state.background.id)
+    UnloadTexture(state.background);
   CloseWindow();
 #endif
   return 0;
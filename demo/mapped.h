@@ -0,0 +1,154 @@
+#ifndef GRASS_MAPPED_H
+#define GRASS_MAPPED_H
+
+/// @file mapped.h
+/// @brief Read-only memory mapping of a whole file.
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace phy {
+
+/// @brief A file mapped into memory, read-only, for the lifetime of the object.
+/// The pages are loaded lazily by the operating system (page faults), so
+/// opening a file costs the same regardless of its size.
+class MappedFile {
+  /// @brief First byte and the number of bytes, respectively.
+  std::byte const *p{};
+  size_t n{};
+
+#ifdef _WIN32
+  HANDLE file{INVALID_HANDLE_VALUE}, mapping{};
+#endif
+
+  void close() noexcept {
+#ifdef _WIN32
+    if (p)
+      UnmapViewOfFile(p);
+    if (mapping)
+      CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE)
+      CloseHandle(file);
+    file = INVALID_HANDLE_VALUE, mapping = {};
+#else
+    if (p)
+      munmap(const_cast<std::byte *>(p), n);
+#endif
+    p = {}, n = {};
+  }
+
+public:
+  /// @brief Map nothing.
+  MappedFile() = default;
+
+  /// @brief Map the entire file at `path`.
+  /// @throws std::runtime_error If the file cannot be opened or mapped.
+  explicit MappedFile(std::string const &path) {
+    auto fail = [&path](char const *what) {
+      return std::runtime_error{path + ": " + what};
+    };
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                       OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+      throw fail("cannot open");
+    LARGE_INTEGER size{};
+    if (!GetFileSizeEx(file, &size))
+      throw close(), fail("cannot query size");
+    n = size_t(size.QuadPart);
+    if (!n)
+      return;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping)
+      throw close(), fail("cannot map");
+    p = static_cast<std::byte const *>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!p)
+      throw close(), fail("cannot map");
+#else
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw fail("cannot open");
+    struct stat st {};
+    if (fstat(fd, &st))
+      throw ::close(fd), fail("cannot query size");
+    n = size_t(st.st_size);
+    if (!n) {
+      ::close(fd);
+      return;
+    }
+    auto q = mmap(nullptr, n, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping keeps its own reference to the file.
+    ::close(fd);
+    if (q == MAP_FAILED)
+      throw n = {}, fail("cannot map");
+    p = static_cast<std::byte const *>(q);
+#endif
+  }
+
+  MappedFile(MappedFile const &) = delete;
+  MappedFile &operator=(MappedFile const &) = delete;
+
+  MappedFile(MappedFile &&m) noexcept { *this = std::move(m); }
+
+  MappedFile &operator=(MappedFile &&m) noexcept {
+    if (this != &m) {
+      close();
+      p = std::exchange(m.p, {}), n = std::exchange(m.n, {});
+#ifdef _WIN32
+      file = std::exchange(m.file, INVALID_HANDLE_VALUE);
+      mapping = std::exchange(m.mapping, {});
+#endif
+    }
+    return *this;
+  }
+
+  ~MappedFile() { close(); }
+
+  /// @brief First byte of the file (null if empty).
+  [[nodiscard]] std::byte const *data() const noexcept { return p; }
+
+  /// @brief Size of the file in bytes.
+  [[nodiscard]] size_t size() const noexcept { return n; }
+
+  /// @brief Hint that the given range will be read soon (so that the operating
+  /// system can start reading it in) or, with `need` false, not again soon (so
+  /// that its pages can be reclaimed first). Out-of-range parts are ignored.
+  void advise(size_t offset, size_t bytes, bool need = true) const noexcept {
+#ifdef _WIN32
+    // No portable equivalent; the page cache still reads ahead sequentially.
+    (void)offset, (void)bytes, (void)need;
+#else
+    if (offset >= n)
+      return;
+    bytes = std::min(bytes, n - offset);
+    // madvise wants a page-aligned start.
+    auto const page = size_t(sysconf(_SC_PAGESIZE));
+    auto const start = offset / page * page;
+    madvise(const_cast<std::byte *>(p) + start, bytes + (offset - start),
+            need ? MADV_WILLNEED : MADV_DONTNEED);
+#endif
+  }
+};
+
+} // namespace phy
+
+#endif // GRASS_MAPPED_H
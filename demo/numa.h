@@ -0,0 +1,233 @@
+#ifndef GRASS_NUMA_H
+#define GRASS_NUMA_H
+
+/// @file numa.h
+/// @brief Place memory near the threads that use it, and pin the threads, on
+/// machines of several NUMA nodes (sockets).
+///
+/// Linux gives a page the memory of the node of the thread that first writes
+/// it. Arrays built by one thread (the particles, sorted, and the tree) thus
+/// sit on one node, and the threads of the other nodes read all of them
+/// across the interconnect. `place` gives the pages of an array back to the
+/// system and has each thread of the force loop write its share again, in
+/// the chunks that the loop's static schedule gives it (contiguous: the
+/// particles are in Z-order, so a chunk is a region of space, whose groups
+/// the tree also has nearby). For the chunks to stay with their threads,
+/// `pin` binds the threads to CPUs, such as those of `cpus("auto")`: the
+/// first threads on the first node, and so on.
+///
+/// Without Linux, `place` does nothing. With one node, it would copy the
+/// array for nothing: see `several`, which `Table` asks first. The top of the
+/// tree, which every walk reads, is not replicated per node (it is small and
+/// stays in the caches).
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <type_traits>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if defined(__linux__)
+#define GRASS_NUMA 1
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace phy::numa {
+
+/// @brief Read a list of CPUs or nodes, as Linux writes them ("0-3,8,10-11").
+/// @throw std::invalid_argument If it is not one.
+inline std::vector<int> parse(std::string_view list) {
+  std::vector<int> v;
+  while (!list.empty() && (list.back() == '\n' || list.back() == ' '))
+    list.remove_suffix(1);
+  auto const number = [list](char const *&p, char const *last) {
+    int k{};
+    auto [q, e] = std::from_chars(p, last, k);
+    if (e != std::errc{} || k < 0)
+      throw std::invalid_argument{"not a list of CPUs: " + std::string{list}};
+    p = q;
+    return k;
+  };
+  for (auto p = list.data(), last = p + list.size(); p != last;) {
+    auto const a = number(p, last);
+    auto b = a;
+    if (p != last && *p == '-')
+      b = number(++p, last);
+    if (b < a || (p != last && *p != ','))
+      throw std::invalid_argument{"not a list of CPUs: " + std::string{list}};
+    if (p != last && ++p == last)
+      throw std::invalid_argument{"not a list of CPUs: " + std::string{list}};
+    for (auto k = a; k <= b; k++)
+      v.push_back(k);
+  }
+  return v;
+}
+
+namespace detail {
+
+/// The contents of a file of the system, if it is there.
+inline std::string read(std::string const &path) {
+  std::ifstream in{path};
+  return {std::istreambuf_iterator<char>{in}, {}};
+}
+
+/// The CPUs that this process may run on, in order.
+inline std::vector<int> allowed() {
+#ifdef GRASS_NUMA
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  if (!sched_getaffinity(0, sizeof set, &set)) {
+    std::vector<int> v;
+    for (int k = 0; k < CPU_SETSIZE; k++)
+      if (CPU_ISSET(k, &set))
+        v.push_back(k);
+    return v;
+  }
+#endif
+  return {0};
+}
+
+} // namespace detail
+
+/// @brief The NUMA nodes of the machine (just 0 if it does not tell).
+inline std::vector<int> nodes() {
+  try {
+    if (auto v = parse(detail::read("/sys/devices/system/node/online"));
+        !v.empty())
+      return v;
+  } catch (std::invalid_argument const &) {
+  }
+  return {0};
+}
+
+/// @brief Whether the machine has several NUMA nodes, so that placing
+/// memory may pay (as found once).
+inline bool several() {
+  static bool const several = nodes().size() > 1;
+  return several;
+}
+
+/// @brief The CPUs to pin threads to, in order: "auto" for those that this
+/// process may run on, node by node, or else a list of them (see `parse`).
+inline std::vector<int> cpus(std::string_view spec) {
+  if (spec != "auto")
+    return parse(spec);
+  auto const allowed = detail::allowed();
+  std::vector<int> v;
+  for (auto node : nodes()) {
+    try {
+      for (auto k : parse(detail::read("/sys/devices/system/node/node" +
+                                       std::to_string(node) + "/cpulist")))
+        if (std::ranges::binary_search(allowed, k) && !std::ranges::count(v, k))
+          v.push_back(k);
+    } catch (std::invalid_argument const &) {
+    }
+  }
+  // (The CPUs of no node, if the system does not tell.)
+  for (auto k : allowed)
+    if (!std::ranges::count(v, k))
+      v.push_back(k);
+  return v;
+}
+
+/// @brief Pin the i-th thread of the parallel loops to the i-th CPU of the
+/// list (round robin), for as long as the threads are kept. Return how many
+/// threads were pinned.
+inline size_t pin(std::span<int const> cpus) {
+  if (cpus.empty())
+    return 0;
+  size_t pinned{};
+#pragma omp parallel reduction(+ : pinned)
+  {
+#ifdef _OPENMP
+    auto const t = size_t(omp_get_thread_num());
+#else
+    auto const t = size_t{};
+#endif
+#ifdef GRASS_NUMA
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpus[t % cpus.size()], &set);
+    if (!sched_setaffinity(0, sizeof set, &set))
+      ++pinned;
+#else
+    (void)t;
+#endif
+  }
+  return pinned;
+}
+
+/// @brief Give the pages of the array back to the system and write it again,
+/// each thread the chunk of it that a `schedule(static)` loop over it gives
+/// that thread, so that its pages are on that thread's node. Return whether
+/// any pages were given back (only whole pages are).
+template <class T>
+requires std::is_trivially_copyable_v<T>
+bool place(std::span<T> s) {
+#ifdef GRASS_NUMA
+  auto const page = uintptr_t(sysconf(_SC_PAGESIZE));
+  auto const at = reinterpret_cast<uintptr_t>(s.data());
+  auto const first = (at + page - 1) / page * page,
+             last = (at + s.size_bytes()) / page * page;
+  if (first >= last)
+    return false;
+  std::vector<T> copy(s.begin(), s.end());
+  if (madvise(reinterpret_cast<void *>(first), last - first, MADV_DONTNEED))
+    return false;
+  auto const m = static_cast<int64_t>(s.size());
+  int64_t i = 0;
+#pragma omp parallel for schedule(static)
+  for (i = 0; i < m; ++i)
+    std::memcpy(&s[size_t(i)], &copy[size_t(i)], sizeof(T));
+  return true;
+#else
+  (void)s;
+  return false;
+#endif
+}
+
+/// @brief The number of the pages of the array on each node (by the number
+/// of the node; none if the system does not tell).
+template <class T> std::vector<size_t> census(std::span<T const> s) {
+  std::vector<size_t> count;
+#if defined(GRASS_NUMA) && defined(SYS_move_pages)
+  auto const page = uintptr_t(sysconf(_SC_PAGESIZE));
+  auto const at = reinterpret_cast<uintptr_t>(s.data());
+  std::vector<void *> pages;
+  for (auto p = at / page * page; p < at + s.size_bytes(); p += page)
+    pages.push_back(reinterpret_cast<void *>(p));
+  std::vector<int> status(pages.size(), -1);
+  // (No nodes to move to: where they are.)
+  if (pages.empty() || syscall(SYS_move_pages, 0, pages.size(), pages.data(),
+                               nullptr, status.data(), 0))
+    return count;
+  for (auto node : status)
+    if (node >= 0) {
+      count.resize(std::max(count.size(), size_t(node) + 1));
+      ++count[size_t(node)];
+    }
+#else
+  (void)s;
+#endif
+  return count;
+}
+
+} // namespace phy::numa
+
+#endif // GRASS_NUMA_H
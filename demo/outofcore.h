@@ -0,0 +1,509 @@
+#ifndef GRASS_OUTOFCORE_H
+#define GRASS_OUTOFCORE_H
+
+/// @file outofcore.h
+/// @brief Step a checkpoint too large to hold in memory (see checkpoint.h),
+/// streaming its particles from and to disk block by block.
+///
+/// The particles of a checkpoint are in Morton order, so a block (a run of
+/// consecutive particles) holds particles that are close together. Each block
+/// is cut into cells of a few particles along its Morton codes, and only the
+/// cells' moments (center of mass, mass, and a circle holding their disks) and
+/// a tree over them are kept in memory. A step then streams the blocks in
+/// order through the file's memory mapping: each particle walks the tree of
+/// cells as `Table::step` walks its tree, and the cells that are too close to
+/// stand for their particles are opened and summed over particle by particle,
+/// in their blocks (the block itself and its neighbors). The block is then
+/// integrated (velocity Verlet, as `Table::step`) and written out, sorted
+/// again by Morton code, together with the cells of the next step.
+///
+/// A read-ahead thread runs a few blocks ahead, asking for the pages of each
+/// block and of the neighboring blocks whose cells its particles may open, so
+/// that reading overlaps computing. The forces are summed over the particles
+/// where they were at the start of the step (all reads are of the file being
+/// stepped), so the step is written to a new file, which replaces the old one
+/// at the end, as `checkpoint::save` does.
+///
+/// Particles are never merged (see `Table::accretion`), and the order is
+/// refreshed within each block only: as particles cross blocks, the blocks
+/// spread out and more cells are opened, but the forces do not change (the
+/// moments always hold the particles where they are). Saving the checkpoint
+/// again from a `Table` restores the order.
+
+#include <algorithm>
+#include <barnes_hut.h>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <newton.h>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <verlet.h>
+
+#include "checkpoint.h"
+
+namespace phy::outofcore {
+
+struct Options {
+  /// Particles per block (what is read and written at a time).
+  size_t block{size_t(1) << 16};
+
+  /// Most particles per cell (the leaves of the tree kept in memory).
+  size_t cell{16};
+
+  /// Read this many blocks ahead of the one being stepped.
+  size_t ahead{2};
+};
+
+/// @brief What a step did.
+struct Stats {
+  size_t particles{}, blocks{}, cells{};
+
+  /// Bytes of the cells and of the tree over them (what stays in memory
+  /// besides the blocks being read and written).
+  size_t resident{};
+
+  /// Cells opened per particle, on average over both force evaluations.
+  double opened{};
+
+  /// Whether every particle written is finite (see `Table::good`).
+  bool good{true};
+
+  /// Wall time [s].
+  double seconds{};
+};
+
+namespace detail {
+
+/// @brief A run of particles of a block whose Morton codes share a prefix,
+/// with their moments.
+struct Cell {
+  /// Center of mass [L].
+  std::complex<float> xy;
+
+  /// Radius of a circle about `xy` that holds the particles' disks [L], and
+  /// the mass [M].
+  float radius{}, mass{};
+
+  /// The particles, [first, last), and the Morton code of the first.
+  uint64_t first{}, last{}, morton{};
+};
+
+/// "Extra data" of a group of cells (see `dyn::bh32::Group`).
+struct Moments {
+  using I = std::vector<Cell>::const_iterator;
+
+  std::complex<float> xy;
+  float radius{}, mass{};
+  I first, last;
+
+  Moments() = default;
+
+  Moments(I const first, I const last) : first{first}, last{last} {
+    std::complex<double> xyd;
+    double m{};
+    for (auto i = first; i != last; ++i)
+      m += i->mass, xyd += double(i->mass) * std::complex<double>{i->xy};
+    mass = float(m);
+    xy = m > 0.0 ? std::complex<float>{xyd / m} : first->xy;
+    for (auto i = first; i != last; ++i)
+      radius = std::max(radius, i->radius + std::abs(i->xy - xy));
+  }
+
+  /// Merge the cells of p (which come after these).
+  Moments &operator+=(Moments const &p) {
+    auto const sum = mass + p.mass;
+    auto const xy0 = xy;
+    if (sum > 0.0f)
+      xy = mass / sum * xy + p.mass / sum * p.xy;
+    radius = std::max(radius + std::abs(xy0 - xy),
+                      p.radius + std::abs(p.xy - xy));
+    mass = sum, last = p.last;
+    return *this;
+  }
+
+  [[nodiscard]] dyn::Circle<float> circle() const { return {xy, radius}; }
+};
+
+using Tree = dyn::bh32::Tree<Moments, Moments::I>;
+
+/// @brief The opening criterion of `Table::accelerate`: whether the particles
+/// of a group are to be looked at rather than the group as a whole, from a
+/// particle of radius r at the square of the distance `norm` from its center.
+[[nodiscard]] inline bool open(Moments const &g, float norm, float r,
+                               float tan_angle) noexcept {
+  auto const rsq = g.radius * g.radius;
+  return norm < rsq || norm < r * r || tan_angle * tan_angle < rsq / norm;
+}
+
+/// @brief The acceleration [L/T/T] of a particle at the circle c (as
+/// `Table::accelerate`): the field of each group of the tree that is far
+/// enough to stand for its particles, and `sum_cell(cell)` for each cell that
+/// is not (the field of its particles, but for the particle's own).
+[[nodiscard]] inline std::complex<float>
+walk(Tree const &tree, dyn::Circle<float> c, float tan_angle, float G,
+     dyn::Gravity<> const &gravity, auto &&sum_cell) {
+  std::complex<float> a{};
+  tree->depth_first([&](Moments const &g) {
+    auto const norm = std::norm(g.xy - c);
+    if (!open(g, norm, c.radius, tan_angle)) {
+      a += gravity.field(c, g.circle(), G * g.mass, std::sqrt(norm));
+      return false;
+    }
+    if (g.last - g.first > 1)
+      return true;
+    a += sum_cell(g.first);
+    return false;
+  });
+  return a;
+}
+
+/// @brief Cut the indices [0, n) of particles sorted by their Morton codes z
+/// into runs of up to `most` particles, `emit(a, b)` for each run [a, b):
+/// split a run by the next two bits of its codes (a quadrant) until it is
+/// small enough.
+inline void split(std::span<uint64_t const> z, size_t most, auto &&emit) {
+  auto const split = [&](auto &&split, size_t a, size_t b) -> void {
+    if (b - a <= most)
+      return emit(a, b);
+    auto const differ = z[a] ^ z[b - 1];
+    if (!differ) {
+      // The same code throughout: cut by count.
+      for (; a < b; a += most)
+        emit(a, std::min(a + most, b));
+      return;
+    }
+    // The two bits of the highest level at which the codes differ.
+    auto const shift = unsigned(63 - std::countl_zero(differ)) & ~1u;
+    auto const quadrant = [shift](uint64_t code) { return code >> shift & 3; };
+    auto const first = a;
+    for (auto q = quadrant(z[a]); a < b; q++) {
+      auto const c = size_t(
+          std::partition_point(z.begin() + ptrdiff_t(a),
+                               z.begin() + ptrdiff_t(b),
+                               [&](uint64_t w) { return quadrant(w) <= q; }) -
+          z.begin());
+      if (a == first && c == b) {
+        // Not sorted after all: cut by count.
+        for (; a < b; a += most)
+          emit(a, std::min(a + most, b));
+        return;
+      }
+      if (c > a)
+        split(split, a, c), a = c;
+    }
+  };
+  if (!z.empty())
+    split(split, 0, z.size());
+}
+
+/// @brief Cut the particles [0, n) of a block (sorted by their Morton codes
+/// z), the first of which is particle `base` of the file, into cells of up to
+/// `most` particles (see `split`).
+inline void cut(std::span<uint64_t const> z,
+                std::span<std::complex<float> const> xy,
+                std::span<float const> mass, std::span<float const> radius,
+                uint64_t base, size_t most, std::vector<Cell> &out) {
+  split(z, most, [&](size_t a, size_t b) {
+    std::complex<double> xyd;
+    double m{};
+    for (auto i = a; i < b; i++)
+      m += mass[i], xyd += double(mass[i]) * std::complex<double>{xy[i]};
+    Cell c{m > 0.0 ? std::complex<float>{xyd / m} : xy[a], 0.0f, float(m),
+           base + a, base + b, z[a]};
+    for (auto i = a; i < b; i++)
+      c.radius = std::max(c.radius, radius[i] + std::abs(xy[i] - c.xy));
+    out.push_back(c);
+  });
+}
+
+/// @brief Ask for the pages of blocks ahead of time, on a thread of its own:
+/// `fetch(k)` is called for k = 0, 1, ... as far as wanted.
+class ReadAhead {
+  std::mutex mutex;
+  std::condition_variable cv;
+  size_t wanted{};
+  bool stop{};
+  std::thread thread;
+
+public:
+  template <class F> explicit ReadAhead(F fetch) {
+    thread = std::thread{[this, fetch = std::move(fetch)] {
+      for (size_t k = 0;; k++) {
+        {
+          std::unique_lock lock{mutex};
+          cv.wait(lock, [this, k] { return k < wanted || stop; });
+          if (stop)
+            return;
+        }
+        fetch(k);
+      }
+    }};
+  }
+
+  ReadAhead(ReadAhead const &) = delete;
+  ReadAhead &operator=(ReadAhead const &) = delete;
+
+  ~ReadAhead() {
+    {
+      std::lock_guard lock{mutex};
+      stop = true;
+    }
+    cv.notify_one();
+    thread.join();
+  }
+
+  /// @brief Fetch the blocks before k (if not fetched yet).
+  void want(size_t k) {
+    {
+      std::lock_guard lock{mutex};
+      wanted = std::max(wanted, k);
+    }
+    cv.notify_one();
+  }
+};
+
+/// @brief Read a byte of each page of the particles [first, last) of a
+/// checkpoint, so that they are in memory when they are needed.
+inline void touch(checkpoint::Checkpoint const &c, size_t first, size_t last) {
+  auto constexpr PAGE = size_t(4096);
+  last = std::min(last, c.size());
+  if (first >= last)
+    return;
+  c.advise(first, last - first);
+  unsigned char sum{};
+  auto const read = [&](auto span) {
+    auto const *p =
+        reinterpret_cast<unsigned char const *>(span.data() + first);
+    auto const bytes = (last - first) * sizeof span[0];
+    for (size_t b = 0; b < bytes; b += PAGE)
+      sum ^= p[b];
+  };
+  read(c.morton()), read(c.xy()), read(c.v()), read(c.mass()),
+      read(c.radius());
+  // (Keep the reads.)
+  [[maybe_unused]] auto volatile sink = sum;
+}
+
+} // namespace detail
+
+/// @brief Step the checkpoint at a path in place, out of core (see the top of
+/// the file).
+class Stepper {
+  std::string path;
+  Options o;
+  dyn::Gravity<> gravity;
+
+  /// The cells of the checkpoint as it is now (made by the previous step), and
+  /// the first cell of each block (and the end).
+  std::vector<detail::Cell> cells;
+  std::vector<size_t> block_cells;
+
+  /// Cut the checkpoint into cells, block by block.
+  void cut(checkpoint::Checkpoint const &in) {
+    auto const n = in.size(), blocks = (n + o.block - 1) / o.block;
+    cells.clear(), block_cells.assign(1, 0);
+    detail::ReadAhead ahead{[&in, this](size_t k) {
+      detail::touch(in, k * o.block, (k + 1) * o.block);
+    }};
+    for (size_t k = 0; k < blocks; k++) {
+      ahead.want(k + 1 + o.ahead);
+      auto const b0 = k * o.block, m = std::min(o.block, n - b0);
+      detail::cut(in.morton().subspan(b0, m), in.xy().subspan(b0, m),
+                  in.mass().subspan(b0, m), in.radius().subspan(b0, m), b0,
+                  o.cell, cells);
+      block_cells.push_back(cells.size());
+    }
+  }
+
+  /// The blocks whose cells a particle of block k may open (sorted).
+  [[nodiscard]] std::vector<size_t>
+  neighbors(detail::Tree const &tree, size_t k, float tan_angle) const {
+    std::vector<bool> near(block_cells.size() - 1);
+    if (!tree)
+      return {};
+    for (auto c = block_cells[k]; c < block_cells[k + 1]; c++) {
+      auto const &cell = cells[c];
+      // The particles of the cell (and their radii) are within its circle.
+      tree->depth_first([&](detail::Moments const &g) {
+        auto const d = std::max(std::abs(g.xy - cell.xy) - cell.radius, 0.0f);
+        if (!detail::open(g, d * d, cell.radius, tan_angle))
+          return false;
+        if (g.last - g.first > 1)
+          return true;
+        near[size_t(g.first->first / o.block)] = true;
+        return false;
+      });
+    }
+    std::vector<size_t> v;
+    for (size_t b = 0; b < near.size(); b++)
+      if (near[b])
+        v.push_back(b);
+    return v;
+  }
+
+public:
+  /// @param path A checkpoint (see checkpoint.h).
+  explicit Stepper(std::string path, Options const &o = {})
+      : path{std::move(path)}, o{o} {
+    this->o.block = std::max(this->o.block, size_t(1));
+    this->o.cell = std::max(this->o.cell, size_t(1));
+  }
+
+  /// @brief Take a step and replace the checkpoint with its result.
+  /// @param dt Step size [T].
+  /// @throws std::runtime_error If the checkpoint cannot be read (see
+  /// `checkpoint::Checkpoint`) or the result cannot be written.
+  Stats step(float dt) {
+    using clock = std::chrono::steady_clock;
+    namespace bh = dyn::bh32;
+    auto const t0 = clock::now();
+    auto const tmp = path + ".tmp";
+    Stats stats;
+    {
+      checkpoint::Checkpoint const in{path};
+      auto const n = in.size(), blocks = (n + o.block - 1) / o.block;
+      if (block_cells.size() != blocks + 1 ||
+          (blocks && block_cells.back() != cells.size()))
+        cut(in);
+      auto const G = in.G(), tan_angle = in.tan_angle_threshold();
+      auto const tree = bh::tree<detail::Moments>(
+          cells.cbegin(), cells.cend(),
+          [](detail::Cell const &c, uint64_t mask) { return c.morton & mask; });
+      stats.particles = n, stats.blocks = blocks, stats.cells = cells.size();
+      stats.resident = cells.capacity() * sizeof(detail::Cell);
+      if (tree)
+        tree->depth_first([&stats](auto &&) {
+          stats.resident += sizeof(bh::detail::Group<detail::Moments,
+                                                     detail::Moments::I>);
+          return true;
+        });
+
+      auto const xy = in.xy(), v = in.v();
+      auto const mass = in.mass(), radius = in.radius();
+      // The acceleration [L/T/T] of particle i if it were at the circle c (as
+      // `Table::accelerate`), and the number of cells opened.
+      auto const accelerate = [&](dyn::Circle<float> c, uint64_t i,
+                                  uint64_t &opened) {
+        return detail::walk(tree, c, tan_angle, G, gravity, [&](auto cell) {
+          // A cell to open: sum over its particles.
+          ++opened;
+          std::complex<float> a{};
+          for (auto j = cell->first; j < cell->last; j++)
+            if (j != i)
+              a += gravity.field(c, {xy[j], radius[j]}, G * mass[j]);
+          return a;
+        });
+      };
+
+      // Write the header now and the arrays block by block.
+      checkpoint::Header h;
+      h.count = n, h.G = G, h.tan_angle_threshold = tan_angle;
+      checkpoint::Layout const l{n};
+      std::ofstream f{tmp, std::ios::binary | std::ios::trunc};
+      if (!f)
+        throw std::runtime_error{tmp + ": cannot open for writing"};
+      f.write(reinterpret_cast<char const *>(&h), sizeof h);
+      auto const put = [&f](uint64_t offset, auto const &array) {
+        f.seekp(std::streamoff(offset));
+        f.write(reinterpret_cast<char const *>(array.data()),
+                std::streamsize(array.size() * sizeof array[0]));
+      };
+
+      detail::ReadAhead ahead{[&, this](size_t k) {
+        if (k >= blocks)
+          return;
+        detail::touch(in, k * o.block, (k + 1) * o.block);
+        for (auto b : neighbors(tree, k, tan_angle))
+          detail::touch(in, b * o.block, (b + 1) * o.block);
+      }};
+      std::vector<detail::Cell> next;
+      std::vector<size_t> next_block_cells{0};
+      std::vector<std::complex<float>> xy1, v1, out_xy, out_v;
+      std::vector<float> out_mass, out_radius;
+      std::vector<uint64_t> z, out_z;
+      std::vector<size_t> order;
+      uint64_t opened{};
+      for (size_t k = 0; k < blocks; k++) {
+        ahead.want(k + 1 + o.ahead);
+        auto const b0 = k * o.block, m = std::min(o.block, n - b0);
+        xy1.resize(m), v1.resize(m);
+        auto const count = static_cast<int>(m);
+        auto j = 0;
+#pragma omp parallel for reduction(+ : opened)
+        for (j = 0; j < count; ++j) {
+          auto const i = b0 + size_t(j);
+          uint64_t cells_opened{};
+          auto ig = dyn::Verlet<float>{xy[i], v[i]};
+          ig.step(dt, [&](auto p) {
+            return accelerate({p, radius[i]}, i, cells_opened);
+          });
+          xy1[size_t(j)] = ig.y0, v1[size_t(j)] = ig.y1;
+          opened += cells_opened;
+        }
+
+        // Sort the block again by Morton code, and write it out.
+        z.resize(m), order.resize(m);
+        for (size_t i = 0; i < m; i++)
+          z[i] = bh::morton(xy1[i]).value_or(checkpoint::NO_MORTON);
+        std::iota(order.begin(), order.end(), size_t{});
+        std::ranges::stable_sort(order, {}, [&z](size_t i) { return z[i]; });
+        out_z.resize(m), out_xy.resize(m), out_v.resize(m);
+        out_mass.resize(m), out_radius.resize(m);
+        for (size_t i = 0; i < m; i++) {
+          auto const q = order[i];
+          out_z[i] = z[q], out_xy[i] = xy1[q], out_v[i] = v1[q];
+          out_mass[i] = mass[b0 + q], out_radius[i] = radius[b0 + q];
+          stats.good = stats.good && std::isfinite(out_xy[i].real()) &&
+                       std::isfinite(out_xy[i].imag()) &&
+                       std::isfinite(out_v[i].real()) &&
+                       std::isfinite(out_v[i].imag());
+        }
+        put(l.morton + b0 * sizeof(uint64_t), out_z);
+        put(l.xy + b0 * sizeof(std::complex<float>), out_xy);
+        put(l.v + b0 * sizeof(std::complex<float>), out_v);
+        put(l.mass + b0 * sizeof(float), out_mass);
+        put(l.radius + b0 * sizeof(float), out_radius);
+        detail::cut(out_z, out_xy, out_mass, out_radius, b0, o.cell, next);
+        next_block_cells.push_back(next.size());
+      }
+      if (!f.flush())
+        throw std::runtime_error{tmp + ": write failed"};
+      f.close();
+      std::error_code e;
+      std::filesystem::resize_file(tmp, l.end, e);
+      if (e)
+        throw std::runtime_error{tmp + ": " + e.message()};
+      cells.swap(next), block_cells.swap(next_block_cells);
+      stats.opened = n ? double(opened) / double(2 * n) : 0.0;
+    }
+    // (The input is unmapped by now.)
+    std::error_code e;
+    std::filesystem::rename(tmp, path, e);
+    if (e)
+      throw std::runtime_error{path + ": " + e.message()};
+    stats.seconds = std::chrono::duration<double>(clock::now() - t0).count();
+    return stats;
+  }
+
+  /// @brief See `Table::refresh_disk`.
+  void refresh_disk() noexcept { gravity.refresh_disk(); }
+};
+
+} // namespace phy::outofcore
+
+#endif // GRASS_OUTOFCORE_H
@@ -0,0 +1,301 @@
+#ifndef GRASS_REPLAY_H
+#define GRASS_REPLAY_H
+
+/// @file replay.h
+/// @brief Random-access reading and prefetched playback of trajectory files
+/// (see trajectory.h).
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "mapped.h"
+#include "trajectory.h"
+
+namespace phy::trajectory {
+
+/// @brief A memory-mapped trajectory with an index of its frames. Decoding a
+/// frame touches only that frame's pages, so files larger than the memory can
+/// be read; the pages come and go through the page cache. Decoding is safe to
+/// do from several threads at once.
+class Reader {
+  MappedFile file;
+  Header h;
+  /// @brief Byte offset of each frame.
+  std::vector<uint64_t> index;
+
+  [[nodiscard]] FrameHeader frame_header(uint64_t offset) const {
+    FrameHeader fh;
+    std::memcpy(&fh, file.data() + offset, sizeof fh);
+    return fh;
+  }
+
+  /// @brief Walk the frames one by one (for files without an index).
+  void scan(uint64_t end) {
+    for (uint64_t o = sizeof h; end - o >= sizeof(FrameHeader);) {
+      auto fh = frame_header(o);
+      if (fh.magic != FRAME_MAGIC || end - o - sizeof fh < fh.bytes)
+        break;
+      index.push_back(o);
+      o += sizeof fh + fh.bytes;
+    }
+  }
+
+public:
+  /// @brief Map the trajectory at `path` and read (or rebuild) its index.
+  /// @throws std::runtime_error If the file cannot be mapped or is not a
+  /// trajectory this build understands.
+  explicit Reader(std::string const &path) : file{path} {
+    auto const fail = [&path](char const *what) {
+      return std::runtime_error{path + ": " + what};
+    };
+    auto const n = file.size();
+    if (n < sizeof h)
+      throw fail("too short to be a trajectory");
+    std::memcpy(&h, file.data(), sizeof h);
+    if (h.magic != MAGIC)
+      throw fail("not a trajectory");
+    if (h.endian != ENDIAN)
+      throw fail("written on a machine of a different byte order");
+    if (h.version != VERSION)
+      throw fail("unsupported trajectory version");
+    // Use the index if the writer got to append it; otherwise walk.
+    Trailer t;
+    if (n >= sizeof h + sizeof t)
+      std::memcpy(&t, file.data() + n - sizeof t, sizeof t);
+    auto const room = (n - sizeof h - sizeof t) / sizeof(uint64_t);
+    if (n >= sizeof h + sizeof t && t.magic == INDEX_MAGIC &&
+        t.frames <= room && t.index == n - sizeof t - t.frames * 8) {
+      index.resize(t.frames);
+      std::memcpy(index.data(), file.data() + t.index, t.frames * 8);
+      for (auto o : index)
+        if (o < sizeof h || o > t.index - sizeof(FrameHeader) ||
+            t.index - o - sizeof(FrameHeader) < frame_header(o).bytes)
+          throw fail("corrupt index");
+    } else {
+      scan(n);
+    }
+  }
+
+  /// @brief The file header.
+  [[nodiscard]] Header const &header() const noexcept { return h; }
+
+  /// @brief Number of frames.
+  [[nodiscard]] size_t size() const noexcept { return index.size(); }
+
+  /// @brief Decode frame i (less than `size()`) into f.
+  /// @returns False if the frame is malformed.
+  bool decode(size_t i, Frame &f) const {
+    auto const o = index[i];
+    auto const fh = frame_header(o);
+    auto const *payload = file.data() + o + sizeof fh;
+    return trajectory::decode(fh, {payload, fh.bytes}, h, f);
+  }
+
+  /// @brief Hint the operating system about frames [first, last) (see
+  /// `MappedFile::advise`).
+  void advise(size_t first, size_t last, bool need = true) const noexcept {
+    last = std::min(last, size());
+    if (first >= last)
+      return;
+    auto const end = last < size() ? index[last]
+                                   : index[last - 1] + sizeof(FrameHeader) +
+                                         frame_header(index[last - 1]).bytes;
+    file.advise(index[first], end - index[first], need);
+  }
+};
+
+/// @brief Play a trajectory back at an adjustable speed. A background thread
+/// decodes the frames just ahead of the playhead (in the direction of play)
+/// into a small cache, so that showing a frame is usually a swap.
+class Player {
+  Reader reader;
+
+  /// @brief Decoded frames waiting to be shown.
+  struct Slot {
+    /// @brief Frame number (or -1 if free).
+    int64_t frame{-1};
+    bool ready{};
+    Frame data;
+  };
+  std::vector<Slot> cache;
+
+  /// @brief The frame being shown and its number.
+  Frame shown;
+  int64_t shown_frame{-1};
+
+  /// @brief Playhead [frames], frames per second, and whether playing.
+  double head{};
+  double rate{30.0};
+  bool playing{true};
+
+  /// @brief Playhead as seen by the prefetcher.
+  int64_t target{};
+  int direction{1};
+  bool stop{};
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::thread prefetcher;
+
+  /// @brief Pick a frame to decode and a slot for it (under the lock).
+  /// @returns The slot, or null if nothing needs to be done.
+  Slot *pick() {
+    auto const n = int64_t(cache.size());
+    auto const in_window = [&](int64_t f) {
+      auto d = (f - target) * direction;
+      return 0 <= d && d <= n;
+    };
+    for (int64_t k = 0; k <= n; k++) {
+      auto f = target + k * direction;
+      if (f < 0 || f >= int64_t(reader.size()))
+        break;
+      if (f == shown_frame || std::ranges::any_of(cache, [f](auto &&s) {
+            return s.frame == f;
+          }))
+        continue;
+      // Evict a frame that is no longer ahead of the playhead.
+      for (auto &&s : cache)
+        if (s.frame < 0 || (s.ready && !in_window(s.frame)))
+          return s.frame = f, s.ready = false, &s;
+      return nullptr;
+    }
+    return nullptr;
+  }
+
+  void run() {
+    std::unique_lock lock{mutex};
+    for (;;) {
+      Slot *s{};
+      cv.wait(lock, [&] { return stop || (s = pick()); });
+      if (stop)
+        return;
+      auto const f = s->frame;
+      // Ask for the pages of the frames after this one, too.
+      auto const ahead = size_t(f + direction * int64_t(cache.size()));
+      lock.unlock();
+      reader.advise(size_t(f), size_t(f) + 1);
+      if (ahead < reader.size())
+        reader.advise(ahead, ahead + 1);
+      auto ok = reader.decode(size_t(f), s->data);
+      lock.lock();
+      // Nobody else touches a slot that is not ready.
+      s->ready = ok, s->frame = ok ? f : -1;
+    }
+  }
+
+  /// @brief Tell the prefetcher about the playhead.
+  void retarget() {
+    {
+      std::lock_guard lock{mutex};
+      target = int64_t(head);
+      direction = rate < 0.0 ? -1 : 1;
+    }
+    cv.notify_one();
+  }
+
+public:
+  /// @param path Trajectory file.
+  /// @param ahead Number of frames to decode ahead of the playhead.
+  /// @throws std::runtime_error See `Reader`.
+  explicit Player(std::string const &path, size_t ahead = 8)
+      : reader{path}, cache(std::max(ahead, size_t(1))) {
+    if (!reader.size())
+      throw std::runtime_error{path + ": no frames"};
+    prefetcher = std::thread{[this] { run(); }};
+  }
+
+  Player(Player const &) = delete;
+  Player &operator=(Player const &) = delete;
+
+  ~Player() {
+    {
+      std::lock_guard lock{mutex};
+      stop = true;
+    }
+    cv.notify_one();
+    prefetcher.join();
+  }
+
+  /// @brief Number of frames.
+  [[nodiscard]] size_t size() const noexcept { return reader.size(); }
+
+  /// @brief Current frame number.
+  [[nodiscard]] size_t position() const noexcept { return size_t(head); }
+
+  /// @brief Playback rate [frames per second]; negative plays backward.
+  [[nodiscard]] double speed() const noexcept { return rate; }
+
+  [[nodiscard]] bool is_playing() const noexcept { return playing; }
+
+  void toggle() noexcept { playing = !playing; }
+
+  /// @brief Multiply the playback rate (keeping it within reason).
+  void scale_speed(double factor) {
+    auto const s = std::clamp(std::abs(rate * factor), 0.25, 4096.0);
+    rate = std::copysign(s, rate * factor);
+    retarget();
+  }
+
+  /// @brief Play the other way.
+  void reverse() {
+    rate = -rate;
+    retarget();
+  }
+
+  /// @brief Jump to frame i (clamped to the file).
+  void seek(int64_t i) {
+    head = double(std::clamp(i, int64_t{}, int64_t(size()) - 1));
+    retarget();
+  }
+
+  /// @brief Move the playhead by `seconds` of wall time (if playing).
+  void advance(double seconds) {
+    if (!playing)
+      return;
+    auto const last = double(size() - 1);
+    head = std::clamp(head + rate * seconds, 0.0, last);
+    // Stop at either end.
+    if ((rate > 0.0 && head == last) || (rate < 0.0 && head == 0.0))
+      playing = false;
+    retarget();
+  }
+
+  /// @brief Get the frame under the playhead. Takes it from the cache if the
+  /// prefetcher got to it; otherwise, decodes it right here.
+  /// @returns Null if the frame is malformed.
+  Frame const *frame() {
+    auto const f = int64_t(head);
+    {
+      std::lock_guard lock{mutex};
+      if (f == shown_frame)
+        return &shown;
+      for (auto &&s : cache)
+        if (s.frame == f && s.ready) {
+          // Swap buffers; the old frame's buffer becomes a free slot.
+          std::swap(shown, s.data), shown_frame = f;
+          s.frame = -1, s.ready = false;
+          break;
+        }
+    }
+    if (f != shown_frame) {
+      // `shown` is not touched by the prefetcher; decode without the lock.
+      auto ok = reader.decode(size_t(f), shown);
+      std::lock_guard lock{mutex};
+      shown_frame = ok ? f : -1;
+    }
+    cv.notify_one();
+    return shown_frame == f ? &shown : nullptr;
+  }
+};
+
+} // namespace phy::trajectory
+
+#endif // GRASS_REPLAY_H
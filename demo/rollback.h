@@ -0,0 +1,118 @@
+#ifndef GRASS_ROLLBACK_H
+#define GRASS_ROLLBACK_H
+
+/// @file rollback.h
+/// @brief Recover from a NaN or an infinity without starting over: keep a
+/// few copies of the table from recent steps, and when a step goes wrong,
+/// go back to the latest copy and redo the steps since in smaller steps.
+///
+/// A copy is taken every `every` steps (16 by default), into storage that is
+/// reused, so it costs a copy of the particles, without allocating, once in
+/// a while. As the step is the same for all particles (see `Table::step`),
+/// the smaller steps are taken by all of them.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace phy::rollback {
+
+struct Options {
+  /// Take a copy every this many steps.
+  uint64_t every{16};
+
+  /// Number of copies to keep (0 to never roll back).
+  unsigned depth{2};
+
+  /// Redo the steps in halves, then in quarters, and so on, this many times
+  /// before giving up on a copy and going back to the one before.
+  unsigned halvings{3};
+};
+
+/// Rollbacks so far.
+struct Stats {
+  /// Steps that went wrong, and those of them recovered from.
+  uint64_t rollbacks{}, recovered{};
+
+  /// Of the latest recovery: the step that went wrong, the step of the copy
+  /// gone back to, and the number of halvings of the step it took.
+  uint64_t step{}, from{};
+  unsigned halvings{};
+};
+
+/// @brief A ring of copies of a table (anything copyable with `good()`).
+template <class T> class Ring {
+  struct Entry {
+    /// The number of steps taken when the copy was taken.
+    uint64_t step{};
+    T table;
+  };
+
+  Options o;
+  std::vector<Entry> entries;
+  /// The latest copy is entries[latest], and there are `count` of them.
+  size_t latest{}, count{};
+  Stats s;
+
+  void keep(T const &table, uint64_t step) {
+    latest = (latest + 1) % entries.size();
+    entries[latest].step = step, entries[latest].table = table;
+    count = std::min(count + 1, entries.size());
+  }
+
+public:
+  explicit Ring(Options o = {}) : o{o}, entries(o.depth) {
+    this->o.every = std::max(o.every, uint64_t(1));
+  }
+
+  [[nodiscard]] Stats const &stats() const noexcept { return s; }
+
+  /// @brief Forget the copies (call when starting over, so as not to roll
+  /// back to before).
+  void clear() noexcept { count = 0; }
+
+  /// @brief Take step number `step` (counted from 1) of size `dt` with
+  /// `advance(table, dt)`. If the table is not good afterward, roll back and
+  /// redo the steps up to this one in smaller steps. The steps redone are not
+  /// shown to the caller: afterward, `step` steps have been taken either way.
+  /// @return False if the table is still not good (nothing to roll back to,
+  /// or no smaller step helped); the caller should start over.
+  bool step(T &table, uint64_t step, float dt, auto &&advance) {
+    if (entries.empty()) {
+      advance(table, dt);
+      return table.good();
+    }
+    if (!count || (step - 1) % o.every == 0)
+      keep(table, step - 1);
+    advance(table, dt);
+    if (table.good())
+      return true;
+
+    ++s.rollbacks;
+    while (count) {
+      auto const &e = entries[latest];
+      for (unsigned h = 1; h <= o.halvings; h++) {
+        auto const n = uint64_t(1) << h;
+        auto const sub = dt / float(n);
+        table = e.table;
+        auto ok = true;
+        for (auto k = e.step * n; ok && k < step * n; k++)
+          advance(table, sub), ok = table.good();
+        if (ok) {
+          ++s.recovered;
+          s.step = step, s.from = e.step, s.halvings = h;
+          return true;
+        }
+      }
+      // Going wrong from this copy whatever the step. Drop it, and try the
+      // one before.
+      latest = (latest + entries.size() - 1) % entries.size(), --count;
+    }
+    return false;
+  }
+};
+
+} // namespace phy::rollback
+
+#endif // GRASS_ROLLBACK_H
@@ -0,0 +1,317 @@
+#ifndef GRASS_SHM_H
+#define GRASS_SHM_H
+
+/// @file shm.h
+/// @brief Publish the latest snapshot of a running simulation in POSIX shared
+/// memory, and read it from other processes (viewers, dashboards, analysis
+/// scripts), without the simulation ever waiting for them.
+///
+/// Layout of the segment (native byte order; offsets in bytes):
+///
+///     0     Header (64 bytes, and 64 reserved; see `Header`)
+///     128   Slot 0: a SlotHeader (64 bytes), then `capacity` Records
+///           Slot 1: likewise
+///
+/// A `Record` is six 32-bit floats, `x, y, vx, vy, mass, radius`, so a
+/// script can map the segment (`/dev/shm/<name>` on Linux) as an array.
+///
+/// The publisher fills the two slots in turn. Each slot has a sequence number
+/// that is odd while the slot is being written (a seqlock), and the header
+/// says which slot was completed last. A reader copies the latest slot out and
+/// then checks that its sequence number did not change; if it did, the reader
+/// tries again. As the publisher writes to the other slot next, a retry only
+/// happens to a reader that takes longer than a whole frame to copy one.
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GRASS_SHM 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace phy::shm {
+
+inline constexpr char MAGIC[8] = {'G', 'R', 'A', 'S', 'S', 'S', 'H', 'M'};
+inline constexpr uint32_t VERSION = 2;
+inline constexpr uint32_t ENDIAN = 0x01020304;
+
+/// @brief Statistics of the run, published with each snapshot.
+struct Stats {
+  /// @brief Steps taken and simulated time [T].
+  uint64_t step{};
+  double time{};
+
+  /// @brief Number of particles in the simulation, and the number published
+  /// (fewer if the segment is too small).
+  uint64_t particles{};
+  uint64_t published{};
+
+  /// @brief Wall time of the latest step [ms], and since the start [s].
+  double step_ms{};
+  double wall{};
+
+  /// @brief Steps rolled back after a NaN or an infinity (see rollback.h).
+  uint64_t rollbacks{};
+};
+
+/// @brief A particle as published.
+struct Record {
+  float x, y, vx, vy, mass, radius;
+};
+
+static_assert(sizeof(Record) == 24);
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "the seqlock needs lock-free 64-bit atomics");
+
+struct alignas(64) Header {
+  char magic[8];
+  uint32_t version, endian;
+  /// @brief Records per slot.
+  uint64_t capacity;
+  /// @brief Number of the latest complete snapshot (0 if none yet); it is in
+  /// slot `latest % 2`.
+  std::atomic<uint64_t> latest;
+  /// @brief Set when the publisher is done (the run ended).
+  std::atomic<uint64_t> finished;
+};
+
+struct alignas(64) SlotHeader {
+  /// @brief Odd while the slot is being written.
+  std::atomic<uint64_t> sequence;
+  Stats stats;
+};
+
+static_assert(sizeof(Header) == 64 && sizeof(SlotHeader) == 64);
+
+/// @brief Offset of the header of slot k (and its records follow).
+inline constexpr size_t slot_offset(uint64_t capacity, unsigned k) {
+  return 128 + k * (sizeof(SlotHeader) + capacity * sizeof(Record));
+}
+
+/// @brief Bytes of a segment with the given capacity.
+inline constexpr size_t segment_bytes(uint64_t capacity) {
+  return slot_offset(capacity, 2);
+}
+
+namespace detail {
+
+/// @brief POSIX names of shared memory objects start with a slash.
+inline std::string posix_name(std::string name) {
+  return name.starts_with('/') ? name : '/' + name;
+}
+
+} // namespace detail
+
+/// @brief Create (or take over) a shared memory segment and publish snapshots
+/// in it. Publishing never waits for readers. The segment is removed when the
+/// publisher is destroyed (readers that mapped it keep their mapping).
+class Publisher {
+  std::string name;
+  std::byte *p{};
+  size_t n{};
+  uint64_t capacity{};
+
+  [[nodiscard]] Header &header() const {
+    return *reinterpret_cast<Header *>(p);
+  }
+
+public:
+  /// @param name Name of the segment (for example, `grass`).
+  /// @param capacity Most particles to publish.
+  /// @throws std::runtime_error If the segment cannot be created.
+  Publisher(std::string const &name, uint64_t capacity)
+      : name{detail::posix_name(name)}, capacity{std::max(capacity,
+                                                          uint64_t(1))} {
+    auto const fail = [this](char const *what) {
+      return std::runtime_error{this->name + ": " + what};
+    };
+#ifdef GRASS_SHM
+    n = segment_bytes(this->capacity);
+    auto fd = ::shm_open(this->name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+      throw fail("cannot create shared memory");
+    auto ok = ::ftruncate(fd, off_t(n)) == 0;
+    void *m = ok ? ::mmap(nullptr, n, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                 : MAP_FAILED;
+    ::close(fd);
+    if (m == MAP_FAILED) {
+      ::shm_unlink(this->name.c_str());
+      throw fail("cannot size or map shared memory");
+    }
+    p = static_cast<std::byte *>(m);
+    // Readers check the magic last (after the release below).
+    auto &&h = header();
+    std::memset(h.magic, 0, sizeof h.magic);
+    h.version = VERSION, h.endian = ENDIAN, h.capacity = this->capacity;
+    h.latest.store(0, std::memory_order_relaxed);
+    h.finished.store(0, std::memory_order_relaxed);
+    for (unsigned k = 0; k < 2; k++)
+      reinterpret_cast<SlotHeader *>(p + slot_offset(this->capacity, k))
+          ->sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(h.magic, MAGIC, sizeof MAGIC);
+#else
+    throw fail("shared memory is not supported on this platform");
+#endif
+  }
+
+  Publisher(Publisher const &) = delete;
+  Publisher &operator=(Publisher const &) = delete;
+
+  ~Publisher() {
+#ifdef GRASS_SHM
+    header().finished.store(1, std::memory_order_release);
+    ::munmap(p, n);
+    ::shm_unlink(name.c_str());
+#endif
+  }
+
+  /// @brief Publish the particles (anything with `xy`, `v`, `mass`, and
+  /// `radius`) and the statistics. Copies each particle once, straight into
+  /// the segment.
+  template <typename R> void publish(R const &particles, Stats stats) {
+    auto const latest = header().latest.load(std::memory_order_relaxed);
+    auto *base = p + slot_offset(capacity, unsigned((latest + 1) % 2));
+    auto &&slot = *reinterpret_cast<SlotHeader *>(base);
+    auto *out = reinterpret_cast<Record *>(base + sizeof(SlotHeader));
+
+    auto const sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    uint64_t i{};
+    for (auto &&q : particles) {
+      if (i == capacity)
+        break;
+      out[i++] = {q.xy.real(), q.xy.imag(), q.v.real(),
+                  q.v.imag(),  q.mass,      q.radius};
+    }
+    stats.published = i;
+    slot.stats = stats;
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    header().latest.store(latest + 1, std::memory_order_release);
+  }
+};
+
+/// @brief A snapshot as read.
+struct Snapshot {
+  /// @brief Number of the snapshot (increasing).
+  uint64_t number{};
+  Stats stats;
+  std::vector<Record> particles;
+};
+
+/// @brief Read the snapshots of a publisher (in another process).
+class Reader {
+  std::byte const *p{};
+  size_t n{};
+  uint64_t capacity{};
+
+  [[nodiscard]] Header const &header() const {
+    return *reinterpret_cast<Header const *>(p);
+  }
+
+public:
+  /// @param name Name of the segment (as given to the publisher).
+  /// @throws std::runtime_error If there is no such segment, or it is not
+  /// a snapshot segment this build understands.
+  explicit Reader(std::string const &name) {
+    auto const posix = detail::posix_name(name);
+    auto const fail = [&posix](char const *what) {
+      return std::runtime_error{posix + ": " + what};
+    };
+#ifdef GRASS_SHM
+    auto fd = ::shm_open(posix.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+      throw fail("no such shared memory (is the simulation running?)");
+    struct stat st {};
+    auto ok = ::fstat(fd, &st) == 0 && size_t(st.st_size) >= sizeof(Header);
+    void *m = ok ? ::mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED,
+                          fd, 0)
+                 : MAP_FAILED;
+    ::close(fd);
+    if (m == MAP_FAILED)
+      throw fail("cannot map shared memory");
+    p = static_cast<std::byte const *>(m), n = size_t(st.st_size);
+    auto &&h = header();
+    std::atomic_thread_fence(std::memory_order_acquire);
+    auto const bad = [&]() -> char const * {
+      if (std::memcmp(h.magic, MAGIC, sizeof MAGIC))
+        return "not a snapshot segment (or not ready yet)";
+      if (h.endian != ENDIAN)
+        return "written on a machine of a different byte order";
+      if (h.version != VERSION)
+        return "unsupported version";
+      if (n < segment_bytes(h.capacity))
+        return "truncated";
+      return nullptr;
+    }();
+    if (bad) {
+      ::munmap(const_cast<std::byte *>(p), n);
+      throw fail(bad);
+    }
+    capacity = h.capacity;
+#else
+    throw fail("shared memory is not supported on this platform");
+#endif
+  }
+
+  Reader(Reader const &) = delete;
+  Reader &operator=(Reader const &) = delete;
+
+  ~Reader() {
+#ifdef GRASS_SHM
+    ::munmap(const_cast<std::byte *>(p), n);
+#endif
+  }
+
+  /// @brief Number of the latest snapshot (0 if none yet).
+  [[nodiscard]] uint64_t latest() const noexcept {
+    return header().latest.load(std::memory_order_acquire);
+  }
+
+  /// @brief Whether the publisher is done.
+  [[nodiscard]] bool finished() const noexcept {
+    return header().finished.load(std::memory_order_acquire);
+  }
+
+  /// @brief Copy the latest snapshot into s (reusing its storage).
+  /// @param attempts How many times to try if the publisher overwrites the
+  /// snapshot while it is being copied.
+  /// @return False if there is no snapshot yet, or no attempt succeeded.
+  bool read(Snapshot &s, int attempts = 8) const {
+    for (auto a = 0; a < attempts; a++) {
+      auto const number = latest();
+      if (!number)
+        return false;
+      auto const *base = p + slot_offset(capacity, unsigned(number % 2));
+      auto &&slot = *reinterpret_cast<SlotHeader const *>(base);
+      auto const before = slot.sequence.load(std::memory_order_acquire);
+      if (before % 2)
+        continue;
+      s.number = number;
+      std::memcpy(&s.stats, &slot.stats, sizeof s.stats);
+      auto const k = std::min(s.stats.published, capacity);
+      s.particles.resize(k);
+      std::memcpy(s.particles.data(), base + sizeof(SlotHeader),
+                  k * sizeof(Record));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.sequence.load(std::memory_order_relaxed) == before)
+        return true;
+    }
+    return false;
+  }
+};
+
+} // namespace phy::shm
+
+#endif // GRASS_SHM_H
@@ -0,0 +1,448 @@
+#ifndef GRASS_SIMULATION_H
+#define GRASS_SIMULATION_H
+
+/// @file simulation.h
+/// @brief The simulation of the demo, decoupled from the drawing. The
+/// simulation runs on its own thread (except on the web) at its own rate. It
+/// publishes snapshots of the particles through a triple buffer and takes the
+/// user's actions through a command queue, so neither thread ever waits for
+/// the other.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <circle.h>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <raylib.h>
+#include <spsc.h>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <triple_buffer.h>
+#include <utility>
+#include <vector>
+
+#include "Table.h"
+#include "checkpoint.h"
+#include "initial.h"
+#include "loader.h"
+#include "rollback.h"
+#include "shm.h"
+#include "trajectory.h"
+
+namespace main_program {
+
+/// The particles as last published by the simulation (read-only to the
+/// renderer).
+struct Snapshot {
+  /// What to draw: the visible particles, and the groups of particles too
+  /// small on the screen to draw one by one (see `View`).
+  std::vector<dyn::Circle<float>> circles;
+
+  /// Number of particles.
+  size_t particles{};
+
+  /// Steps taken and simulated time [T] since the program started.
+  uint64_t steps{};
+  double time{};
+
+  /// Number of resets so far (asked for, or after a NaN).
+  uint64_t resets{};
+
+  /// The latest map of the potential or the field (if asked for; see
+  /// `Simulation::Settings::map`): width by height samples of the rectangle
+  /// ll to gg [L], row by row from ll. Its number changes with each new map.
+  std::vector<float> map;
+  int map_width{}, map_height{};
+  std::complex<float> map_ll, map_gg;
+  uint64_t map_number{};
+
+  /// The latest measurement of the conserved quantities (if any yet; see
+  /// `Simulation::Settings::conserved_every`), and the energy first measured
+  /// since the latest reset or spawn, to show the drift against.
+  std::optional<Table<>::Conserved> conserved;
+  double energy0{};
+};
+
+/// What the renderer shows (so that the simulation sends only that).
+struct View {
+  /// Less-less and greater-greater corners [L].
+  std::complex<float> ll, gg;
+
+  /// Groups of particles with a radius under this [L] are drawn as a whole.
+  float lod{};
+
+  bool operator==(View const &) const = default;
+};
+
+/// An action of the user, for the simulation to carry out.
+struct Command {
+  enum class Kind : uint8_t {
+    /// Spawn a random particle at `xy`.
+    spawn,
+    /// Start over from the initial conditions.
+    reset,
+    /// Run (`on`) or pause.
+    fly,
+    /// Save a checkpoint.
+    save,
+    /// Show `view` from now on.
+    view,
+  } kind{};
+  std::complex<float> xy{};
+  bool on{};
+  View view{};
+};
+
+class Simulation {
+public:
+  /// What to simulate, and how fast.
+  struct Settings {
+    Constants constants;
+
+    /// Where to save checkpoints, and whether to resume from there.
+    std::string checkpoint{"grass.ckpt"};
+    bool resume{};
+
+    /// Load the initial conditions from this file (if any).
+    std::optional<std::string> initial;
+
+    /// Step size [T].
+    float dt{1.0f / 90.0f};
+
+    /// Steps per second of wall time when running on a thread (as fast as
+    /// possible if not positive).
+    double rate{90.0};
+
+    /// Merge particles closer than this fraction of the sum of their radii
+    /// (0 never to; see `Table::accretion`).
+    float accretion{};
+
+    /// How to roll back after a NaN or an infinity (before starting over).
+    phy::rollback::Options rollback;
+
+    /// Map the gravitational potential or field in view (if asked; see
+    /// `Table::map`) on a grid `map_width` wide, every `map_every` steps and
+    /// whenever the view changes.
+    std::optional<Table<>::Map> map;
+    int map_width{160};
+    uint64_t map_every{9};
+
+    /// Measure the energy, momentum, and angular momentum every this many
+    /// steps (never if 0; see `Table::measure`).
+    uint64_t conserved_every{30};
+  };
+
+private:
+  Settings const settings;
+  std::mt19937 rng{std::random_device{}()};
+  Table<> table;
+  phy::rollback::Ring<Table<>> ring{settings.rollback};
+  bool fly{true};
+  uint64_t steps{}, resets{};
+  double time{};
+
+  /// What the renderer shows (everything until it says).
+  std::optional<View> view;
+
+  /// The latest measurement of the conserved quantities, the energy to show
+  /// the drift against (unset until measured after a reset or spawn), and
+  /// the number of steps taken when measured.
+  std::optional<Table<>::Conserved> conserved;
+  std::optional<double> energy0;
+  uint64_t measured{};
+
+  /// The latest map (if asked for), and the view it was made for.
+  struct {
+    std::vector<float> samples;
+    int width{}, height{};
+    View view;
+    uint64_t number{};
+  } background;
+
+#if !defined(PLATFORM_WEB)
+  /// Trajectory recorder (if asked for).
+  std::optional<phy::trajectory::Recorder> recorder;
+
+  /// Shared memory for other processes to watch (if asked for).
+  std::optional<phy::shm::Publisher> shared;
+  std::chrono::steady_clock::time_point started{
+      std::chrono::steady_clock::now()};
+#endif
+
+  dyn::Spsc<Command> commands;
+  dyn::TripleBuffer<Snapshot> snapshots;
+
+  std::atomic<bool> stop{};
+  std::thread thread;
+
+  Table<> make_table() const {
+    auto t = load_table();
+    t.accretion = settings.accretion;
+    return t;
+  }
+
+  Table<> load_table() const {
+    if (settings.resume) {
+      try {
+        return phy::checkpoint::load(settings.checkpoint);
+      } catch (std::runtime_error const &e) {
+        // Fall back to the usual initial conditions.
+        TraceLog(LOG_WARNING, "%s", e.what());
+      }
+    }
+    if (settings.initial) {
+      Table<> t;
+      t.G = settings.constants.G;
+      try {
+        phy::loader::load(settings.initial.value(), t);
+        return t;
+      } catch (std::runtime_error const &e) {
+        TraceLog(LOG_WARNING, "%s", e.what());
+      }
+    }
+    return generate(settings.constants);
+  }
+
+  /// Start over (and unpause, like the renderer does).
+  void reset() {
+    table = make_table(), fly = true, ++resets;
+    ring.clear();
+    energy0.reset();
+  }
+
+  void apply(Command const &c) {
+    using enum Command::Kind;
+    switch (c.kind) {
+    case spawn: {
+      // When the user controls, reset the gravitational constant.
+      table.G = settings.constants.G;
+      // Spawn a random particle at the location.
+      auto p = settings.constants.random_particle(rng); // Mass and radius.
+      p.xy = c.xy;
+      table.push_back(p);
+      table.forget_tree();
+      energy0.reset();
+      // The copies in the ring are of the particles before the spawn (and of
+      // the old G): rolling back to them would drop it.
+      ring.clear();
+      // If too many particles, remove a random particle.
+      if (table.size() > settings.constants.PARTICLES_LIMIT) {
+        std::uniform_int_distribution<size_t> d{0, table.size() - 1};
+        table.erase(table.begin() + ptrdiff_t(d(rng)));
+      }
+      break;
+    }
+    case reset:
+      this->reset();
+      break;
+    case fly:
+      this->fly = c.on;
+      break;
+    case save:
+      try {
+        phy::checkpoint::save(table, settings.checkpoint);
+        TraceLog(LOG_INFO, "Saved %zu particles to %s", table.size(),
+                 settings.checkpoint.c_str());
+      } catch (std::runtime_error const &e) {
+        TraceLog(LOG_WARNING, "%s", e.what());
+      }
+      break;
+    case Command::Kind::view:
+      this->view = c.view;
+      break;
+    }
+  }
+
+  /// Measure the conserved quantities, if due: have the next step measure
+  /// them at its start, with the tree it builds anyway (see
+  /// `Table::measure`), or, if paused, measure them now.
+  void measure() {
+    auto const take = [this](Table<>::Conserved const &c, uint64_t step) {
+      conserved = c, measured = step;
+      if (!energy0)
+        energy0 = c.energy();
+    };
+    if (table.measured)
+      take(*std::exchange(table.measured, {}), steps - 1);
+    auto const every = settings.conserved_every;
+    if (!every || (energy0 && (steps % every || steps == measured)))
+      return;
+    if (fly)
+      table.measure = true;
+    else
+      take(table.conserved(), steps);
+  }
+
+  /// Map the potential or the field in view, if due.
+  void map() {
+    if (!settings.map || !view)
+      return;
+    auto &&b = background;
+    if (b.number && b.view == *view && steps % settings.map_every)
+      return;
+    auto const size = view->gg - view->ll;
+    b.width = std::max(settings.map_width, 1);
+    b.height = std::max(int(std::lround(float(b.width) * size.imag() /
+                                        size.real())),
+                        1);
+    table.map(*settings.map, view->ll, view->gg, b.width, b.height,
+              b.samples);
+    b.view = *view, ++b.number;
+  }
+
+  /// Copy what is in view out to the renderer. Use the tree of the latest
+  /// step to skip what is out of view, and to merge what is too small to see.
+  void publish() {
+    auto &&s = snapshots.back();
+    s.circles.clear();
+    if (view)
+      table.visible(
+          view->ll, view->gg, view->lod,
+          [&s](auto &&p) { s.circles.push_back(p.circle()); },
+          [&s](auto &&c, float) { s.circles.push_back(c); });
+    else
+      for (auto &&p : table)
+        s.circles.push_back(p.circle());
+    s.particles = table.size();
+    s.steps = steps, s.time = time, s.resets = resets;
+    if (s.map_number != background.number) {
+      s.map = background.samples;
+      s.map_width = background.width, s.map_height = background.height;
+      s.map_ll = background.view.ll, s.map_gg = background.view.gg;
+      s.map_number = background.number;
+    }
+    s.conserved = conserved, s.energy0 = energy0.value_or(0.0);
+    snapshots.publish();
+  }
+
+  void run() {
+    using clock = std::chrono::steady_clock;
+    auto const period = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(
+            settings.rate > 0.0 ? 1.0 / settings.rate : 0.0));
+    auto next = clock::now();
+    while (!stop.load(std::memory_order_relaxed)) {
+      tick();
+      // Keep the pace, but do not try to catch up after a slow step.
+      next += period;
+      if (auto now = clock::now(); next > now)
+        std::this_thread::sleep_until(next);
+      else
+        next = now;
+    }
+  }
+
+public:
+  explicit Simulation(Settings s) : settings{std::move(s)} {
+    table = make_table();
+    publish();
+  }
+
+  Simulation(Simulation const &) = delete;
+  Simulation &operator=(Simulation const &) = delete;
+
+  ~Simulation() {
+    if (thread.joinable()) {
+      stop = true;
+      thread.join();
+    }
+  }
+
+  [[nodiscard]] Constants const &constants() const noexcept {
+    return settings.constants;
+  }
+
+#if !defined(PLATFORM_WEB)
+  /// Record the trajectory to `path` (call before `start`).
+  void record(std::string const &path, phy::trajectory::Recorder::Options o) {
+    recorder.emplace(path, o);
+  }
+
+  /// Publish the particles after each step in the shared memory segment
+  /// `name` (call before `start`).
+  void share(std::string const &name) {
+    auto const limit = settings.constants.PARTICLES_LIMIT;
+    shared.emplace(name, std::max<uint64_t>(table.size(), limit));
+  }
+#endif
+
+  /// Run `tick` on a thread of its own, paced at the rate in the settings.
+  void start() { thread = std::thread{[this] { run(); }}; }
+
+  /// Whether `start` was called (if not, call `tick` from the main loop).
+  [[nodiscard]] bool threaded() const noexcept { return thread.joinable(); }
+
+  /// Carry out the pending commands, take a step (unless paused), and
+  /// publish a snapshot.
+  void tick() {
+    auto changed = false;
+    while (auto c = commands.pop())
+      apply(*c), changed = true;
+
+    if (fly) {
+      auto const advance = [this](Table<> &t, float dt) {
+        // Particles too far from the origin will be removed.
+        std::erase_if(t, [this](auto &&p) {
+          return settings.constants.too_far(p.xy);
+        });
+        t.step(dt);
+        // Remove statistical bias in collision handling routine.
+        // (See refresh_disk()'s comments for details.)
+        t.refresh_disk();
+      };
+
+      [[maybe_unused]] auto const t0 = std::chrono::steady_clock::now();
+      auto const recovered = ring.stats().recovered;
+      // Inspect for such things as NaN and Infinity, and roll back if so.
+      if (!ring.step(table, steps + 1, settings.dt, advance))
+        // NaN or infinity somewhere, even in smaller steps. Reset.
+        reset();
+      else if (auto &&r = ring.stats(); r.recovered != recovered)
+        TraceLog(LOG_WARNING,
+                 "Step %llu: NaN or infinity; redid it from step %llu in "
+                 "steps of dt/%u",
+                 (unsigned long long)r.step, (unsigned long long)r.from,
+                 1u << r.halvings);
+
+      ++steps, time += double(settings.dt), changed = true;
+#if !defined(PLATFORM_WEB)
+      // Copy the frame out (if due); the recorder writes it elsewhere.
+      if (recorder)
+        recorder->record(table, steps, time);
+      if (shared) {
+        using ms = std::chrono::duration<double, std::milli>;
+        auto now = std::chrono::steady_clock::now();
+        shared->publish(table,
+                        {steps, time, table.size(), {}, ms(now - t0).count(),
+                         std::chrono::duration<double>(now - started).count(),
+                         ring.stats().rollbacks});
+      }
+#endif
+    }
+    if (changed) {
+      measure();
+      map();
+      publish();
+    }
+  }
+
+  /// Send a command (from the render thread).
+  /// @return False if the queue is full (and the command was dropped).
+  bool send(Command const &c) { return commands.push(c); }
+
+  /// The latest snapshot (render thread only).
+  [[nodiscard]] Snapshot const &latest() {
+    snapshots.refresh();
+    return snapshots.front();
+  }
+};
+
+} // namespace main_program
+
+#endif // GRASS_SIMULATION_H
@@ -0,0 +1,319 @@
+#ifndef GRASS_SPLAT_H
+#define GRASS_SPLAT_H
+
+/// @file splat.h
+/// @brief Render particles into images on the CPU (no GPU, no display), for
+/// the headless runner's movies and thumbnails.
+///
+/// Each particle is splatted as a Gaussian kernel whose width follows its
+/// radius on the screen and whose integral is its mass, so the image is a map
+/// of the projected mass density. The particles are split evenly among a few
+/// accumulation buffers that are filled in parallel and then summed (in a
+/// fixed order, so the image does not depend on the number of threads). The
+/// density is tone-mapped and written as a PNG or a binary PPM.
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace phy::splat {
+
+/// @brief A 2D camera like Raylib's `Camera2D` (without the rotation): the
+/// point `target` of the world is shown at `offset` on the screen, at a scale
+/// of `zoom` pixels per unit of length. The y axis points down the screen.
+struct Camera {
+  std::complex<float> target, offset;
+  float zoom{1.0f};
+
+  /// @brief The demo's initial camera (see `User`) for a screen of the size.
+  static Camera fit(int width, int height) {
+    auto w = float(width), h = float(height);
+    return {{}, {w * 0.5f, h * 0.5f}, 0.125f * std::min(w, h)};
+  }
+
+  /// @brief Where a point of the world is on the screen [pixels].
+  [[nodiscard]] std::complex<float> to_screen(std::complex<float> xy) const {
+    return (xy - target) * zoom + offset;
+  }
+
+  /// @brief What point of the world is at a point of the screen [pixels].
+  [[nodiscard]] std::complex<float> to_world(std::complex<float> xy) const {
+    return (xy - offset) / zoom + target;
+  }
+};
+
+struct Options {
+  /// @brief Number of accumulation buffers (each the size of the image). More
+  /// buffers let more threads splat at once but take more memory.
+  int buffers{8};
+
+  /// @brief Bounds of the standard deviation of the kernel [pixels]. A
+  /// particle's kernel has half its radius on the screen, within the bounds.
+  float min_sigma{0.5f}, max_sigma{32.0f};
+};
+
+/// @brief Mass per pixel, row by row from the top.
+class Image {
+  int w, h;
+  std::vector<float> d;
+
+public:
+  Image(int width, int height)
+      : w{std::max(width, 1)}, h{std::max(height, 1)}, d(size_t(w) * h) {}
+
+  [[nodiscard]] int width() const noexcept { return w; }
+  [[nodiscard]] int height() const noexcept { return h; }
+  [[nodiscard]] float *data() noexcept { return d.data(); }
+  [[nodiscard]] float const *data() const noexcept { return d.data(); }
+  [[nodiscard]] float operator()(int x, int y) const {
+    return d[size_t(y) * size_t(w) + size_t(x)];
+  }
+
+  /// @brief A density that is not too rare: the 99.5th percentile of the
+  /// pixels with anything in them (0 if none).
+  [[nodiscard]] float bright() const {
+    std::vector<float> v;
+    std::ranges::copy_if(d, std::back_inserter(v), [](float x) {
+      return x > 0.0f;
+    });
+    if (v.empty())
+      return 0.0f;
+    auto k = v.begin() + ptrdiff_t(double(v.size() - 1) * 0.995);
+    std::ranges::nth_element(v, k);
+    return *k;
+  }
+
+  /// @brief Tone-map the density into 8-bit RGB. The densities are compressed
+  /// logarithmically (beyond a hundredth of `white`) and shown on a ramp from
+  /// black through blue to white.
+  /// @param white Density shown as white (if not positive, `bright()`).
+  [[nodiscard]] std::vector<uint8_t> rgb(float white = 0.0f) const {
+    if (white <= 0.0f)
+      white = bright();
+    std::vector<uint8_t> out(d.size() * 3);
+    if (white <= 0.0f)
+      return out;
+    auto const s = white / 100.0f, norm = 1.0f / std::asinh(white / s);
+    // (Linear-light colors of the ramp at t = 0, 0.5, and 1.)
+    auto constexpr BLUE = std::array{0.05f, 0.18f, 0.8f};
+    auto const m = static_cast<long long>(d.size());
+    auto i = 0LL;
+#pragma omp parallel for
+    for (i = 0; i < m; ++i) {
+      auto t = std::min(std::asinh(d[size_t(i)] / s) * norm, 1.0f);
+      for (auto c = 0; c < 3; c++) {
+        auto u = t < 0.5f ? 2.0f * t * BLUE[c]
+                          : BLUE[c] + (2.0f * t - 1.0f) * (1.0f - BLUE[c]);
+        // Encode (approximately sRGB).
+        out[size_t(i) * 3 + c] = uint8_t(std::lround(
+            255.0f * std::pow(std::clamp(u, 0.0f, 1.0f), 1.0f / 2.2f)));
+      }
+    }
+    return out;
+  }
+
+  /// @brief Tone-map (see `rgb`) and write as a PNG (if the path ends with
+  /// `.png`) or a binary PPM (otherwise).
+  /// @throws std::runtime_error If the file cannot be written.
+  void write(std::string const &path, float white = 0.0f) const;
+};
+
+namespace detail {
+
+/// @brief CRC-32 (as in PNG and zlib) of the bytes, continuing from `crc`.
+inline uint32_t crc32(uint8_t const *p, size_t n, uint32_t crc = 0) {
+  static auto const table = [] {
+    std::array<uint32_t, 256> t{};
+    for (uint32_t i = 0; i < 256; i++) {
+      auto c = i;
+      for (auto k = 0; k < 8; k++)
+        c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+      t[i] = c;
+    }
+    return t;
+  }();
+  crc = ~crc;
+  for (size_t i = 0; i < n; i++)
+    crc = table[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+  return ~crc;
+}
+
+/// @brief Adler-32 (as in zlib) of the bytes, continuing from `a`.
+inline uint32_t adler32(uint8_t const *p, size_t n, uint32_t a = 1) {
+  uint32_t s1 = a & 0xFFFF, s2 = a >> 16;
+  while (n) {
+    // (The sums cannot overflow in this many bytes.)
+    auto k = std::min(n, size_t(5552));
+    for (n -= k; k--; ++p)
+      s1 += *p, s2 += s1;
+    s1 %= 65521, s2 %= 65521;
+  }
+  return s2 << 16 | s1;
+}
+
+/// @brief Encode a PNG (8-bit RGB) without compression: the zlib stream holds
+/// stored blocks. Larger than need be, but without a dependency.
+inline std::vector<uint8_t> png(std::vector<uint8_t> const &rgb, int w,
+                                int h) {
+  std::vector<uint8_t> out{0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  auto const u32 = [](std::vector<uint8_t> &v, uint32_t x) {
+    for (auto s : {24, 16, 8, 0})
+      v.push_back(uint8_t(x >> s));
+  };
+  auto const chunk = [&](char const *type, std::vector<uint8_t> const &data) {
+    u32(out, uint32_t(data.size()));
+    auto const start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    u32(out, crc32(out.data() + start, out.size() - start));
+  };
+  std::vector<uint8_t> ihdr;
+  u32(ihdr, uint32_t(w)), u32(ihdr, uint32_t(h));
+  ihdr.insert(ihdr.end(), {8, 2, 0, 0, 0}); // 8 bits, RGB, no interlace.
+  chunk("IHDR", ihdr);
+
+  // Rows, each after a filter type byte (0: none).
+  std::vector<uint8_t> raw;
+  auto const row = size_t(w) * 3;
+  raw.reserve((row + 1) * size_t(h));
+  for (auto y = 0; y < h; y++) {
+    raw.push_back(0);
+    auto const *r = rgb.data() + size_t(y) * row;
+    raw.insert(raw.end(), r, r + row);
+  }
+  std::vector<uint8_t> z{0x78, 0x01};
+  z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+  for (size_t i = 0; i < raw.size();) {
+    auto const n = std::min(raw.size() - i, size_t(65535));
+    z.push_back(i + n == raw.size()); // BFINAL; BTYPE = 0 (stored).
+    for (auto x : {n, ~n})
+      z.push_back(uint8_t(x)), z.push_back(uint8_t(x >> 8));
+    z.insert(z.end(), raw.begin() + ptrdiff_t(i),
+             raw.begin() + ptrdiff_t(i + n));
+    i += n;
+  }
+  u32(z, adler32(raw.data(), raw.size()));
+  chunk("IDAT", z);
+  chunk("IEND", {});
+  return out;
+}
+
+/// @brief Fill `g` with the weights of a Gaussian kernel (center c, standard
+/// deviation s) over the pixels [x0, x0 + g.size()), normalized to sum to 1.
+inline void kernel(std::vector<float> &g, int x0, float c, float s) {
+  auto sum = 0.0f;
+  for (size_t j = 0; j < g.size(); j++) {
+    auto t = (float(x0) + float(j) + 0.5f - c) / s;
+    sum += g[j] = std::exp(-0.5f * t * t);
+  }
+  for (auto &&x : g)
+    x /= sum;
+}
+
+/// @brief Add the kernel of a particle at c [pixels] to the buffer.
+inline void splat(float *buf, int w, int h, std::complex<float> c, float s,
+                  float mass, std::vector<float> &gx, std::vector<float> &gy) {
+  auto const reach = std::ceil(3.0f * s);
+  // (Off the image, or not a number.)
+  if (!(c.real() + reach >= 0.0f && c.real() - reach < float(w) &&
+        c.imag() + reach >= 0.0f && c.imag() - reach < float(h)))
+    return;
+  auto const x0 = int(std::floor(c.real() - reach)),
+             y0 = int(std::floor(c.imag() - reach));
+  auto const n = size_t(2.0f * reach) + 1;
+  gx.resize(n), gy.resize(n);
+  kernel(gx, x0, c.real(), s), kernel(gy, y0, c.imag(), s);
+  auto const xa = std::max(x0, 0), xb = std::min(x0 + int(n), w);
+  auto const ya = std::max(y0, 0), yb = std::min(y0 + int(n), h);
+  for (auto y = ya; y < yb; y++) {
+    auto const my = mass * gy[size_t(y - y0)];
+    auto *row = buf + size_t(y) * size_t(w);
+    for (auto x = xa; x < xb; x++)
+      row[x] += my * gx[size_t(x - x0)];
+  }
+}
+
+} // namespace detail
+
+inline void Image::write(std::string const &path, float white) const {
+  auto const fail = [&path](char const *what) {
+    return std::runtime_error{path + ": " + what};
+  };
+  auto const pixels = rgb(white);
+  std::vector<uint8_t> bytes;
+  auto const ends = [&path](std::string const &s) {
+    return path.size() >= s.size() &&
+           path.compare(path.size() - s.size(), s.size(), s) == 0;
+  };
+  if (ends(".png")) {
+    bytes = detail::png(pixels, w, h);
+  } else {
+    auto header = "P6\n" + std::to_string(w) + ' ' + std::to_string(h) +
+                  "\n255\n";
+    bytes.assign(header.begin(), header.end());
+    bytes.insert(bytes.end(), pixels.begin(), pixels.end());
+  }
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{
+      std::fopen(path.c_str(), "wb"), &std::fclose};
+  if (!f)
+    throw fail("cannot open for writing");
+  if (std::fwrite(bytes.data(), 1, bytes.size(), f.get()) != bytes.size() ||
+      std::fflush(f.get()))
+    throw fail("cannot write");
+}
+
+/// @brief Render the particles (anything with `xy`, `mass`, and `radius`, in a
+/// random-access range) as seen by the camera.
+template <typename R>
+Image render(R const &particles, Camera const &camera, int width, int height,
+             Options const &o = {}) {
+  Image image{width, height};
+  auto const w = image.width(), h = image.height();
+  auto const n = size_t(std::size(particles));
+  auto const k = std::max(o.buffers, 1);
+  auto const pixels = size_t(w) * size_t(h);
+  std::vector<std::vector<float>> buffers(static_cast<size_t>(k));
+
+  auto b = 0;
+#pragma omp parallel for schedule(dynamic)
+  for (b = 0; b < k; ++b) {
+    // (Allocate here, so the pages are first touched by this thread.)
+    auto &&buf = buffers[size_t(b)];
+    buf.assign(pixels, 0.0f);
+    std::vector<float> gx, gy;
+    auto const first = n * size_t(b) / size_t(k),
+               last = n * size_t(b + 1) / size_t(k);
+    for (auto i = first; i < last; i++) {
+      auto &&p = std::begin(particles)[ptrdiff_t(i)];
+      auto s = std::clamp(0.5f * p.radius * camera.zoom, o.min_sigma,
+                          o.max_sigma);
+      detail::splat(buf.data(), w, h, camera.to_screen(p.xy), s, p.mass, gx,
+                    gy);
+    }
+  }
+
+  // Sum the buffers (in order).
+  auto *out = image.data();
+  auto const m = static_cast<long long>(pixels);
+  auto i = 0LL;
+#pragma omp parallel for
+  for (i = 0; i < m; ++i) {
+    auto sum = 0.0f;
+    for (auto &&buf : buffers)
+      sum += buf[size_t(i)];
+    out[i] = sum;
+  }
+  return image;
+}
+
+} // namespace phy::splat
+
+#endif // GRASS_SPLAT_H
@@ -0,0 +1,414 @@
+#ifndef GRASS_TRAJECTORY_H
+#define GRASS_TRAJECTORY_H
+
+/// @file trajectory.h
+/// @brief Compact trajectory files and a recorder that writes them from a
+/// background thread.
+///
+/// Layout (native byte order, checked through the `endian` field):
+///
+///  - a 64-byte header (`trajectory::Header`),
+///  - frames, each a 32-byte `FrameHeader` followed by its payload,
+///  - an index of the frames' byte offsets (uint64 each) and a 24-byte
+///  `Trailer` that locates it. (A file without the index, for example one
+///  whose writer was killed, can still be read by walking the frames.)
+///
+/// The payload of a frame first lists the particles that have a Morton code,
+/// sorted by the code. Each such particle is stored as:
+///
+///  - the difference of its Morton code from the previous one (varint),
+///  - its offset inside its Morton cell, as two int16 fractions of a cell,
+///  - its quantized velocity and the quantized logarithms of its mass and
+///  radius, each as the difference from the previous particle's (zigzag
+///  varint).
+///
+/// Neighbors in Morton order are neighbors in space, so the differences are
+/// small and most of them take one or two bytes. The particles without a
+/// Morton code (far away or not finite) follow as raw `Sample` structures.
+
+#include <algorithm>
+#include <array>
+#include <barnes_hut.h>
+#include <cmath>
+#include <complex>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace phy::trajectory {
+
+/// @brief Magic bytes at the start of every trajectory.
+inline constexpr std::array<char, 8> MAGIC{'G', 'R', 'A', 'S',
+                                           'S', 'T', 'R', 'J'};
+
+/// @brief Magic bytes at the end of a trajectory that has an index.
+inline constexpr std::array<char, 8> INDEX_MAGIC{'G', 'R', 'A', 'S',
+                                                 'S', 'I', 'D', 'X'};
+
+/// @brief Magic bytes at the start of every frame.
+inline constexpr std::array<char, 4> FRAME_MAGIC{'F', 'R', 'M', 'E'};
+
+/// @brief Current version of the layout.
+inline constexpr uint32_t VERSION = 1;
+
+/// @brief Written as-is; reads back differently on a foreign byte order.
+inline constexpr uint32_t ENDIAN = 0x01020304;
+
+/// @brief Resolution of the Morton grid (cells per unit length).
+inline constexpr uint32_t PRECISION = 512;
+
+/// @brief The fixed-size file header.
+struct Header {
+  std::array<char, 8> magic{MAGIC};
+  uint32_t version{VERSION}, endian{ENDIAN};
+  /// @brief A frame was offered every this many steps.
+  uint32_t every{1};
+  /// @brief Quanta of the velocity [L/T] and of the base-2 logarithms of the
+  /// mass and radius.
+  float velocity_quantum{1.0f / 4096.0f}, log_quantum{1.0f / 256.0f};
+  std::array<char, 36> reserved{};
+};
+static_assert(sizeof(Header) == 64);
+
+/// @brief The fixed-size header of a frame.
+struct FrameHeader {
+  std::array<char, 4> magic{FRAME_MAGIC};
+  /// @brief Size of the payload that follows [bytes].
+  uint32_t bytes{};
+  /// @brief Step number and simulated time [T].
+  uint64_t step{};
+  double time{};
+  /// @brief Number of particles with and without a Morton code.
+  uint32_t keyed{}, loose{};
+};
+static_assert(sizeof(FrameHeader) == 32);
+
+/// @brief The last bytes of a trajectory that has an index.
+struct Trailer {
+  /// @brief Number of frames and the byte offset of the index.
+  uint64_t frames{}, index{};
+  std::array<char, 8> magic{INDEX_MAGIC};
+};
+static_assert(sizeof(Trailer) == 24);
+
+/// @brief The recorded state of one particle.
+struct Sample {
+  std::complex<float> xy, v;
+  float mass{}, radius{};
+};
+
+/// @brief A snapshot of all particles.
+struct Frame {
+  uint64_t step{};
+  double time{};
+  std::vector<Sample> particles;
+};
+
+namespace detail {
+
+inline void put_varint(std::vector<std::byte> &out, uint64_t u) {
+  for (; u >= 0x80; u >>= 7)
+    out.push_back(std::byte(u | 0x80));
+  out.push_back(std::byte(u));
+}
+
+/// @returns False if the input ran out (or the number is too long).
+inline bool get_varint(std::byte const *&p, std::byte const *end,
+                       uint64_t &u) {
+  u = 0;
+  for (unsigned shift = 0; p != end && shift < 64; shift += 7) {
+    auto b = uint64_t(*p++);
+    u |= (b & 0x7f) << shift;
+    if (!(b & 0x80))
+      return true;
+  }
+  return false;
+}
+
+constexpr uint64_t zigzag(int64_t i) {
+  return (uint64_t(i) << 1) ^ uint64_t(i >> 63);
+}
+
+constexpr int64_t unzigzag(uint64_t u) {
+  return int64_t(u >> 1) ^ -int64_t(u & 1);
+}
+
+/// @brief Round to an integer number of quanta, saturating far outside the
+/// range anybody would record (and mapping NaN to zero).
+inline int64_t quantize(float x, float quantum) {
+  auto constexpr LIMIT = 0x1p40;
+  auto q = double(x) / double(quantum);
+  return q == q ? int64_t(std::round(std::clamp(q, -LIMIT, LIMIT))) : 0;
+}
+
+inline int64_t quantize_log(float x, float quantum) {
+  return quantize(std::log2(std::max(x, 0x1p-100f)), quantum);
+}
+
+/// @brief Offset inside a Morton cell, as a fraction in (-1, 1) of a cell.
+inline int16_t cell_offset(float x, int32_t cell) {
+  auto f = x * float(PRECISION) - float(cell);
+  return int16_t(std::lround(std::clamp(f, -1.0f, 1.0f) * 32767.0f));
+}
+
+template <typename T> void put_raw(std::vector<std::byte> &out, T const &t) {
+  auto const *b = reinterpret_cast<std::byte const *>(&t);
+  out.insert(out.end(), b, b + sizeof t);
+}
+
+template <typename T>
+bool get_raw(std::byte const *&p, std::byte const *end, T &t) {
+  if (size_t(end - p) < sizeof t)
+    return false;
+  std::memcpy(&t, p, sizeof t), p += sizeof t;
+  return true;
+}
+
+} // namespace detail
+
+/// @brief Encode a frame (see the file comment for the layout).
+/// @param out Receives the frame header and the payload (cleared first).
+/// @param scratch Reusable work space (to avoid allocations).
+inline void encode(Frame const &f, Header const &h, std::vector<std::byte> &out,
+                   std::vector<std::pair<uint64_t, uint32_t>> &scratch) {
+  using namespace detail;
+  // Sort by Morton code; put the particles without one at the end.
+  auto const n = f.particles.size();
+  scratch.resize(n);
+  uint32_t keyed{};
+  for (uint32_t i = 0; i < n; i++) {
+    auto z = dyn::bh32::morton<PRECISION>(f.particles[i].xy);
+    scratch[i] = {z.value_or(~uint64_t{}), i};
+    keyed += z.has_value();
+  }
+  std::ranges::sort(scratch);
+
+  out.clear();
+  out.resize(sizeof(FrameHeader));
+  uint64_t z0{};
+  std::array<int64_t, 4> q0{};
+  for (uint32_t i = 0; i < keyed; i++) {
+    auto [z, j] = scratch[i];
+    auto const &s = f.particles[j];
+    put_varint(out, z - z0), z0 = z;
+    auto const [cx, cy] = dyn::bh32::unmorton(z);
+    put_raw(out, cell_offset(s.xy.real(), cx));
+    put_raw(out, cell_offset(s.xy.imag(), cy));
+    std::array<int64_t, 4> q{quantize(s.v.real(), h.velocity_quantum),
+                             quantize(s.v.imag(), h.velocity_quantum),
+                             quantize_log(s.mass, h.log_quantum),
+                             quantize_log(s.radius, h.log_quantum)};
+    for (size_t k = 0; k < q.size(); k++)
+      put_varint(out, zigzag(q[k] - q0[k]));
+    q0 = q;
+  }
+  for (auto i = size_t(keyed); i < n; i++)
+    put_raw(out, f.particles[scratch[i].second]);
+
+  FrameHeader fh;
+  fh.bytes = uint32_t(out.size() - sizeof fh);
+  fh.step = f.step, fh.time = f.time;
+  fh.keyed = keyed, fh.loose = uint32_t(n - keyed);
+  std::memcpy(out.data(), &fh, sizeof fh);
+}
+
+/// @brief Decode the payload of a frame whose header is `fh`.
+/// @param payload Exactly `fh.bytes` bytes.
+/// @returns False if the payload is malformed.
+inline bool decode(FrameHeader const &fh, std::span<std::byte const> payload,
+                   Header const &h, Frame &f) {
+  using namespace detail;
+  auto const *p = payload.data(), *end = p + payload.size();
+  f.step = fh.step, f.time = fh.time;
+  f.particles.resize(size_t(fh.keyed) + fh.loose);
+  uint64_t z{};
+  std::array<int64_t, 4> q{};
+  auto const scale = 1.0f / float(PRECISION);
+  for (uint32_t i = 0; i < fh.keyed; i++) {
+    uint64_t dz;
+    std::array<int16_t, 2> o;
+    if (!get_varint(p, end, dz) || !get_raw(p, end, o))
+      return false;
+    z += dz;
+    for (auto &&k : q) {
+      uint64_t u;
+      if (!get_varint(p, end, u))
+        return false;
+      k += unzigzag(u);
+    }
+    auto const [cx, cy] = dyn::bh32::unmorton(z);
+    auto &&s = f.particles[i];
+    s.xy = {(float(cx) + float(o[0]) / 32767.0f) * scale,
+            (float(cy) + float(o[1]) / 32767.0f) * scale};
+    s.v = {float(q[0]) * h.velocity_quantum,
+           float(q[1]) * h.velocity_quantum};
+    s.mass = std::exp2(float(q[2]) * h.log_quantum);
+    s.radius = std::exp2(float(q[3]) * h.log_quantum);
+  }
+  for (auto i = size_t(fh.keyed); i < f.particles.size(); i++)
+    if (!get_raw(p, end, f.particles[i]))
+      return false;
+  return p == end;
+}
+
+/// @brief Record every k-th offered frame to a trajectory file. Offering a
+/// frame copies it into a preallocated ring of slots; a background thread
+/// encodes and writes the slots in order. When all slots are taken (because
+/// the disk is slow), a frame is either dropped or waited for, as configured.
+class Recorder {
+public:
+  /// @brief What to do when all slots are taken.
+  enum class Overflow { drop, block };
+
+  struct Options {
+    /// @brief Keep every this many steps.
+    uint32_t every{1};
+    /// @brief Number of slots in the ring.
+    size_t slots{8};
+    /// @brief Preallocate each slot for this many particles.
+    size_t reserve{};
+    Overflow overflow{Overflow::drop};
+    /// @brief See `Header`.
+    float velocity_quantum{1.0f / 4096.0f}, log_quantum{1.0f / 256.0f};
+  };
+
+private:
+  Header header;
+  Overflow overflow;
+  std::ofstream out;
+  /// @brief Byte offset of every frame written so far.
+  std::vector<uint64_t> index;
+  uint64_t offset{};
+
+  /// @brief The ring. The producer fills `ring[head]`; the writer drains
+  /// `ring[tail]`; `filled` slots are waiting to be written.
+  std::vector<Frame> ring;
+  size_t head{}, tail{}, filled{};
+  uint64_t n_dropped{}, n_written{};
+  bool stop{}, failed{};
+  std::mutex mutex;
+  std::condition_variable cv_filled, cv_freed;
+  std::thread writer;
+
+  void put(void const *p, size_t bytes) {
+    out.write(static_cast<char const *>(p), std::streamsize(bytes));
+    offset += bytes;
+  }
+
+  void run() {
+    std::vector<std::byte> buf;
+    std::vector<std::pair<uint64_t, uint32_t>> scratch;
+    for (;;) {
+      {
+        std::unique_lock lock{mutex};
+        cv_filled.wait(lock, [this] { return filled || stop; });
+        if (!filled)
+          break;
+      }
+      // The producer does not touch filled slots; no lock needed here.
+      encode(ring[tail], header, buf, scratch);
+      index.push_back(offset);
+      put(buf.data(), buf.size());
+      std::lock_guard lock{mutex};
+      tail = (tail + 1) % ring.size(), --filled, ++n_written;
+      failed = failed || !out;
+      cv_freed.notify_one();
+    }
+    // Append the index and the trailer.
+    Trailer t;
+    t.frames = index.size(), t.index = offset;
+    put(index.data(), index.size() * sizeof(uint64_t));
+    put(&t, sizeof t);
+    out.flush();
+  }
+
+public:
+  /// @brief Create (or truncate) the file at `path` and start the writer.
+  /// @throws std::runtime_error If the file cannot be opened.
+  Recorder(std::string const &path, Options const &o)
+      : overflow{o.overflow}, out{path, std::ios::binary | std::ios::trunc},
+        ring(std::max(o.slots, size_t(1))) {
+    if (!out)
+      throw std::runtime_error{path + ": cannot open for writing"};
+    header.every = std::max(o.every, uint32_t(1));
+    header.velocity_quantum = o.velocity_quantum;
+    header.log_quantum = o.log_quantum;
+    for (auto &&f : ring)
+      f.particles.reserve(o.reserve);
+    put(&header, sizeof header);
+    writer = std::thread{[this] { run(); }};
+  }
+
+  Recorder(Recorder const &) = delete;
+  Recorder &operator=(Recorder const &) = delete;
+
+  /// @brief Write the frames still in the ring and the index, then close.
+  ~Recorder() {
+    {
+      std::lock_guard lock{mutex};
+      stop = true;
+    }
+    cv_filled.notify_one();
+    writer.join();
+  }
+
+  /// @brief Offer the state of the particles (anything with the `xy`, `v`,
+  /// `mass`, and `radius` fields) after step number `step`. Only every k-th
+  /// step is kept (see `Options::every`).
+  /// @returns Whether the frame was queued for writing.
+  bool record(auto const &particles, uint64_t step, double time) {
+    if (step % header.every)
+      return false;
+    {
+      std::unique_lock lock{mutex};
+      if (filled == ring.size()) {
+        if (overflow == Overflow::drop)
+          return ++n_dropped, false;
+        cv_freed.wait(lock, [this] { return filled < ring.size(); });
+      }
+    }
+    // The writer does not touch the slot at the head; no lock needed here.
+    auto &&f = ring[head];
+    f.step = step, f.time = time;
+    f.particles.clear();
+    for (auto &&p : particles)
+      f.particles.push_back({p.xy, p.v, p.mass, p.radius});
+    {
+      std::lock_guard lock{mutex};
+      head = (head + 1) % ring.size(), ++filled;
+    }
+    cv_filled.notify_one();
+    return true;
+  }
+
+  /// @brief Number of frames dropped because all slots were taken.
+  [[nodiscard]] uint64_t dropped() {
+    std::lock_guard lock{mutex};
+    return n_dropped;
+  }
+
+  /// @brief Number of frames written so far.
+  [[nodiscard]] uint64_t written() {
+    std::lock_guard lock{mutex};
+    return n_written;
+  }
+
+  /// @brief Test whether every write so far succeeded.
+  [[nodiscard]] bool good() {
+    std::lock_guard lock{mutex};
+    return !failed;
+  }
+};
+
+} // namespace phy::trajectory
+
+#endif // GRASS_TRAJECTORY_H
@@ -56,6 +56,9 @@ struct User {
   /// If R is pressed, the user wants to reset the simulation.
   bool wants_reset() const { return IsKeyPressed(KEY_R); }
 
+  /// If S is pressed, the user wants to save a checkpoint.
+  bool wants_checkpoint() const { return IsKeyPressed(KEY_S); }
+
   /// If T is pressed, show a different option.
   void rotate_debug_opts() {
     if (IsKeyPressed(KEY_T))
@@ -106,7 +109,11 @@ struct User {
   }
 
   /// Write text.
-  void hud(auto n_particles, auto n_limit) const {
+  /// @param conserved The latest measurement of the conserved quantities (an
+  /// optional `Table::Conserved`), and energy0 the energy to show the drift
+  /// against.
+  void hud(auto n_particles, auto n_limit, auto n_drawn, auto &&conserved,
+           double energy0) const {
     // The standard library understands how to format a complex number, but,
     // understandably, knows nothing about Raylib's custom vector types.
     auto constexpr v2c = [](Vector2 v) {
@@ -116,13 +123,21 @@ struct User {
     buf << "\"Grass\" gravity simulation\n\n";
     if (control.demo)
       buf << "(Demo; click anywhere to add particles)\n";
-    buf << "R to reset; T to debug; SPACE to pause\n"
+    buf << "R to reset; T to debug; SPACE to pause; S to save\n"
            "Left-click to add a particle; right-click to pan\n"
            "Use the mouse wheel to zoom in and out\n\n";
     if (show.fps)
       buf << "FPS: " << GetFPS() << '\n';
     if (show.n_particles)
-      buf << "N: " << n_particles << '\n' << "N (limit): " << n_limit << '\n';
+      buf << "N: " << n_particles << '\n' << "N (limit): " << n_limit << '\n'
+          << "Drawn: " << n_drawn << '\n';
+    if (show.n_particles && conserved) {
+      auto &&c = *conserved;
+      auto const drift = energy0 ? (c.energy() - energy0) / std::abs(energy0)
+                                 : 0.0;
+      buf << "E: " << c.energy() << " (drift " << drift << ")\n"
+          << "P: " << c.momentum << "\nL: " << c.angular << '\n';
+    }
     if (show.cam)
       buf << "Zoom: " << cam.zoom << "\nTarget: " << v2c(cam.target)
           << "\nOffset: " << v2c(cam.offset) << '\n';
@@ -131,6 +146,45 @@ struct User {
     DrawText(str.c_str(), 16, 16, 20, LIGHTGRAY);
   }
 
+  /// Write text while replaying a trajectory.
+  void hud_replay(auto &&player, auto &&frame) const {
+    std::stringstream buf;
+    buf << "\"Grass\" replay\n\n"
+           "SPACE to play or pause; B to play backward\n"
+           "LEFT/RIGHT to step (SHIFT: 10 frames); HOME/END\n"
+           "UP/DOWN to change the speed; T to debug\n\n";
+    buf << "Frame: " << player.position() + 1 << " / " << player.size()
+        << "\nSpeed: " << player.speed() << " frames/s\n";
+    if (frame)
+      buf << "Step: " << frame->step << "\nTime: " << frame->time << '\n';
+    if (show.fps)
+      buf << "FPS: " << GetFPS() << '\n';
+    if (show.n_particles && frame)
+      buf << "N: " << frame->particles.size() << '\n';
+    auto str = buf.str();
+    DrawText(str.c_str(), 18, 18, 20, BLACK);
+    DrawText(str.c_str(), 16, 16, 20, LIGHTGRAY);
+  }
+
+  /// While replaying, LEFT and RIGHT step a frame (or ten, with SHIFT).
+  [[nodiscard]] long wants_step() const {
+    auto n = IsKeyDown(KEY_LEFT_SHIFT) ? 10L : 1L;
+    return IsKeyPressed(KEY_RIGHT) ? n : IsKeyPressed(KEY_LEFT) ? -n : 0L;
+  }
+
+  /// While replaying, HOME and END jump to the first or the last frame.
+  [[nodiscard]] int wants_jump() const {
+    return IsKeyPressed(KEY_END) ? 1 : IsKeyPressed(KEY_HOME) ? -1 : 0;
+  }
+
+  /// While replaying, UP and DOWN make playback faster or slower.
+  [[nodiscard]] int wants_speed() const {
+    return IsKeyPressed(KEY_UP) ? 1 : IsKeyPressed(KEY_DOWN) ? -1 : 0;
+  }
+
+  /// While replaying, B reverses the direction of playback.
+  [[nodiscard]] bool wants_reverse() const { return IsKeyPressed(KEY_B); }
+
   /// If SPACE is pressed, toggle flight.
   void adjust_fly() {
     if (IsKeyPressed(KEY_SPACE))
@@ -0,0 +1,204 @@
+#ifndef GRASS_VIEW_H
+#define GRASS_VIEW_H
+
+/// @file view.h
+/// @brief Step particles held elsewhere, in place: in a `std::span` of
+/// `Particle`s, in arrays of their components (SoA), or in any storage with
+/// an accessor (see `Bodies`), without copying them into a `Table` and back.
+///
+/// A step reads each particle's position, mass, and radius once, into a
+/// scratch array in Z-order (with the index of the particle) over which it
+/// builds its tree, then integrates each particle and writes its position
+/// and velocity back where it is. The particles are not moved: `order` gives
+/// their Z-order, which `permute` applies if asked to (sorted particles make
+/// the next tree faster to build, as `Table::step` does).
+///
+/// With the same particles and the same physics (`Stepper::physics`), a step
+/// is the same as `Table::step`, to the bit, but for the order of the
+/// particles. Particles are never merged (see `Table::accretion`).
+
+#include <algorithm>
+#include <barnes_hut.h>
+#include <complex>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <packed.h>
+#include <span>
+#include <utility>
+#include <vector>
+#include <verlet.h>
+
+#include "Table.h"
+
+namespace phy::view {
+
+/// @brief Access to particles held elsewhere, by index. Optionally,
+/// `b.key(i, z)` keeps the Morton code of each particle (as
+/// `Particle::morton`), and `b.swap(i, j)` lets `permute` sort them.
+template <class B>
+concept Bodies = requires(B b, B const c, size_t i, std::complex<float> z) {
+                   { c.size() } -> std::convertible_to<size_t>;
+                   { c.xy(i) } -> std::convertible_to<std::complex<float>>;
+                   { c.v(i) } -> std::convertible_to<std::complex<float>>;
+                   { c.mass(i) } -> std::convertible_to<float>;
+                   { c.radius(i) } -> std::convertible_to<float>;
+                   // Set the position and velocity.
+                   b.set(i, z, z);
+                 };
+
+/// @brief `Particle`s in a span.
+struct Span {
+  std::span<Particle> particles;
+
+  [[nodiscard]] size_t size() const noexcept { return particles.size(); }
+  [[nodiscard]] std::complex<float> xy(size_t i) const noexcept {
+    return particles[i].xy;
+  }
+  [[nodiscard]] std::complex<float> v(size_t i) const noexcept {
+    return particles[i].v;
+  }
+  [[nodiscard]] float mass(size_t i) const noexcept {
+    return particles[i].mass;
+  }
+  [[nodiscard]] float radius(size_t i) const noexcept {
+    return particles[i].radius;
+  }
+  void set(size_t i, std::complex<float> xy, std::complex<float> v) noexcept {
+    particles[i].xy = xy, particles[i].v = v;
+  }
+  void key(size_t i, std::optional<uint64_t> z) noexcept {
+    particles[i].morton = z;
+  }
+  void swap(size_t i, size_t j) noexcept {
+    std::swap(particles[i], particles[j]);
+  }
+};
+
+/// @brief Particles as arrays of their components, all of the same size.
+/// The Morton codes are kept in `keys` if it is not empty (0 for none).
+struct Soa {
+  std::span<float> x, y, vx, vy, masses, radii;
+  std::span<uint64_t> keys{};
+
+  [[nodiscard]] size_t size() const noexcept { return x.size(); }
+  [[nodiscard]] std::complex<float> xy(size_t i) const noexcept {
+    return {x[i], y[i]};
+  }
+  [[nodiscard]] std::complex<float> v(size_t i) const noexcept {
+    return {vx[i], vy[i]};
+  }
+  [[nodiscard]] float mass(size_t i) const noexcept { return masses[i]; }
+  [[nodiscard]] float radius(size_t i) const noexcept { return radii[i]; }
+  void set(size_t i, std::complex<float> xy, std::complex<float> v) noexcept {
+    x[i] = xy.real(), y[i] = xy.imag(), vx[i] = v.real(), vy[i] = v.imag();
+  }
+  void key(size_t i, std::optional<uint64_t> z) noexcept {
+    if (!keys.empty())
+      keys[i] = z.value_or(0);
+  }
+  void swap(size_t i, size_t j) noexcept {
+    for (auto a : {x, y, vx, vy, masses, radii})
+      std::swap(a[i], a[j]);
+    if (!keys.empty())
+      std::swap(keys[i], keys[j]);
+  }
+};
+
+/// @brief Steps particles held elsewhere (see the top of the file), keeping
+/// its scratch arrays from one step to the next.
+template <typename Integrator = dyn::Verlet<float>> class Stepper {
+  /// What the tree needs of a particle, in Z-order, and where it is.
+  struct Body {
+    std::complex<float> xy;
+    float mass{}, radius{};
+    std::optional<uint64_t> morton;
+    uint32_t index{};
+  };
+
+  std::vector<Body> bodies;
+  std::vector<uint32_t> sorted;
+
+public:
+  /// @brief The constant of gravitation, the angle threshold, and the
+  /// softening of the steps (it has no particles).
+  Table<Integrator> physics;
+
+  Stepper() = default;
+
+  /// @brief Step with the physics of the given table (not a copy of its
+  /// particles).
+  explicit Stepper(Table<Integrator> const &table) {
+    physics.use_physics_of(table);
+  }
+
+  /// @brief Perform an integration step of the particles in place.
+  /// @param dt Step size [units: T].
+  template <Bodies B> void step(B &&b, float dt) {
+    namespace bh = dyn::bh32;
+    auto const n = b.size();
+    bodies.resize(n), sorted.resize(n);
+    for (size_t i = 0; i < n; i++) {
+      auto const xy = b.xy(i);
+      bodies[i] = {xy, b.mass(i), b.radius(i), bh::morton(xy), uint32_t(i)};
+    }
+    std::ranges::stable_sort(bodies, {}, &Body::morton);
+    for (size_t k = 0; k < n; k++)
+      sorted[k] = bodies[k].index;
+
+    using I = typename std::vector<Body>::iterator;
+    using E = typename Table<Integrator>::template Moments<I>;
+    bh::Packed tree;
+    {
+      auto const groups = bh::tree<E>(
+          bodies.begin(), bodies.end(),
+          [](Body const &p, uint64_t m) -> std::optional<uint64_t> {
+            return p.morton ? std::optional{*p.morton & m} : std::nullopt;
+          });
+      tree = bh::Packed{groups, bodies.begin()};
+    }
+
+    // As `Table::step`, in Z-order.
+    auto const m = static_cast<int>(n);
+    auto k = 0;
+#pragma omp parallel for schedule(static)
+    for (k = 0; k < m; ++k) {
+      auto &&p = bodies[size_t(k)];
+      auto const i = size_t(p.index);
+      auto ig = Integrator{p.xy, b.v(i)};
+      auto const self = tree.leaf(size_t(k));
+      ig.step(dt, [this, &tree, &p, self](auto xy) {
+        return physics.acceleration(tree, {xy, p.radius}, self);
+      });
+      b.set(i, ig.y0, ig.y1);
+      if constexpr (requires { b.key(i, p.morton); })
+        b.key(i, p.morton);
+    }
+  }
+
+  /// @brief The indices of the particles in the Z-order of the latest step.
+  [[nodiscard]] std::span<uint32_t const> order() const noexcept {
+    return sorted;
+  }
+};
+
+/// @brief Put the particles in the given order (a permutation of their
+/// indices, such as `Stepper::order`): the order[i]-th moves to i.
+template <Bodies B>
+requires requires(B b, size_t i) { b.swap(i, i); }
+void permute(B &&b, std::span<uint32_t const> order) {
+  std::vector<bool> done(order.size());
+  for (size_t s = 0; s < order.size(); s++) {
+    // Follow the cycle from s, putting each particle in its place.
+    for (auto i = s; !done[i]; i = order[i]) {
+      done[i] = true;
+      if (order[i] != s)
+        b.swap(i, order[i]);
+    }
+  }
+}
+
+} // namespace phy::view
+
+#endif // GRASS_VIEW_H
@@ -47,6 +47,27 @@ constexpr uint64_t interleave32(uint32_t re, uint32_t im) {
   // Imaginary first.
   return W[0] | (W[1] << 1);
 }
+
+/// @brief Undo `interleave32`: gather the even-numbered bits of w into the
+/// first word (re) and the odd-numbered bits into the second word (im).
+constexpr std::array<uint32_t, 2> deinterleave32(uint64_t w) {
+  // The magic numbers of `interleave32`, applied in the opposite order.
+  struct Help {
+    uint64_t mask;
+    unsigned shift;
+  };
+  std::array<Help, 5> constexpr H{{{0x3333333333333333, 1},
+                                   {0x0f0f0f0f0f0f0f0f, 2},
+                                   {0x00ff00ff00ff00ff, 4},
+                                   {0x0000ffff0000ffff, 8},
+                                   {0x00000000ffffffff, 16}}};
+  auto constexpr EVEN = uint64_t(0x5555555555555555);
+  std::array<uint64_t, 2> W{w & EVEN, (w >> 1) & EVEN};
+  for (auto &&v : W)
+    for (auto &&h : H)
+      v = (v | (v >> h.shift)) & h.mask;
+  return {uint32_t(W[0]), uint32_t(W[1])};
+}
 } // namespace detail
 
 /// @brief Compute the Morton (Z) code of a complex number xy assuming a squared
@@ -70,12 +91,22 @@ std::optional<uint64_t> morton(std::complex<float> xy) {
   return {};
 }
 
+/// @brief Find the integer grid coordinates (truncated toward zero, as in
+/// `morton`) of the cell that a Morton code refers to. Multiply by
+/// `1 / Precision` to get back to the scale of the original complex number.
+constexpr std::array<int32_t, 2> unmorton(uint64_t z) {
+  auto const sgn = uint32_t(0x8000'0000ul);
+  auto const [x, y] = detail::deinterleave32(z);
+  return {int32_t(x ^ sgn), int32_t(y ^ sgn)};
+}
+
 namespace detail {
 
 // The API consists of three things:
 
-// 1. Group of particles with one public member function:
-// Depth-first traversal.
+// 1. Group of particles with public member functions for depth-first
+// traversal and (for other traversals, such as the dual-tree ones of
+// query.h) read access to the group's data, first child, and next sibling.
 // 2. A niebloid [function-like object] type to delete a tree allocated in the
 // heap. (See the `delete_group` singleton for the actual niebloid).
 // 3. A free function to construct a tree.
@@ -111,6 +142,14 @@ template <class E, class I> struct Group {
     }
   }
 
+  /// User-provided extra physical data.
+  [[nodiscard]] E const &data() const noexcept { return extra; }
+
+  /// The first child group (null if a leaf), and the next sibling of this
+  /// group (null if the last of its parent's children).
+  [[nodiscard]] Group const *first_child() const noexcept { return child; }
+  [[nodiscard]] Group const *next_sibling() const noexcept { return sibling; }
+
   /// Allow hypothetical construction in the stack (no such public method exists
   /// as of writing).
   ~Group() = default;
@@ -308,6 +347,10 @@ std::unique_ptr<Group<E, I>, DeleteGroup> tree(I const first, I const last,
 
 using detail::tree;
 
+/// The type of the (owning pointer to the root of a) tree made by `tree`.
+template <class E, class I>
+using Tree = std::unique_ptr<detail::Group<E, I>, detail::DeleteGroup>;
+
 } // namespace dyn::bh32
 
 #endif // GRASS_BARNES_HUT_H
@@ -0,0 +1,234 @@
+#ifndef GRASS_FOF_H
+#define GRASS_FOF_H
+
+/// @file fof.h
+/// @brief Find clusters (halos) by friends-of-friends: two particles closer
+/// than the linking length are friends, and a cluster is a set of particles
+/// connected through friends.
+///
+/// The friends are found by traversing a `bh32` tree against itself (see
+/// `query.h`, whose requirements apply): pairs of groups farther apart than
+/// the linking length are skipped, and groups whose circles are small enough
+/// that all their particles are friends are joined without testing a pair.
+/// The traversal runs in parallel (with OpenMP) and joins the particles in a
+/// lock-free disjoint-set forest, whose result does not depend on the order.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <query.h>
+#include <utility>
+#include <vector>
+
+namespace dyn::fof {
+
+/// A cluster.
+struct Cluster {
+  /// Center of mass [L].
+  std::complex<float> xy;
+
+  /// Mass [M], and radius [L]: the greatest distance of a member from the
+  /// center of mass.
+  float mass{}, radius{};
+
+  /// Number of members, and the index of the first (in the tree's range).
+  size_t members{}, first{};
+};
+
+/// The clusters found.
+struct Catalog {
+  static constexpr uint32_t NONE = ~uint32_t{};
+
+  /// The clusters, in the order of their first members.
+  std::vector<Cluster> clusters;
+
+  /// The cluster of each particle (in the tree's range): an index into
+  /// `clusters`, or NONE if its cluster is smaller than asked for.
+  std::vector<uint32_t> label;
+};
+
+namespace detail {
+
+/// A disjoint-set forest that many threads can join sets of at once, with
+/// compare-and-swap. A parent is never greater than its child, so the root of
+/// a set is its least element whatever the order of the joins.
+class Forest {
+  std::vector<std::atomic<uint32_t>> parent;
+
+public:
+  explicit Forest(size_t n) : parent(n) {
+    for (size_t i = 0; i < n; i++)
+      parent[i].store(uint32_t(i), std::memory_order_relaxed);
+  }
+
+  [[nodiscard]] uint32_t find(uint32_t i) noexcept {
+    for (;;) {
+      auto p = parent[i].load(std::memory_order_relaxed);
+      if (p == i)
+        return i;
+      // Path halving: point i to its grandparent on the way.
+      auto const g = parent[p].load(std::memory_order_relaxed);
+      if (g != p)
+        parent[i].compare_exchange_weak(p, g, std::memory_order_relaxed);
+      i = g;
+    }
+  }
+
+  void join(uint32_t a, uint32_t b) noexcept {
+    for (;;) {
+      a = find(a), b = find(b);
+      if (a == b)
+        return;
+      if (a > b)
+        std::swap(a, b);
+      // Put the greater root under the lesser, unless another thread just
+      // put it under something else (then try again).
+      if (parent[b].compare_exchange_strong(b, a, std::memory_order_relaxed))
+        return;
+    }
+  }
+};
+
+/// The traversal that finds friends in part of the tree.
+template <class E, class I> struct Friends {
+  using G = bh32::detail::Group<E, I>;
+  float linking{}, slack{};
+  I base;
+  Forest &forest;
+
+  [[nodiscard]] uint32_t index(I i) const noexcept {
+    return uint32_t(i - base);
+  }
+
+  /// Whether all the particles of g are friends.
+  [[nodiscard]] bool tight(G const *g) const noexcept {
+    return 2.0f * (g->data().circle().radius + slack) <= linking;
+  }
+
+  /// Join all the particles of g with its first one.
+  void chain(G const *g) noexcept {
+    auto &&e = g->data();
+    for (auto i = std::next(e.first); i != e.last; ++i)
+      forest.join(index(e.first), index(i));
+  }
+
+  /// Join the friends among the pairs of a particle in [first0, last0) and a
+  /// later one in [first1, last1).
+  void pairs(I first0, I last0, I first1, I last1) noexcept {
+    for (auto i = first0; i != last0; ++i)
+      for (auto j = std::max(first1, std::next(i)); j < last1; ++j)
+        if (std::norm(i->xy - j->xy) <= linking * linking)
+          forest.join(index(i), index(j));
+  }
+
+  void self(G const *g) noexcept {
+    auto &&e = g->data();
+    if (tight(g))
+      return chain(g);
+    if (bh32::detail::few(g))
+      return pairs(e.first, e.last, e.first, e.last);
+    for (auto a = g->first_child(); a; a = a->next_sibling()) {
+      self(a);
+      for (auto b = a->next_sibling(); b; b = b->next_sibling())
+        cross(a, b);
+    }
+  }
+
+  void cross(G const *a, G const *b) noexcept {
+    auto const ca = a->data().circle(), cb = b->data().circle();
+    auto const d = std::abs(ca - cb);
+    auto const r = ca.radius + cb.radius + 2.0f * slack;
+    if (d - r > linking)
+      return;
+    if (d + r <= linking) {
+      // Every particle of a is a friend of every particle of b.
+      chain(a), chain(b);
+      return forest.join(index(a->data().first), index(b->data().first));
+    }
+    if (bh32::detail::few(a) && bh32::detail::few(b))
+      return pairs(a->data().first, a->data().last, b->data().first,
+                   b->data().last);
+    if (bh32::detail::few(b) ||
+        (!bh32::detail::few(a) && ca.radius >= cb.radius))
+      for (auto c = a->first_child(); c; c = c->next_sibling())
+        cross(c, b);
+    else
+      for (auto c = b->first_child(); c; c = c->next_sibling())
+        cross(a, c);
+  }
+};
+
+} // namespace detail
+
+/// @brief Find the clusters of the particles of a tree (with `xy` and `mass`).
+/// @param linking Linking length [L] (friends are up to this far apart).
+/// @param min_members Report only clusters of at least this many particles.
+/// @param slack Padding of the groups' circles [L], for particles that moved
+/// since the tree was built (see `query.h`).
+template <class E, class I>
+Catalog clusters(bh32::Tree<E, I> const &tree, float linking,
+                 size_t min_members = 1, float slack = 0.0f) {
+  using G = bh32::detail::Group<E, I>;
+  Catalog catalog;
+  if (!tree)
+    return catalog;
+  auto const first = tree->data().first;
+  auto const n = size_t(tree->data().last - first);
+  detail::Forest forest{n};
+
+  detail::Friends<E, I> const f{linking, slack, first, forest};
+  auto const tasks = bh32::detail::tasks(
+      tree.get(),
+      [&f](G const *a, G const *b) {
+        auto const ca = a->data().circle(), cb = b->data().circle();
+        return std::abs(ca - cb) - ca.radius - cb.radius - 2.0f * f.slack >
+               f.linking;
+      },
+      [&f](G const *g) { return f.tight(g) || bh32::detail::few(g); });
+  auto const m = static_cast<int>(tasks.size());
+  auto k = 0;
+#pragma omp parallel for schedule(dynamic, 1)
+  for (k = 0; k < m; ++k) {
+    auto friends = f;
+    auto [a, b] = tasks[k];
+    a == b ? friends.self(a) : friends.cross(a, b);
+  }
+
+  // Sum up the clusters by their roots (their first members).
+  std::vector<uint32_t> root(n);
+  std::vector<double> mass(n);
+  std::vector<std::complex<double>> moment(n);
+  std::vector<size_t> members(n);
+  for (size_t i = 0; i < n; i++) {
+    auto &&p = first[ptrdiff_t(i)];
+    auto const r = root[i] = forest.find(uint32_t(i));
+    mass[r] += p.mass, moment[r] += double(p.mass) * std::complex<double>{p.xy};
+    ++members[r];
+  }
+  // Number the clusters large enough, in order.
+  std::vector<uint32_t> number(n, Catalog::NONE);
+  for (size_t i = 0; i < n; i++)
+    if (root[i] == i && members[i] >= std::max(min_members, size_t(1))) {
+      number[i] = uint32_t(catalog.clusters.size());
+      catalog.clusters.push_back(
+          {std::complex<float>{moment[i] / mass[i]}, float(mass[i]), 0.0f,
+           members[i], i});
+    }
+  catalog.label.resize(n);
+  for (size_t i = 0; i < n; i++) {
+    auto const c = catalog.label[i] = number[root[i]];
+    if (c != Catalog::NONE) {
+      auto &&cluster = catalog.clusters[c];
+      cluster.radius = std::max(
+          cluster.radius, std::abs(first[ptrdiff_t(i)].xy - cluster.xy));
+    }
+  }
+  return catalog;
+}
+
+} // namespace dyn::fof
+
+#endif // GRASS_FOF_H
@@ -60,6 +60,42 @@ public:
     return {};
   }
 
+  /// @brief Compute the gravitational potential at the point xy due to a mass
+  /// m1 of circle c1: the potential of the field that `field` computes for a
+  /// test particle of radius 0 there (zero at infinity).
+  /// @return A scalar quantity of dimensions [M/L]. Multiply it by the
+  /// universal gravitational constant ("G") to get LL/T/T.
+  static constexpr F potential(std::complex<F> xy, Circle<F> c1,
+                               F m1) noexcept {
+    auto const r = std::abs(c1 - xy), R = c1.radius;
+    if (r < R)
+      // Inside, the field grows linearly with the distance from the center.
+      return m1 * ((r * r - R * R) / F(2) - F(1) / R);
+    // Outside, the usual law (nothing at the center of a point mass).
+    return r > F{} ? -m1 / r : F{};
+  }
+
+  /// @brief Compute the gravitational potential that a test particle
+  /// represented by the circle c0 feels due to a mass m1 of circle c1: the
+  /// potential of the field that `field` computes, averaged over the test
+  /// particle's disk in the same way when the circles are not disjoint.
+  /// @param distance Optional distance (non-positive if must be computed).
+  /// @return A scalar quantity of dimensions [M/L]. Multiply it by the
+  /// universal gravitational constant ("G") to get LL/T/T.
+  F potential(Circle<F> c0, Circle<F> c1, F m1,
+              F distance = F(-1)) const noexcept {
+    auto const r = distance > F{} ? distance : std::abs(c1 - c0);
+    if (!(r > F{}))
+      return {};
+    if (c1.radius + c0.radius <= r)
+      return -m1 / r;
+    // The same points as `non_disjoint`.
+    F phi{};
+    for (auto &&p : disk)
+      phi += potential(c0 + c0.radius * p, c1, m1);
+    return phi / F(N_MONTE);
+  }
+
   /// @brief Populate internal random disk (used for calculating forces in the
   /// case of intersecting circles) with new evenly distributed points on the
   /// unit disk centered about the origin. Call often to avoid bias.
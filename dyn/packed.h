@@ -0,0 +1,237 @@
+#ifndef GRASS_PACKED_H
+#define GRASS_PACKED_H
+
+/// @file packed.h
+/// @brief A `bh32` tree flattened into an array of 16-byte nodes for the
+/// force walks, which read little else than each group's circle and mass:
+/// four nodes to a cache line, against one `Group` (with its extra data) to
+/// one or two.
+///
+/// The nodes are in depth-first order, each followed by its children's
+/// subtrees. A group of many particles is stored with its center as 16-bit
+/// offsets from its parent's center, in 1/32767 of the parent's radius, its
+/// radius in 1/32768 of the parent's, rounded up so that its circle still
+/// holds its particles with its center rounded, its mass, and the index
+/// of the node after its subtree (to skip it). A particle is stored as it is
+/// (center, radius, and mass, as floats), so that close encounters are summed
+/// exactly; the sign bit of the mass tells the two apart.
+///
+/// The centers of the groups are off by up to about 2e-5 of their parents'
+/// radii; as a group is taken as a whole only if it is far away, that changes
+/// its force by less than a millionth or so. The groups' circles are not
+/// smaller than the tree's.
+///
+/// The extra data E of the tree must have `xy`, `radius`, `mass`, `first`,
+/// and `many` (see `phy::Table`).
+
+#include <algorithm>
+#include <barnes_hut.h>
+#include <circle.h>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace dyn::bh32 {
+
+/// A node of a packed tree (see the top of the file).
+struct Node {
+  struct Quantized {
+    int16_t x, y;
+    uint16_t radius, reserved;
+  };
+  struct Exact {
+    float x, y;
+  };
+
+  /// A group: center and radius (quantized), and the node after its subtree.
+  /// A particle: center and radius, with the mass stored negated.
+  union {
+    Quantized group;
+    Exact particle;
+  };
+  float mass;
+  union {
+    uint32_t skip;
+    float radius;
+  };
+};
+
+static_assert(sizeof(Node) == 16);
+
+/// A node as the walk sees it.
+struct View {
+  Circle<float> circle;
+  float mass{};
+
+  /// Whether a group of many particles (to be looked into or not).
+  bool many{};
+
+  /// Index of the node.
+  uint32_t node{};
+};
+
+/// A tree of 16-byte nodes (see the top of the file).
+class Packed {
+  std::vector<Node> nodes;
+
+  /// The node of each particle (in the tree's range).
+  std::vector<uint32_t> leaves;
+
+  /// The circle of the root, exactly.
+  Circle<float> root;
+
+  /// (A center is within its parent's circle, but a radius may be up to
+  /// twice its parent's, as the center of mass of a child is off its
+  /// parent's.)
+  static constexpr float OFFSET = 32767.0f, FRACTION = 32768.0f;
+
+  /// The circle of a group, given its parent's.
+  [[nodiscard]] static Circle<float> decode(Node const &n,
+                                            Circle<float> parent) noexcept {
+    return {parent + parent.radius / OFFSET *
+                         std::complex{float(n.group.x), float(n.group.y)},
+            parent.radius / FRACTION * float(n.group.radius)};
+  }
+
+public:
+  Packed() = default;
+
+  /// @brief Pack a tree whose particles start at `base`.
+  template <class E, class I> Packed(Tree<E, I> const &tree, I const base) {
+    pack(tree, base);
+  }
+
+  /// @brief Pack a tree whose particles start at `base` in place of this one,
+  /// into its storage (and so onto its pages; see `place`) if it is large
+  /// enough. Return whether the storage is new.
+  template <class E, class I> bool pack(Tree<E, I> const &tree, I const base) {
+    nodes.clear(), leaves.clear();
+    if (!tree)
+      return false;
+    auto const n = size_t(tree->data().last - tree->data().first);
+    size_t count{};
+    tree->depth_first([&count](auto &&) {
+      ++count;
+      return true;
+    });
+    // (With some room to grow, so as not to move for a few more nodes.)
+    auto const fresh = nodes.capacity() < count || leaves.capacity() < n;
+    if (fresh) {
+      nodes = {}, leaves = {};
+      nodes.reserve(count + count / 16), leaves.reserve(n + n / 16);
+    }
+    leaves.resize(n);
+    root = tree->data().circle();
+    // Depth first, in order, with the parents' circles (as decoded).
+    auto const pack = [&](auto &&pack, detail::Group<E, I> const *g,
+                          Circle<float> parent) -> void {
+      auto &&e = g->data();
+      auto const k = nodes.size();
+      nodes.emplace_back();
+      if (!e.many) {
+        auto &&node = nodes[k];
+        node.particle = {e.xy.real(), e.xy.imag()};
+        node.mass = -e.mass, node.radius = e.radius;
+        // (Negated even if 0.)
+        if (!std::signbit(node.mass))
+          node.mass = -0.0f;
+        leaves[size_t(e.first - base)] = uint32_t(k);
+        return;
+      }
+      auto c = root;
+      if (k) {
+        auto const q = [](float x) {
+          return int16_t(std::clamp(std::round(x * OFFSET), -OFFSET, OFFSET));
+        };
+        auto const d = (e.xy - parent) / parent.radius;
+        auto &&node = nodes[k];
+        node.group = {q(d.real()), q(d.imag()), 0, 0};
+        c = decode(node, parent);
+        // The smallest radius that holds the group about the rounded center.
+        auto const r = e.radius + std::abs(c - e.xy);
+        auto f = std::ceil(r / parent.radius * FRACTION);
+        node.group.radius = uint16_t(std::clamp(f, 0.0f, 65535.0f));
+        while (node.group.radius < UINT16_MAX &&
+               decode(node, parent).radius < r)
+          ++node.group.radius;
+        c = decode(node, parent);
+      }
+      nodes[k].mass = e.mass;
+      for (auto a = g->first_child(); a; a = a->next_sibling())
+        pack(pack, a, c);
+      nodes[k].skip = uint32_t(nodes.size());
+    };
+    pack(pack, tree.get(), root);
+    return fresh;
+  }
+
+  [[nodiscard]] explicit operator bool() const noexcept {
+    return !nodes.empty();
+  }
+
+  /// @brief Number of nodes.
+  [[nodiscard]] size_t size() const noexcept { return nodes.size(); }
+
+  /// @brief Node of particle i (in the tree's range).
+  [[nodiscard]] uint32_t leaf(size_t i) const noexcept { return leaves[i]; }
+
+  /// @brief Bytes of the nodes, and of the nodes of the particles.
+  [[nodiscard]] size_t bytes() const noexcept {
+    return nodes.capacity() * sizeof(Node) +
+           leaves.capacity() * sizeof(uint32_t);
+  }
+
+  /// @brief Hand the arrays of the nodes to `f`, as spans, such as to move
+  /// their pages (see numa.h).
+  void place(auto &&f) {
+    f(std::span{nodes});
+    f(std::span{leaves});
+  }
+
+  /// @brief Apply depth-first traversal, as `Group::depth_first` does (in the
+  /// same order): if `deeper(view)` suggests going deeper into a group
+  /// (true), go deeper.
+  void depth_first(auto &&deeper) const {
+    if (nodes.empty())
+      return;
+    struct Pending {
+      uint32_t node;
+      Circle<float> circle;
+    };
+    std::vector<Pending> v;
+    v.reserve(131); // Some good enough prime number.
+    v.push_back({0, root});
+    while (!v.empty()) {
+      auto const [k, c] = v.back();
+      v.pop_back();
+      auto &&n = nodes[k];
+      if (std::signbit(n.mass)) {
+        deeper(View{{{n.particle.x, n.particle.y}, n.radius}, -n.mass, false,
+                    k});
+        continue;
+      }
+      if (!deeper(View{c, n.mass, true, k}))
+        continue;
+      // The children, each after the previous one's subtree.
+      for (auto a = k + 1; a < n.skip;) {
+        auto &&child = nodes[a];
+        if (std::signbit(child.mass)) {
+          v.push_back({a, {}});
+          ++a;
+        } else {
+          v.push_back({a, decode(child, c)});
+          a = child.skip;
+        }
+      }
+    }
+  }
+};
+
+} // namespace dyn::bh32
+
+#endif // GRASS_PACKED_H
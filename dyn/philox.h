@@ -0,0 +1,113 @@
+#ifndef GRASS_PHILOX_H
+#define GRASS_PHILOX_H
+
+/// @file philox.h
+/// @brief Philox4x32, a counter-based random number generator.
+
+#include <array>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <numbers>
+
+namespace dyn {
+
+/// @brief The Philox4x32 counter-based random number generator (Salmon et
+/// al., "Parallel Random Numbers: As Easy as 1, 2, 3", 2011). The output is a
+/// pure function of the key (seed) and a 128-bit counter, so any number of
+/// threads can draw the numbers for, say, particle i without coordination,
+/// and the results do not depend on how the work was split.
+/// @tparam R Number of rounds (10 is the recommended, "crush-resistant"
+/// choice).
+template <unsigned R = 10> class Philox {
+public:
+  /// @brief A counter or an output block.
+  using Block = std::array<uint32_t, 4>;
+
+private:
+  std::array<uint32_t, 2> key;
+
+  static constexpr void mulhilo(uint32_t a, uint32_t b, uint32_t &hi,
+                                uint32_t &lo) {
+    auto p = uint64_t(a) * b;
+    hi = uint32_t(p >> 32), lo = uint32_t(p);
+  }
+
+public:
+  /// @brief Use the given key (seed).
+  constexpr explicit Philox(uint64_t seed)
+      : key{uint32_t(seed), uint32_t(seed >> 32)} {}
+
+  /// @brief Construct a generator with the raw key words.
+  constexpr Philox(uint32_t k0, uint32_t k1) : key{k0, k1} {}
+
+  /// @brief Encrypt the counter.
+  [[nodiscard]] constexpr Block operator()(Block c) const {
+    auto constexpr M0 = uint32_t(0xD2511F53), M1 = uint32_t(0xCD9E8D57);
+    auto constexpr W0 = uint32_t(0x9E3779B9), W1 = uint32_t(0xBB67AE85);
+    auto k = key;
+    for (unsigned r = 0; r < R; r++) {
+      uint32_t hi0, lo0, hi1, lo1;
+      mulhilo(M0, c[0], hi0, lo0);
+      mulhilo(M1, c[2], hi1, lo1);
+      c = {hi1 ^ c[1] ^ k[0], lo1, hi0 ^ c[3] ^ k[1], lo0};
+      k[0] += W0, k[1] += W1;
+    }
+    return c;
+  }
+
+  /// @brief A stream of random numbers belonging to one item (for example,
+  /// particle i) and one purpose (a small integer chosen by the caller).
+  /// Successive draws use successive counters.
+  class Stream {
+    Philox const *g;
+    Block counter, block{};
+    unsigned used{4};
+
+  public:
+    constexpr Stream(Philox const &g, uint64_t item, uint32_t purpose)
+        : g{&g}, counter{uint32_t(item), uint32_t(item >> 32), purpose, 0} {}
+
+    /// @brief Draw 32 uniformly distributed bits.
+    constexpr uint32_t bits() {
+      if (used == 4)
+        block = (*g)(counter), ++counter[3], used = 0;
+      return block[used++];
+    }
+
+    /// @brief Draw a number uniformly distributed on the open interval (0, 1).
+    constexpr float uniform() {
+      // 24 bits of mantissa; offset by half a step to exclude both ends.
+      return (float(bits() >> 8) + 0.5f) * 0x1p-24f;
+    }
+
+    /// @brief Draw a standard normal number (Box-Muller). Unlike the standard
+    /// library's distributions, the algorithm (and so the result) is the same
+    /// on every platform.
+    float normal() {
+      auto r = std::sqrt(-2.0f * std::log(uniform()));
+      return r * std::cos(2.0f * std::numbers::pi_v<float> * uniform());
+    }
+
+    /// @brief Draw a complex number whose parts are independent standard
+    /// normal numbers.
+    std::complex<float> normal_xy() {
+      auto r = std::sqrt(-2.0f * std::log(uniform()));
+      return std::polar(r, 2.0f * std::numbers::pi_v<float> * uniform());
+    }
+
+    /// @brief Draw a log-normal number with the given parameters (the mean
+    /// and the standard deviation of the logarithm).
+    float lognormal(float m, float s) { return std::exp(m + s * normal()); }
+  };
+
+  /// @brief Get the stream of the given item and purpose.
+  [[nodiscard]] constexpr Stream stream(uint64_t item,
+                                        uint32_t purpose = 0) const {
+    return {*this, item, purpose};
+  }
+};
+
+} // namespace dyn
+
+#endif // GRASS_PHILOX_H
@@ -0,0 +1,321 @@
+#ifndef GRASS_QUERY_H
+#define GRASS_QUERY_H
+
+/// @file query.h
+/// @brief Spatial queries over a `bh32` tree: the particles in a rectangle,
+/// the particles within a distance of a point, and the k particles nearest to
+/// a point; and, by a traversal of the tree against itself, all pairs of
+/// particles whose disks overlap. Whole groups are skipped (or taken) by their
+/// circles, and small groups are tested particle by particle.
+///
+/// Besides the requirements of `bh32::tree`, the extra data E of the groups
+/// must have:
+///  - `circle()`, a `Circle` that holds the centers of all the particles of
+///    the group (it may hold more, such as their disks), and
+///  - `first` and `last`, the range of the particles of the group (random
+///    access iterators).
+///
+/// A particle's center is its `xy` (and its radius, for `overlaps`, its
+/// `radius`; then the circles of the groups must hold the particles' disks).
+/// The circles of the groups can be padded
+/// by `slack` [L] for particles that have moved since the tree was built (by
+/// up to that much); particles are tested where they are now.
+
+#include <algorithm>
+#include <barnes_hut.h>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <iterator>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace dyn::bh32 {
+
+namespace detail {
+
+/// Groups of up to this many particles are tested particle by particle
+/// rather than looked into.
+inline constexpr auto FEW = 8;
+
+/// The square of the distance from xy to the rectangle with the less-less
+/// (ll) and greater-greater (gg) corners (0 inside).
+inline float norm_to_rectangle(std::complex<float> xy, std::complex<float> ll,
+                               std::complex<float> gg) noexcept {
+  auto const clamp = std::complex<float>{
+      std::clamp(xy.real(), ll.real(), gg.real()),
+      std::clamp(xy.imag(), ll.imag(), gg.imag())};
+  return std::norm(xy - clamp);
+}
+
+} // namespace detail
+
+/// @brief Visit each particle whose center is in the rectangle with the
+/// less-less (ll) and greater-greater (gg) corners (edges included).
+template <class E, class I>
+void range(Tree<E, I> const &tree, std::complex<float> ll,
+           std::complex<float> gg, auto &&visit, float slack = 0.0f) {
+  if (!tree)
+    return;
+  tree->depth_first([&](E const &e) {
+    auto const c = e.circle();
+    auto const r = c.radius + slack;
+    if (detail::norm_to_rectangle(c, ll, gg) > r * r)
+      return false;
+    auto const inside =
+        ll.real() <= c.real() - r && c.real() + r <= gg.real() &&
+        ll.imag() <= c.imag() - r && c.imag() + r <= gg.imag();
+    if (inside || e.last - e.first <= detail::FEW) {
+      for (auto i = e.first; i != e.last; ++i)
+        if (inside || detail::norm_to_rectangle(i->xy, ll, gg) == 0.0f)
+          visit(*i);
+      return false;
+    }
+    return true;
+  });
+}
+
+namespace detail {
+
+/// `within`, but visit the iterators to the particles.
+template <class E, class I>
+void within(Tree<E, I> const &tree, std::complex<float> xy, float radius,
+            auto &&visit, float slack) {
+  if (!tree)
+    return;
+  tree->depth_first([&](E const &e) {
+    auto const c = e.circle();
+    auto const r = c.radius + slack;
+    auto const d = std::abs(c - xy);
+    if (d > radius + r)
+      return false;
+    auto const inside = d + r <= radius;
+    if (inside || e.last - e.first <= FEW) {
+      for (auto i = e.first; i != e.last; ++i)
+        if (inside || std::norm(i->xy - xy) <= radius * radius)
+          visit(i);
+      return false;
+    }
+    return true;
+  });
+}
+
+} // namespace detail
+
+/// @brief Visit each particle whose center is within `radius` [L] of xy.
+template <class E, class I>
+void within(Tree<E, I> const &tree, std::complex<float> xy, float radius,
+            auto &&visit, float slack = 0.0f) {
+  detail::within(
+      tree, xy, radius, [&visit](I i) { visit(*i); }, slack);
+}
+
+/// @brief Find the k particles whose centers are nearest to xy (fewer if the
+/// tree has fewer), nearest first.
+/// @param out Set to the particles found (its storage is reused).
+template <class E, class I>
+void nearest(Tree<E, I> const &tree, std::complex<float> xy, size_t k,
+             std::vector<I> &out, float slack = 0.0f) {
+  out.clear();
+  if (!tree || !k)
+    return;
+  // The best so far, as a max-heap by the square of the distance.
+  std::vector<std::pair<float, I>> best;
+  best.reserve(k);
+  auto const further = [](auto &&a, auto &&b) { return a.first < b.first; };
+  tree->depth_first([&](E const &e) {
+    auto const c = e.circle();
+    auto const d = std::max(std::abs(c - xy) - c.radius - slack, 0.0f);
+    if (best.size() == k && d * d > best.front().first)
+      return false;
+    if (e.last - e.first > detail::FEW)
+      return true;
+    for (auto i = e.first; i != e.last; ++i) {
+      auto const n = std::norm(i->xy - xy);
+      if (best.size() < k) {
+        best.emplace_back(n, i);
+        std::ranges::push_heap(best, further);
+      } else if (n < best.front().first) {
+        std::ranges::pop_heap(best, further);
+        best.back() = {n, i};
+        std::ranges::push_heap(best, further);
+      }
+    }
+    return false;
+  });
+  std::ranges::sort_heap(best, further);
+  for (auto &&b : best)
+    out.push_back(b.second);
+}
+
+/// @brief `within` for many points at once (in parallel, with OpenMP).
+/// @param out Set to the particles found for each point (in any order).
+template <class E, class I>
+void within(Tree<E, I> const &tree, std::span<std::complex<float> const> xy,
+            float radius, std::vector<std::vector<I>> &out,
+            float slack = 0.0f) {
+  out.resize(xy.size());
+  auto const m = static_cast<int>(xy.size());
+  auto n = 0;
+#pragma omp parallel for schedule(dynamic, 64)
+  for (n = 0; n < m; ++n) {
+    auto &&o = out[n];
+    o.clear();
+    detail::within(
+        tree, xy[n], radius, [&o](I i) { o.push_back(i); }, slack);
+  }
+}
+
+/// @brief `nearest` for many points at once (in parallel, with OpenMP).
+/// @param out Set to the particles found for each point, nearest first.
+template <class E, class I>
+void nearest(Tree<E, I> const &tree, std::span<std::complex<float> const> xy,
+             size_t k, std::vector<std::vector<I>> &out, float slack = 0.0f) {
+  out.resize(xy.size());
+  auto const m = static_cast<int>(xy.size());
+  auto n = 0;
+#pragma omp parallel for schedule(dynamic, 64)
+  for (n = 0; n < m; ++n)
+    nearest(tree, xy[n], k, out[n], slack);
+}
+
+namespace detail {
+
+/// Whether to test the particles of group g rather than look into it.
+template <class E, class I> bool few(Group<E, I> const *g) noexcept {
+  return !g->first_child() || g->data().last - g->data().first <= FEW;
+}
+
+/// Whether the circles of groups a and b, padded by slack, are disjoint.
+template <class E, class I>
+bool disjoint(Group<E, I> const *a, Group<E, I> const *b,
+              float slack) noexcept {
+  auto const ca = a->data().circle(), cb = b->data().circle();
+  auto const r = ca.radius + cb.radius + 2.0f * slack;
+  return std::norm(ca - cb) >= r * r;
+}
+
+/// Split the top of a traversal of the tree against itself into tasks: pairs
+/// of groups (a == b for the pairs within a group), enough to go around the
+/// threads. Pairs for which `apart(a, b)` are dropped, and groups for which
+/// `whole(g)` are not split.
+template <class E, class I>
+std::vector<std::pair<Group<E, I> const *, Group<E, I> const *>>
+tasks(Group<E, I> const *root, auto &&apart, auto &&whole) {
+  auto constexpr TASKS = 256;
+  std::vector<std::pair<Group<E, I> const *, Group<E, I> const *>> tasks{
+      {root, root}};
+  for (auto split = true; split && tasks.size() < TASKS;) {
+    split = false;
+    decltype(tasks) next;
+    for (auto [a, b] : tasks) {
+      if (whole(a)) {
+        next.emplace_back(a, b);
+        continue;
+      }
+      split = true;
+      for (auto c = a->first_child(); c; c = c->next_sibling()) {
+        if (a != b) {
+          if (!apart(c, b))
+            next.emplace_back(c, b);
+          continue;
+        }
+        next.emplace_back(c, c);
+        for (auto d = c->next_sibling(); d; d = d->next_sibling())
+          if (!apart(c, d))
+            next.emplace_back(c, d);
+      }
+    }
+    tasks.swap(next);
+  }
+  return tasks;
+}
+
+/// The pairs of particles found by `overlaps` in part of the tree.
+template <class E, class I> struct Overlaps {
+  using G = Group<E, I>;
+  float slack{};
+  std::vector<std::pair<I, I>> &out;
+
+  static bool overlap(I i, I j) noexcept {
+    auto const r = i->radius + j->radius;
+    return std::norm(i->xy - j->xy) < r * r;
+  }
+
+  /// Pairs within group g.
+  void self(G const *g) {
+    if (few(g)) {
+      auto &&e = g->data();
+      for (auto i = e.first; i != e.last; ++i)
+        for (auto j = std::next(i); j != e.last; ++j)
+          if (overlap(i, j))
+            out.emplace_back(i, j);
+      return;
+    }
+    for (auto a = g->first_child(); a; a = a->next_sibling()) {
+      self(a);
+      for (auto b = a->next_sibling(); b; b = b->next_sibling())
+        cross(a, b);
+    }
+  }
+
+  /// Pairs of a particle of group a and one of group b (a before b).
+  void cross(G const *a, G const *b) {
+    if (disjoint(a, b, slack))
+      return;
+    if (few(a) && few(b)) {
+      auto &&e = a->data(), &&f = b->data();
+      for (auto i = e.first; i != e.last; ++i)
+        for (auto j = f.first; j != f.last; ++j)
+          if (overlap(i, j))
+            out.emplace_back(i, j);
+      return;
+    }
+    // Look into the larger group (or the one that can be looked into).
+    if (few(b) || (!few(a) && a->data().circle().radius >=
+                                  b->data().circle().radius))
+      for (auto c = a->first_child(); c; c = c->next_sibling())
+        cross(c, b);
+    else
+      for (auto c = b->first_child(); c; c = c->next_sibling())
+        cross(a, c);
+  }
+};
+
+} // namespace detail
+
+/// @brief Find all pairs of particles whose disks overlap (closer than the
+/// sum of their radii), each once, by traversing the tree against itself:
+/// pairs of groups whose circles are disjoint are skipped, so the time taken
+/// grows with the number of pairs that are close rather than with N * N. The
+/// top of the traversal is split into tasks that run in parallel (with
+/// OpenMP); the pairs come out in the same order either way.
+/// @param out Set to the pairs (i, j), with i before j.
+template <class E, class I>
+void overlaps(Tree<E, I> const &tree, std::vector<std::pair<I, I>> &out,
+              float slack = 0.0f) {
+  using G = detail::Group<E, I>;
+  out.clear();
+  if (!tree)
+    return;
+  auto const tasks = detail::tasks(
+      tree.get(),
+      [slack](G const *a, G const *b) { return detail::disjoint(a, b, slack); },
+      [](G const *g) { return detail::few(g); });
+  std::vector<std::vector<std::pair<I, I>>> found(tasks.size());
+  auto const m = static_cast<int>(tasks.size());
+  auto n = 0;
+#pragma omp parallel for schedule(dynamic, 1)
+  for (n = 0; n < m; ++n) {
+    detail::Overlaps<E, I> o{slack, found[n]};
+    auto [a, b] = tasks[n];
+    a == b ? o.self(a) : o.cross(a, b);
+  }
+  for (auto &&f : found)
+    out.insert(out.end(), f.begin(), f.end());
+}
+
+} // namespace dyn::bh32
+
+#endif // GRASS_QUERY_H
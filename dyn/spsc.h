@@ -0,0 +1,56 @@
+#ifndef GRASS_SPSC_H
+#define GRASS_SPSC_H
+
+/// @file spsc.h
+/// @brief A lock-free, bounded, single-producer single-consumer queue.
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <optional>
+#include <utility>
+
+namespace dyn {
+
+/// @brief A lock-free ring buffer between exactly one producer thread and
+/// exactly one consumer thread. Pushing to a full queue fails rather than
+/// waits.
+/// @tparam T Type of the elements (default-constructible and movable).
+/// @tparam N Capacity (a power of 2).
+template <typename T, size_t N = 256> class Spsc {
+  static_assert(N && !(N & (N - 1)), "the capacity must be a power of 2");
+
+  std::array<T, N> ring{};
+
+  /// @brief Number of elements ever popped (by the consumer) and ever pushed
+  /// (by the producer). Kept on separate cache lines.
+  alignas(64) std::atomic<size_t> head{};
+  alignas(64) std::atomic<size_t> tail{};
+
+public:
+  /// @brief Append an element (producer only).
+  /// @return False if the queue is full (and the element was not pushed).
+  bool push(T t) {
+    auto const k = tail.load(std::memory_order_relaxed);
+    if (k - head.load(std::memory_order_acquire) == N)
+      return false;
+    ring[k % N] = std::move(t);
+    tail.store(k + 1, std::memory_order_release);
+    return true;
+  }
+
+  /// @brief Take the oldest element (consumer only).
+  /// @return Nothing if the queue is empty.
+  std::optional<T> pop() {
+    auto const k = head.load(std::memory_order_relaxed);
+    if (k == tail.load(std::memory_order_acquire))
+      return {};
+    std::optional<T> t{std::move(ring[k % N])};
+    head.store(k + 1, std::memory_order_release);
+    return t;
+  }
+};
+
+} // namespace dyn
+
+#endif // GRASS_SPSC_H
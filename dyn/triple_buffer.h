@@ -0,0 +1,62 @@
+#ifndef GRASS_TRIPLE_BUFFER_H
+#define GRASS_TRIPLE_BUFFER_H
+
+/// @file triple_buffer.h
+/// @brief A lock-free triple buffer for handing the latest value from one
+/// thread to another.
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+namespace dyn {
+
+/// @brief A lock-free triple buffer: one writer thread keeps producing values,
+/// and one reader thread takes the latest complete one. Neither ever waits for
+/// the other. Values the reader did not get to are skipped.
+///
+/// The writer fills `back()` and calls `publish()`; the reader calls
+/// `refresh()` and reads `front()`. Buffers are recycled, so the writer finds
+/// an old value in `back()` (handy for reusing the capacity of containers) and
+/// must overwrite all of it.
+/// @tparam T Type of the values.
+template <typename T> class TripleBuffer {
+  /// @brief Set in `middle` when it holds a value the reader has not seen.
+  static constexpr uint8_t FRESH = 4, INDEX = 3;
+
+  std::array<T, 3> buffers{};
+
+  /// @brief Index of the buffer between the two threads (and `FRESH`).
+  alignas(64) std::atomic<uint8_t> middle{1};
+
+  /// @brief Indices of the writer's and of the reader's buffers.
+  alignas(64) uint8_t writing{0};
+  alignas(64) uint8_t reading{2};
+
+public:
+  /// @brief The buffer to fill (writer only).
+  [[nodiscard]] T &back() noexcept { return buffers[writing]; }
+
+  /// @brief Make the back buffer the latest value (writer only).
+  void publish() noexcept {
+    writing = middle.exchange(writing | FRESH, std::memory_order_acq_rel) &
+              INDEX;
+  }
+
+  /// @brief Take the latest value, if there is a new one (reader only).
+  /// @return True if `front()` changed.
+  bool refresh() noexcept {
+    if (!(middle.load(std::memory_order_relaxed) & FRESH))
+      return false;
+    reading = middle.exchange(reading, std::memory_order_acq_rel) & INDEX;
+    return true;
+  }
+
+  /// @brief The latest value taken by `refresh()` (reader only). Initially,
+  /// a value-initialized `T`.
+  [[nodiscard]] T const &front() const noexcept { return buffers[reading]; }
+};
+
+} // namespace dyn
+
+#endif // GRASS_TRIPLE_BUFFER_H
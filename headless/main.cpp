@@ -0,0 +1,592 @@
+// Run the simulation without a window, for long runs on servers and for
+// benchmarks. Configured through environment variables (see README.md).
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "Table.h"
+#include "accuracy.h"
+#include "checkpoint.h"
+#include "compact.h"
+#include "distributed.h"
+#include "ensemble.h"
+#include "env.h"
+#include "initial.h"
+#include "loader.h"
+#include "numa.h"
+#include "outofcore.h"
+#include "rollback.h"
+#include "shm.h"
+#include "splat.h"
+#include "trajectory.h"
+
+using namespace phy;
+
+namespace main_program {
+
+/// Settings of a headless run.
+struct Settings {
+  Constants constants;
+
+  /// Run the ensemble of simulations listed here instead, if any (see
+  /// ensemble.h), batching members of up to `ensemble_batch` particles, and
+  /// write their results to `ensemble_out`.
+  std::optional<std::string> ensemble;
+  std::string ensemble_out{"ensemble.csv"};
+  size_t ensemble_batch{ensemble::Options{}.batch_limit};
+
+  /// Step the checkpoint here in place instead, if any, out of core (see
+  /// outofcore.h), for as many steps.
+  std::optional<std::string> out_of_core;
+  outofcore::Options out_of_core_options;
+
+  /// Step the particles stored quantized instead (see compact.h).
+  bool compact{};
+  compact::Options compact_options;
+
+  /// Step across this many processes (ranks) instead, each with the particles
+  /// of a range of Morton codes (see distributed.h), moving the ranges every
+  /// `rebalance_every` steps (never if 0).
+  int ranks{1};
+  uint64_t rebalance_every{distributed::Plan{}.rebalance_every};
+
+  /// Pin the threads to these CPUs, in order (not if none), and have them
+  /// write the particles and the tree first, each its share (see numa.h).
+  std::vector<int> pin;
+  bool first_touch{};
+
+  /// Number of steps and step size [T].
+  uint64_t steps{1'000};
+  float dt{1.0f / 90.0f};
+
+  /// Print timings every this many steps.
+  uint64_t report_every{100};
+
+  /// Measure the energy, momentum, and angular momentum at the start and with
+  /// each report, as of the start of its step (see `Table::measure`).
+  bool conserved{};
+
+  /// Measure the accuracy of the forces over this many particles with each
+  /// report (never if 0; see accuracy.h).
+  size_t accuracy{};
+
+  /// Merge particles closer than this fraction of the sum of their radii
+  /// (0 never to; see `Table::accretion`).
+  float accretion{};
+
+  /// How to roll back after a NaN or an infinity (before giving up).
+  rollback::Options rollback;
+
+  /// Resume from this checkpoint, if any.
+  std::optional<std::string> checkpoint;
+
+  /// Otherwise, load the initial conditions from this file, if any.
+  std::optional<std::string> initial;
+
+  /// Record the trajectory here, if anywhere.
+  std::optional<std::string> record;
+  trajectory::Recorder::Options record_options;
+
+  /// Publish snapshots in this shared memory segment (if any), every
+  /// `shm_every` steps.
+  std::optional<std::string> shm;
+  uint64_t shm_every{1};
+
+  /// Find clusters by friends-of-friends every `fof_every` steps (never if
+  /// 0), with this linking length [L], and report those of `fof_min` or more
+  /// particles; write their catalogs here (CSV), if anywhere.
+  uint64_t fof_every{};
+  float fof_linking{0.05f};
+  size_t fof_min{10};
+  std::optional<std::string> fof;
+
+  /// Map the gravitational potential or field (see `Table::map`) here, if
+  /// anywhere, in the view and at the size of the images (see `render`): as
+  /// an image (`.png`, `.ppm`) or raw 32-bit floats (otherwise). With a run
+  /// of `#` in the path, every `map_every` steps, or else at the end.
+  std::optional<std::string> map;
+  Table<>::Map map_what{Table<>::Map::potential};
+  uint64_t map_every{1};
+
+  /// Render images here, if anywhere: one per `render_every` steps if the
+  /// path has a run of `#` (replaced by the step number), or else one at the
+  /// end. The camera is the demo's initial one, times `render_zoom`.
+  std::optional<std::string> render;
+  uint64_t render_every{1};
+  int render_width{1280}, render_height{720};
+  float render_zoom{1.0f};
+
+  static Settings from_env() {
+    Settings s;
+    s.constants.flags.galaxies = env::get("GRASS_GALAXIES").has_value();
+    s.constants.flags.plummer = env::get("GRASS_PLUMMER").has_value();
+    s.constants.seed = env::number<uint64_t>("GRASS_SEED");
+    if (auto n = env::number<size_t>("GRASS_PARTICLES_LIMIT"); n && *n)
+      s.constants.PARTICLES_LIMIT = *n;
+    s.ensemble = env::get("GRASS_ENSEMBLE");
+    if (auto o = env::get("GRASS_ENSEMBLE_OUT"); o && !o->empty())
+      s.ensemble_out = *o;
+    s.ensemble_batch =
+        env::number<size_t>("GRASS_ENSEMBLE_BATCH").value_or(s.ensemble_batch);
+    s.out_of_core = env::get("GRASS_OUT_OF_CORE");
+    if (auto n = env::number<size_t>("GRASS_OUT_OF_CORE_BLOCK"); n && *n)
+      s.out_of_core_options.block = *n;
+    if (auto n = env::number<size_t>("GRASS_OUT_OF_CORE_CELL"); n && *n)
+      s.out_of_core_options.cell = *n;
+    s.compact = env::get("GRASS_COMPACT").has_value();
+    if (auto n = env::number<size_t>("GRASS_COMPACT_CELL"); n && *n)
+      s.compact_options.cell = *n;
+    if (auto n = env::number<int>("GRASS_RANKS"); n && *n > 0)
+      s.ranks = *n;
+    s.rebalance_every = env::number<uint64_t>("GRASS_REBALANCE_EVERY")
+                            .value_or(s.rebalance_every);
+    if (auto p = env::get("GRASS_PIN")) {
+      try {
+        s.pin = numa::cpus(*p);
+      } catch (std::invalid_argument const &e) {
+        throw std::runtime_error{std::string{"GRASS_PIN: "} + e.what()};
+      }
+    }
+    s.first_touch = env::get("GRASS_FIRST_TOUCH").has_value();
+    s.steps = env::number<uint64_t>("GRASS_STEPS").value_or(s.steps);
+    if (auto dt = env::number<float>("GRASS_DT"); dt && *dt > 0.0f)
+      s.dt = *dt;
+    if (auto n = env::number<uint64_t>("GRASS_REPORT_EVERY"); n && *n)
+      s.report_every = *n;
+    s.conserved = env::get("GRASS_CONSERVED").has_value();
+    s.accuracy = env::number<size_t>("GRASS_ACCURACY").value_or(0);
+    if (auto a = env::number<float>("GRASS_ACCRETION"); a && *a > 0.0f)
+      s.accretion = *a;
+    if (auto k = env::number<uint64_t>("GRASS_ROLLBACK_EVERY"); k && *k)
+      s.rollback.every = *k;
+    if (auto k = env::number<unsigned>("GRASS_ROLLBACK_DEPTH"))
+      s.rollback.depth = *k;
+    s.checkpoint = env::get("GRASS_CHECKPOINT");
+    s.initial = env::get("GRASS_LOAD");
+    s.record = env::get("GRASS_RECORD");
+    // Unlike the demo, wait for a slow disk rather than lose frames.
+    s.record_options.overflow = trajectory::Recorder::Overflow::block;
+    if (env::get("GRASS_RECORD_DROP").has_value())
+      s.record_options.overflow = trajectory::Recorder::Overflow::drop;
+    if (auto k = env::number<uint32_t>("GRASS_RECORD_EVERY"); k && *k)
+      s.record_options.every = *k;
+    s.shm = env::get("GRASS_SHM");
+    if (auto k = env::number<uint64_t>("GRASS_SHM_EVERY"); k && *k)
+      s.shm_every = *k;
+    s.fof_every = env::number<uint64_t>("GRASS_FOF_EVERY").value_or(0);
+    if (auto b = env::number<float>("GRASS_FOF_LINK"); b && *b > 0.0f)
+      s.fof_linking = *b;
+    s.fof_min = env::number<size_t>("GRASS_FOF_MIN").value_or(s.fof_min);
+    s.fof = env::get("GRASS_FOF");
+    s.map = env::get("GRASS_MAP");
+    if (env::get("GRASS_MAP_FIELD").has_value())
+      s.map_what = Table<>::Map::field;
+    if (auto k = env::number<uint64_t>("GRASS_MAP_EVERY"); k && *k)
+      s.map_every = *k;
+    s.render = env::get("GRASS_RENDER");
+    if (auto k = env::number<uint64_t>("GRASS_RENDER_EVERY"); k && *k)
+      s.render_every = *k;
+    if (auto size = env::get("GRASS_RENDER_SIZE")) {
+      // Width x height (for example, 1920x1080).
+      auto x = size->find('x');
+      int w{}, h{};
+      auto const *p = size->data();
+      if (x != std::string::npos &&
+          std::from_chars(p, p + x, w).ec == std::errc{} &&
+          std::from_chars(p + x + 1, p + size->size(), h).ec == std::errc{} &&
+          w > 0 && h > 0)
+        s.render_width = w, s.render_height = h;
+    }
+    if (auto z = env::number<float>("GRASS_RENDER_ZOOM"); z && *z > 0.0f)
+      s.render_zoom = *z;
+    return s;
+  }
+
+  /// Whether to render a movie (rather than one image at the end).
+  [[nodiscard]] bool movie() const { return render && numbered(*render); }
+
+  /// Whether to map a movie (rather than once at the end).
+  [[nodiscard]] bool map_movie() const { return map && numbered(*map); }
+
+  /// Whether a path has a run of `#` to replace with the step number.
+  static bool numbered(std::string const &path) {
+    return path.find('#') != std::string::npos;
+  }
+
+  /// The path with its run of `#` (if any) replaced by the zero-padded step
+  /// number i.
+  static std::string numbered(std::string path, uint64_t i) {
+    auto first = path.find('#');
+    if (first == std::string::npos)
+      return path;
+    auto last = path.find_first_not_of('#', first);
+    last = last == std::string::npos ? path.size() : last;
+    auto digits = std::to_string(i);
+    if (digits.size() < last - first)
+      digits.insert(0, last - first - digits.size(), '0');
+    return path.replace(first, last - first, digits);
+  }
+};
+
+static int run_ensemble(Settings const &s) {
+  auto members = ensemble::load(s.ensemble.value());
+  auto const stats = ensemble::run(members, {s.ensemble_batch});
+  ensemble::write(members, s.ensemble_out);
+  auto const failed = std::ranges::count_if(
+      members, [](auto &&m) { return m.failed != 0; });
+  std::printf("ensemble: %zu members (%zu in %zu batches, %zu alone), %zu "
+              "went wrong\n",
+              members.size(), stats.batched, stats.batches, stats.alone,
+              size_t(failed));
+  std::printf("total: %.3f s, %.4g particle-steps/s\n", stats.seconds,
+              double(stats.particle_steps) / std::max(stats.seconds, 1e-9));
+  std::printf("results written to %s\n", s.ensemble_out.c_str());
+  return 0;
+}
+
+static int run_out_of_core(Settings const &s) {
+  outofcore::Stepper stepper{s.out_of_core.value(), s.out_of_core_options};
+  double total{}, report{};
+  for (uint64_t i = 1; i <= s.steps; i++) {
+    auto const stats = stepper.step(s.dt);
+    stepper.refresh_disk();
+    total += stats.seconds, report += stats.seconds;
+    if (!stats.good) {
+      std::fprintf(stderr, "step %llu: NaN or infinity; stopping\n",
+                   (unsigned long long)i);
+      return 1;
+    }
+    if (i % s.report_every == 0) {
+      std::printf("step %llu: N = %zu in %zu blocks, %zu cells (%.1f MiB in "
+                  "memory), %.2f cells opened per particle, %.3f ms/step\n",
+                  (unsigned long long)i, stats.particles, stats.blocks,
+                  stats.cells, double(stats.resident) / double(1 << 20),
+                  stats.opened,
+                  1000.0 * report / double(s.report_every));
+      report = 0.0;
+    }
+  }
+  std::printf("total: %.3f s, %.3f ms/step\n", total,
+              1000.0 * total / double(std::max(s.steps, uint64_t(1))));
+  return 0;
+}
+
+static int run_compact(Settings const &s, Table<> &&table) {
+  auto const n = table.size();
+  compact::Store store{table, s.compact_options};
+  table = Table<>{};
+  std::printf("compact: %.2f bytes per particle (%zu bytes as particles)\n",
+              double(store.bytes()) / double(std::max(n, size_t(1))),
+              sizeof(Particle));
+  double total{}, report{};
+  for (uint64_t i = 1; i <= s.steps; i++) {
+    auto const stats = store.step(s.dt);
+    store.refresh_disk();
+    total += stats.seconds, report += stats.seconds;
+    if (!stats.good) {
+      std::fprintf(stderr, "step %llu: NaN or infinity; stopping\n",
+                   (unsigned long long)i);
+      return 1;
+    }
+    if (i % s.report_every == 0) {
+      std::printf("step %llu: N = %zu in %zu cells (%.1f MiB, %.1f MiB of "
+                  "tree, %.1f MiB at the most), %.2f cells opened per "
+                  "particle, quantum %.3g, %.3f ms/step\n",
+                  (unsigned long long)i, stats.particles, stats.cells,
+                  double(stats.bytes) / double(1 << 20),
+                  double(stats.tree) / double(1 << 20),
+                  double(stats.peak) / double(1 << 20), stats.opened,
+                  double(stats.quantum),
+                  1000.0 * report / double(s.report_every));
+      report = 0.0;
+    }
+  }
+  std::printf("total: %.3f s, %.3f ms/step\n", total,
+              1000.0 * total / double(std::max(s.steps, uint64_t(1))));
+  return 0;
+}
+
+static int run_distributed(Settings const &s, Table<> &table) {
+#ifdef GRASS_DISTRIBUTED
+  auto const t0 = std::chrono::steady_clock::now();
+  distributed::Launch launch{s.ranks};
+  distributed::run(
+      launch.comm, &table, {s.steps, s.dt, s.rebalance_every, s.report_every},
+      [&s](uint64_t i, std::span<distributed::Stats const> ranks) {
+        std::printf("step %llu:", (unsigned long long)i);
+        for (auto &&r : ranks)
+          std::printf(" [N = %llu, %llu imported, %llu migrated, %.3f ms "
+                      "forces, %.3f ms/step]",
+                      (unsigned long long)r.own, (unsigned long long)r.imported,
+                      (unsigned long long)r.migrated,
+                      1000.0 * r.forces / double(s.report_every),
+                      1000.0 * r.steps / double(s.report_every));
+        std::printf("\n");
+      });
+  launch.join();
+  auto const total =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t0)
+          .count();
+  std::printf("total: %.3f s, %.3f ms/step on %d ranks, N = %zu\n", total,
+              1000.0 * total / double(std::max(s.steps, uint64_t(1))), s.ranks,
+              table.size());
+  return 0;
+#else
+  (void)table;
+  throw std::runtime_error{"GRASS_RANKS: processes are not supported on this "
+                           "platform"};
+#endif
+}
+
+static int run(Settings const &s) {
+  using clock = std::chrono::steady_clock;
+  if (s.ensemble)
+    return run_ensemble(s);
+  if (s.out_of_core)
+    return run_out_of_core(s);
+
+  auto const make_table = [&s] {
+    if (s.checkpoint)
+      return checkpoint::load(s.checkpoint.value());
+    if (s.initial) {
+      Table<> t;
+      t.G = s.constants.G;
+      loader::load(s.initial.value(), t);
+      return t;
+    }
+    return generate(s.constants);
+  };
+  auto const t_load = clock::now();
+  Table<> table = make_table();
+  table.accretion = s.accretion;
+  table.first_touch = s.first_touch;
+  std::printf("initial conditions: %.3f s\n",
+              std::chrono::duration<double>(clock::now() - t_load).count());
+  if (s.ranks > 1)
+    return run_distributed(s, table);
+  if (s.compact)
+    return run_compact(s, std::move(table));
+  std::optional<trajectory::Recorder> recorder;
+  if (s.record) {
+    auto o = s.record_options;
+    o.reserve = table.size();
+    recorder.emplace(s.record.value(), o);
+  }
+  std::optional<shm::Publisher> publisher;
+  if (s.shm)
+    publisher.emplace(s.shm.value(),
+                      std::max<uint64_t>(table.size(),
+                                         s.constants.PARTICLES_LIMIT));
+
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> catalogs{nullptr,
+                                                             &std::fclose};
+  if (s.fof && s.fof_every) {
+    catalogs.reset(std::fopen(s.fof->c_str(), "w"));
+    if (!catalogs)
+      throw std::runtime_error{s.fof.value() + ": cannot open for writing"};
+    std::fprintf(catalogs.get(), "step,time,cluster,members,mass,x,y,radius\n");
+  }
+  auto const find_clusters = [&](uint64_t i, double time) {
+    auto t = clock::now();
+    auto const catalog = table.clusters(s.fof_linking, s.fof_min);
+    auto ms = std::chrono::duration<double, std::milli>(clock::now() - t);
+    auto &&c = catalog.clusters;
+    auto largest = std::ranges::max_element(c, {}, &dyn::fof::Cluster::members);
+    std::printf("step %llu: %zu clusters of %zu or more particles",
+                (unsigned long long)i, c.size(), s.fof_min);
+    if (largest != c.end())
+      std::printf("; the largest has %zu, mass %.4g, radius %.4g at (%.4g, "
+                  "%.4g)",
+                  largest->members, double(largest->mass),
+                  double(largest->radius), double(largest->xy.real()),
+                  double(largest->xy.imag()));
+    std::printf(" (%.3f ms)\n", ms.count());
+    if (catalogs)
+      for (size_t k = 0; k < c.size(); k++)
+        std::fprintf(catalogs.get(), "%llu,%.9g,%zu,%zu,%.9g,%.9g,%.9g,%.9g\n",
+                     (unsigned long long)i, time, k, c[k].members,
+                     double(c[k].mass), double(c[k].xy.real()),
+                     double(c[k].xy.imag()), double(c[k].radius));
+  };
+
+  auto camera = splat::Camera::fit(s.render_width, s.render_height);
+  camera.zoom *= s.render_zoom;
+  uint64_t images{};
+  double render_seconds{};
+  auto const render = [&](uint64_t i) {
+    auto t = clock::now();
+    splat::render(table, camera, s.render_width, s.render_height)
+        .write(Settings::numbered(s.render.value(), i));
+    render_seconds += std::chrono::duration<double>(clock::now() - t).count();
+    ++images;
+  };
+  std::vector<float> samples;
+  auto const map = [&](uint64_t i) {
+    auto const w = s.render_width, h = s.render_height;
+    table.map(s.map_what, camera.to_world({}),
+              camera.to_world({float(w), float(h)}), w, h, samples);
+    auto const path = Settings::numbered(s.map.value(), i);
+    if (path.ends_with(".png") || path.ends_with(".ppm")) {
+      splat::Image image{w, h};
+      std::ranges::copy(samples, image.data());
+      if (s.map_what == Table<>::Map::potential) {
+        // The depth of the potential below its highest point in view.
+        auto const top = std::ranges::max(samples);
+        std::ranges::transform(samples, image.data(),
+                               [top](float x) { return top - x; });
+      }
+      return image.write(path);
+    }
+    std::unique_ptr<std::FILE, int (*)(std::FILE *)> f{
+        std::fopen(path.c_str(), "wb"), &std::fclose};
+    if (!f || std::fwrite(samples.data(), sizeof(float), samples.size(),
+                          f.get()) != samples.size())
+      throw std::runtime_error{path + ": cannot write"};
+  };
+
+  std::optional<double> energy0;
+  auto const measure = [&](Table<>::Conserved const &c) {
+    if (!energy0)
+      energy0 = c.energy();
+    std::printf("  energy %.9g (drift %.3g), momentum (%.4g, %.4g), angular "
+                "momentum %.9g\n",
+                c.energy(), (c.energy() - *energy0) / std::abs(*energy0),
+                c.momentum.real(), c.momentum.imag(), c.angular);
+  };
+
+  auto const measure_accuracy = [&](uint64_t i) {
+    auto t = clock::now();
+    table.index();
+    auto const r = accuracy::compare(
+        table.size(), s.accuracy, i,
+        [&table](size_t k) { return table.acceleration(k); },
+        [&table](size_t k) { return table.direct(k); });
+    auto ms = std::chrono::duration<double, std::milli>(clock::now() - t);
+    std::printf("  force errors over %zu particles: median %.3g, 99th "
+                "percentile %.3g, max %.3g (%.3f ms)\n",
+                r.samples, r.median, r.p99, r.max, ms.count());
+  };
+
+  std::printf("N = %zu, steps = %llu, dt = %g\n", table.size(),
+              (unsigned long long)s.steps, double(s.dt));
+  if (!s.pin.empty() || s.first_touch) {
+    auto const pinned = numa::pin(s.pin);
+    std::printf("%zu NUMA nodes, %zu threads pinned, first touch %s\n",
+                numa::nodes().size(), pinned, s.first_touch ? "on" : "off");
+  }
+  if (s.conserved)
+    measure(table.conserved());
+  if (s.accuracy)
+    measure_accuracy(0);
+  if (s.movie())
+    render(0);
+  if (s.map_movie())
+    map(0);
+  auto const t0 = clock::now();
+  auto t1 = t0;
+  double time{};
+  rollback::Ring<Table<>> ring{s.rollback};
+  auto const advance = [&s](Table<> &t, float dt) {
+    std::erase_if(t, [&s](auto &&p) { return s.constants.too_far(p.xy); });
+    t.step(dt);
+    t.refresh_disk();
+  };
+  for (uint64_t i = 1; i <= s.steps; i++) {
+    auto const t_step = clock::now();
+    auto const recovered = ring.stats().recovered;
+    // (Measured by the step, at its start.)
+    table.measure = s.conserved && i % s.report_every == 0;
+    if (!ring.step(table, i, s.dt, advance)) {
+      std::fprintf(stderr, "step %llu: NaN or infinity; stopping\n",
+                   (unsigned long long)i);
+      return 1;
+    }
+    if (auto &&r = ring.stats(); r.recovered != recovered)
+      std::fprintf(stderr,
+                   "step %llu: NaN or infinity; redid it from step %llu in "
+                   "steps of dt/%u\n",
+                   (unsigned long long)i, (unsigned long long)r.from,
+                   1u << r.halvings);
+    time += double(s.dt);
+    if (recorder)
+      recorder->record(table, i, time);
+    if (publisher && i % s.shm_every == 0) {
+      auto now = clock::now();
+      publisher->publish(
+          table, {i, time, table.size(), {},
+                  std::chrono::duration<double, std::milli>(now - t_step)
+                      .count(),
+                  std::chrono::duration<double>(now - t0).count(),
+                  ring.stats().rollbacks});
+    }
+    if (s.movie() && i % s.render_every == 0)
+      render(i);
+    if (s.map_movie() && i % s.map_every == 0)
+      map(i);
+    if (s.fof_every && i % s.fof_every == 0)
+      find_clusters(i, time);
+    if (i % s.report_every == 0) {
+      auto t2 = clock::now();
+      auto ms = std::chrono::duration<double, std::milli>(t2 - t1).count();
+      std::printf("step %llu: N = %zu, %.3f ms/step\n", (unsigned long long)i,
+                  table.size(), ms / double(s.report_every));
+      if (table.accreted)
+        std::printf("  merged so far: %llu\n",
+                    (unsigned long long)table.accreted);
+      if (auto &&c = std::exchange(table.measured, {}))
+        measure(*c);
+      if (s.accuracy)
+        measure_accuracy(i);
+      // (Not counting the measurements.)
+      t1 = clock::now();
+    }
+  }
+  auto const total = std::chrono::duration<double>(clock::now() - t0).count();
+  std::printf("total: %.3f s, %.3f ms/step\n", total,
+              1000.0 * total / double(std::max(s.steps, uint64_t(1))));
+  if (s.render && !s.movie())
+    render(s.steps);
+  if (s.map && !s.map_movie())
+    map(s.steps);
+  if (auto &&r = ring.stats(); r.rollbacks)
+    std::printf("rolled back %llu times\n", (unsigned long long)r.rollbacks);
+  if (images)
+    std::printf("rendered %llu images, %.3f ms each\n",
+                (unsigned long long)images, 1000.0 * render_seconds / images);
+  if (recorder) {
+    auto dropped = recorder->dropped();
+    recorder.reset();
+    std::printf("recorded to %s (%llu frames dropped)\n", s.record->c_str(),
+                (unsigned long long)dropped);
+  }
+  return 0;
+}
+
+} // namespace main_program
+
+int main() {
+  try {
+    // A rank started by another run (see distributed.h), which sends it what
+    // to run.
+    if (auto comm = distributed::spawned()) {
+      distributed::run(*comm, nullptr, {}, [](auto &&...) {});
+      return 0;
+    }
+    return main_program::run(main_program::Settings::from_env());
+  } catch (std::runtime_error const &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+}
@@ -0,0 +1,65 @@
+// Example consumer of the snapshots that a running simulation publishes in
+// shared memory (see demo/shm.h and README.md). Prints a line of statistics
+// per snapshot until the simulation ends.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "env.h"
+#include "shm.h"
+
+int main(int argc, char **argv) {
+  using namespace std::chrono_literals;
+  using clock = std::chrono::steady_clock;
+  auto const name = argc > 1 ? std::string{argv[1]}
+                             : env::get("GRASS_SHM").value_or("grass");
+  // Wait for the simulation to start (for up to a minute).
+  auto const open = [&name]() {
+    for (auto t0 = clock::now();; std::this_thread::sleep_for(100ms)) {
+      try {
+        return phy::shm::Reader{name};
+      } catch (std::runtime_error const &e) {
+        if (clock::now() - t0 > 60s)
+          throw;
+      }
+    }
+  };
+  try {
+    auto const reader = open();
+    phy::shm::Snapshot s;
+    uint64_t last{};
+    std::printf("%10s %10s %10s %10s %9s %12s %12s %9s %9s\n", "snapshot",
+                "step", "time", "N", "ms/step", "center x", "center y",
+                "kinetic", "rollbacks");
+    while (!reader.finished()) {
+      if (reader.latest() == last || !reader.read(s)) {
+        std::this_thread::sleep_for(10ms);
+        continue;
+      }
+      last = s.number;
+      // Center of mass and kinetic energy.
+      double m{}, x{}, y{}, k{};
+      for (auto &&r : s.particles) {
+        m += r.mass, x += r.mass * r.x, y += r.mass * r.y;
+        k += 0.5 * r.mass * (double(r.vx) * r.vx + double(r.vy) * r.vy);
+      }
+      if (m > 0.0)
+        x /= m, y /= m;
+      std::printf(
+          "%10llu %10llu %10.3f %10llu %9.3f %12.4g %12.4g %9.4g %9llu\n",
+          (unsigned long long)s.number, (unsigned long long)s.stats.step,
+          s.stats.time, (unsigned long long)s.stats.particles,
+          s.stats.step_ms, x, y, k, (unsigned long long)s.stats.rollbacks);
+      std::this_thread::sleep_for(100ms);
+    }
+    std::printf("the simulation ended\n");
+  } catch (std::runtime_error const &e) {
+    std::fprintf(stderr, "%s\n", e.what());
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,79 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <numbers>
+
+#include "Table.h"
+#include "initial.h"
+
+namespace {
+
+struct Totals {
+  double mass{}, area{};
+  std::complex<double> momentum, moment;
+};
+
+Totals totals(phy::Table<> const &t) {
+  Totals s;
+  for (auto &&p : t) {
+    s.mass += p.mass;
+    s.area += std::numbers::pi * p.radius * p.radius;
+    s.momentum += double(p.mass) * std::complex<double>{p.v};
+    s.moment += double(p.mass) * std::complex<double>{p.xy};
+  }
+  return s;
+}
+
+} // namespace
+
+TEST(Accretion, MergesDeepOverlaps) {
+  phy::Table<> t;
+  t.push_back({{0.0f, 0.0f}, {1.0f, 0.0f}, 1.0f, 1.0f});
+  t.push_back({{0.5f, 0.0f}, {0.0f, 2.0f}, 3.0f, 1.0f});
+  // Overlapping, but not deeply enough.
+  t.push_back({{10.0f, 0.0f}, {}, 1.0f, 1.0f});
+  t.push_back({{11.5f, 0.0f}, {}, 1.0f, 1.0f});
+  t.accretion = 0.5f;
+  auto const before = totals(t);
+  ASSERT_EQ(1u, t.accrete());
+  ASSERT_EQ(3u, t.size());
+  ASSERT_EQ(1u, t.accreted);
+  auto const &m = *std::ranges::find(t, 4.0f, &phy::Particle::mass);
+  ASSERT_FLOAT_EQ(0.375f, m.xy.real());
+  ASSERT_EQ(std::complex(0.25f, 1.5f), m.v);
+  ASSERT_FLOAT_EQ(std::sqrt(2.0f), m.radius);
+  auto const after = totals(t);
+  ASSERT_NEAR(before.area, after.area, 1e-5);
+  ASSERT_NEAR(0.0, std::abs(before.momentum - after.momentum), 1e-6);
+}
+
+TEST(Accretion, BoundsNAndConserves) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 10'000;
+  auto t = main_program::galaxies(c, 11);
+  for (auto &&p : t)
+    p.radius *= 4.0f;
+  auto const n = t.size();
+  auto const before = totals(t);
+  t.accretion = 0.5f;
+  t.index();
+  auto const merged = t.accrete();
+  ASSERT_GT(merged, 0u);
+  ASSERT_EQ(n - merged, t.size());
+  auto const after = totals(t);
+  ASSERT_NEAR(1.0, after.mass / before.mass, 1e-5);
+  ASSERT_NEAR(1.0, after.area / before.area, 1e-4);
+  ASSERT_NEAR(0.0, std::abs(before.momentum - after.momentum),
+              1e-5 * before.mass);
+  ASSERT_NEAR(0.0, std::abs(before.moment - after.moment), 1e-4 * before.mass);
+  // Stepping merges too, and leaves the tree in place.
+  t.step(1.0f / 90.0f);
+  ASSERT_TRUE(t.indexed());
+  ASSERT_TRUE(t.good());
+  // Off: nothing merges.
+  auto u = main_program::galaxies(c, 11);
+  u.step(1.0f / 90.0f);
+  ASSERT_EQ(n, u.size());
+}
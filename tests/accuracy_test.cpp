@@ -0,0 +1,69 @@
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <cstdio>
+#include <set>
+
+#include "Table.h"
+#include "accuracy.h"
+#include "initial.h"
+
+namespace {
+
+/// The errors of the tree forces of the table, over k particles.
+phy::accuracy::Report errors(phy::Table<> &t, size_t k) {
+  t.index();
+  auto const r = phy::accuracy::compare(
+      t.size(), k, 1, [&t](size_t i) { return t.acceleration(i); },
+      [&t](size_t i) { return t.direct(i); });
+  std::printf("relative errors over %zu particles: median %.3g, 99th "
+              "percentile %.3g, max %.3g\n",
+              r.samples, r.median, r.p99, r.max);
+  return r;
+}
+
+} // namespace
+
+TEST(Accuracy, Sample) {
+  auto const s = phy::accuracy::sample(1'000, 100, 3);
+  ASSERT_EQ(100u, s.size());
+  ASSERT_EQ(100u, std::set(s.begin(), s.end()).size());
+  ASSERT_LT(s.back(), 1'000u);
+  ASSERT_EQ(s, phy::accuracy::sample(1'000, 100, 3));
+  ASSERT_NE(s, phy::accuracy::sample(1'000, 100, 4));
+  ASSERT_EQ(5u, phy::accuracy::sample(5, 10, 3).size());
+}
+
+TEST(Accuracy, ExactWhenOpeningEverything) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 1'000;
+  auto t = main_program::galaxies(c, 2);
+  t.tan_angle_threshold = 0.0f;
+  auto const r = errors(t, 100);
+  ASSERT_EQ(100u, r.samples);
+  // (Summed in a different order.)
+  ASSERT_LT(r.max, 1e-4);
+}
+
+// Thresholds for the default opening angle (about twice what it measures).
+// Loosen them only on purpose.
+
+TEST(Accuracy, Galaxies) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 4'000;
+  auto t = main_program::galaxies(c, 3);
+  auto const r = errors(t, 400);
+  EXPECT_LT(r.median, 5e-4);
+  EXPECT_LT(r.p99, 5e-3);
+  EXPECT_LT(r.max, 1e-2);
+}
+
+TEST(Accuracy, Plummer) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 4'000;
+  auto t = main_program::plummer(c, 3);
+  auto const r = errors(t, 400);
+  EXPECT_LT(r.median, 2e-3);
+  EXPECT_LT(r.p99, 1e-2);
+  EXPECT_LT(r.max, 3e-2);
+}
@@ -0,0 +1,101 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Table.h"
+#include "checkpoint.h"
+#include "initial.h"
+
+namespace {
+
+std::string temporary(char const *name) {
+  return (std::filesystem::temp_directory_path() / name).string();
+}
+
+/// Overwrite the bytes at `offset` of a file.
+void patch(std::string const &path, std::streamoff offset,
+           std::vector<char> const &bytes) {
+  std::fstream f{path, std::ios::binary | std::ios::in | std::ios::out};
+  f.seekp(offset);
+  f.write(bytes.data(), std::streamsize(bytes.size()));
+}
+
+} // namespace
+
+TEST(Checkpoint, RoundTrip) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 2'000;
+  auto t = main_program::plummer(c, 3);
+  t.G = 0.75f, t.tan_angle_threshold = 0.3f;
+  // Too far away to have a Morton code.
+  t.push_back({{1e12f, -1e12f}, {1.0f, 2.0f}, 3.0f, 0.25f});
+  auto const path = temporary("grass_checkpoint_test.ckpt");
+  phy::checkpoint::save(t, path);
+  auto const u = phy::checkpoint::load(path);
+  std::filesystem::remove(path);
+
+  ASSERT_EQ(u.G, t.G);
+  ASSERT_EQ(u.tan_angle_threshold, t.tan_angle_threshold);
+  ASSERT_EQ(u.size(), t.size());
+  // In Morton order (the one without a code last), with their codes.
+  std::vector<phy::Particle> expected{t.begin(), t.end()};
+  std::ranges::stable_sort(expected, {}, [](auto &&p) {
+    return dyn::bh32::morton(p.xy).value_or(phy::checkpoint::NO_MORTON);
+  });
+  for (size_t i = 0; i < u.size(); i++) {
+    ASSERT_EQ(u[i].xy, expected[i].xy);
+    ASSERT_EQ(u[i].v, expected[i].v);
+    ASSERT_EQ(u[i].mass, expected[i].mass);
+    ASSERT_EQ(u[i].radius, expected[i].radius);
+    ASSERT_EQ(u[i].morton, dyn::bh32::morton(u[i].xy));
+  }
+  ASSERT_FALSE(u.back().morton.has_value());
+  ASSERT_EQ(u.back().xy, (std::complex<float>{1e12f, -1e12f}));
+}
+
+TEST(Checkpoint, Empty) {
+  auto const path = temporary("grass_checkpoint_empty.ckpt");
+  phy::checkpoint::save(phy::Table<>{}, path);
+  ASSERT_TRUE(phy::checkpoint::load(path).empty());
+  std::filesystem::remove(path);
+}
+
+TEST(Checkpoint, RejectsWhatIsNotOne) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 100;
+  auto const t = main_program::plummer(c, 1);
+  auto const path = temporary("grass_checkpoint_bad.ckpt");
+  auto const rejected = [&path](auto &&spoil) {
+    spoil();
+    try {
+      phy::checkpoint::Checkpoint{path};
+    } catch (std::runtime_error const &) {
+      return true;
+    }
+    return false;
+  };
+
+  phy::checkpoint::save(t, path);
+  ASSERT_TRUE(rejected([&] { patch(path, 0, {'X'}); })) << "magic";
+  phy::checkpoint::save(t, path);
+  ASSERT_TRUE(rejected([&] { patch(path, 8, {9, 9, 9, 9}); })) << "version";
+  phy::checkpoint::save(t, path);
+  ASSERT_TRUE(rejected([&] {
+    std::filesystem::resize_file(path, std::filesystem::file_size(path) - 64);
+  })) << "truncated";
+  phy::checkpoint::save(t, path);
+  ASSERT_TRUE(rejected([&] { std::filesystem::resize_file(path, 32); }))
+      << "shorter than a header";
+  // (And the untouched one is fine.)
+  phy::checkpoint::save(t, path);
+  ASSERT_FALSE(rejected([] {}));
+  std::filesystem::remove(path);
+}
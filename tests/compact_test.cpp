@@ -0,0 +1,143 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <vector>
+
+#include "Table.h"
+#include "compact.h"
+#include "initial.h"
+
+namespace {
+
+/// The largest distance from a particle of a to the nearest of b, and the
+/// largest difference of their velocities.
+std::pair<float, float> mismatch(phy::Table<> const &a, phy::Table<> &b) {
+  b.index();
+  float dx{}, dv{};
+  for (auto &&p : a) {
+    auto const i = b.nearest(p.xy, 1).front();
+    dx = std::max(dx, std::abs(b[i].xy - p.xy));
+    dv = std::max(dv, std::abs(b[i].v - p.v));
+  }
+  return {dx, dv};
+}
+
+double mass(phy::Table<> const &t) {
+  auto m = 0.0;
+  for (auto &&p : t)
+    m += p.mass;
+  return m;
+}
+
+} // namespace
+
+TEST(Compact, RoundTrip) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 50'000;
+  auto t = main_program::galaxies(c, 7);
+  phy::compact::Store const store{t};
+  auto decoded = store.table();
+  ASSERT_EQ(decoded.size(), t.size());
+  ASSERT_EQ(decoded.G, t.G);
+  // Less than half of the particles alone, let alone their tree.
+  std::printf("%.2f bytes per particle\n",
+              double(store.bytes()) / double(t.size()));
+  ASSERT_LT(store.bytes(), t.size() * sizeof(phy::Particle) / 2);
+  // The positions and velocities as precise as floats, nearly.
+  auto const [dx, dv] = mismatch(t, decoded);
+  ASSERT_LT(dx, 1e-4f);
+  ASSERT_LT(dv, 1e-3f);
+  // The masses and radii within a few percent, and the total mass kept.
+  ASSERT_NEAR(mass(decoded), mass(t), 1e-5 * mass(t));
+  std::vector<float> dm, dr;
+  for (auto &&p : t) {
+    auto &&q = decoded[decoded.nearest(p.xy, 1).front()];
+    dm.push_back(std::abs(q.mass / p.mass - 1.0f));
+    dr.push_back(std::abs(q.radius / p.radius - 1.0f));
+  }
+  auto const p99 = [](std::vector<float> &v) {
+    auto const k = v.begin() + ptrdiff_t(v.size() * 99 / 100);
+    std::nth_element(v.begin(), k, v.end());
+    return *k;
+  };
+  ASSERT_LT(p99(dm), 0.02f);
+  ASSERT_LT(p99(dr), 0.02f);
+}
+
+TEST(Compact, FewDistinctValuesAreExact) {
+  auto t = main_program::figure8();
+  phy::compact::Store const store{t};
+  auto decoded = store.table();
+  ASSERT_EQ(decoded.size(), 3u);
+  for (auto &&p : decoded) {
+    ASSERT_EQ(p.mass, 1.0f);
+    ASSERT_EQ(p.radius, 0.05f);
+  }
+  // (Within a step of the offsets and of the velocities.)
+  auto const [dx, dv] = mismatch(t, decoded);
+  ASSERT_LT(dx, 2.0f / 65535.0f);
+  ASSERT_LT(dv, 1.0f / 32767.0f);
+}
+
+TEST(Compact, AsAccurateAsTheTable) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 20'000;
+  auto t = main_program::plummer(c, 4);
+  // Compare with the particles as coded, whose masses and radii differ.
+  t = phy::compact::Store{t}.table();
+  auto exact = t;
+  exact.tan_angle_threshold = 0.0f;
+  phy::compact::Store store{t, {32, 1.0f, 2}};
+  auto quantum = 0.0f;
+  auto constexpr STEPS = 3;
+  auto const dt = 1.0f / 90.0f;
+  for (auto k = 0; k < STEPS; k++) {
+    auto const stats = store.step(dt);
+    ASSERT_TRUE(stats.good);
+    ASSERT_EQ(stats.particles, t.size());
+    quantum = std::max(quantum, stats.quantum);
+    store.refresh_disk();
+    t.step(dt), t.refresh_disk();
+    exact.step(dt), exact.refresh_disk();
+  }
+  auto out = store.table();
+  ASSERT_NEAR(mass(out), mass(exact), 1e-5 * mass(exact));
+  // Both approximate the forces (differently): compact, they are about as far
+  // from the exact ones as the table's.
+  auto const [dx, dv] = mismatch(out, exact);
+  auto const [table_dx, table_dv] = mismatch(t, exact);
+  std::printf("compact: %.3g, %.3g; table: %.3g, %.3g; quantum %.3g\n", dx,
+              dv, table_dx, table_dv, quantum);
+  // (Up to the rounding of the positions of the sparsest cells.)
+  ASSERT_LT(dx, 2.0f * table_dx + float(STEPS) * quantum);
+  // (The velocities of overlapping particles change by about as much as the
+  // table's error when their positions move by 1e-5 alone.)
+  ASSERT_LT(dv, 3.0f * table_dv);
+}
+
+TEST(Compact, PeakOfStepsAndSorts) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 50'000;
+  auto const t = main_program::galaxies(c, 7);
+  phy::compact::Store store{t, {32, 1.0f, 2}};
+  // (The third step sorts first.)
+  for (auto k = 0; k < 3; k++) {
+    auto const s = store.step(1.0f / 90.0f);
+    auto const n = double(t.size());
+    std::printf("step %d, bytes per particle: %.2f held, %.2f of tree, %.2f at "
+                "the most\n",
+                k, double(s.bytes) / n, double(s.tree) / n, double(s.peak) / n);
+    ASSERT_GT(s.peak, s.bytes + s.tree);
+    ASSERT_LT(s.peak, 3 * s.bytes);
+  }
+}
+
+TEST(Compact, Empty) {
+  phy::compact::Store store{phy::Table<>{}};
+  ASSERT_EQ(store.step(0.1f).particles, 0u);
+  store.sort();
+  ASSERT_TRUE(store.table().empty());
+}
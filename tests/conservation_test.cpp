@@ -0,0 +1,90 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <complex>
+#include <numbers>
+#include <utility>
+
+#include "Table.h"
+#include "initial.h"
+
+TEST(Conservation, TwoParticles) {
+  phy::Table<> t;
+  t.G = 2.0f;
+  t.push_back({{-1.0f, 0.0f}, {0.0f, 1.0f}, 1.0f, 0.1f});
+  t.push_back({{1.0f, 0.0f}, {0.0f, -0.5f}, 3.0f, 0.1f});
+  auto const c = t.conserved();
+  ASSERT_NEAR(0.875, c.kinetic, 1e-6);
+  ASSERT_NEAR(-3.0, c.potential, 1e-6);
+  ASSERT_NEAR(-2.125, c.energy(), 1e-6);
+  ASSERT_NEAR(0.0, std::abs(c.momentum - std::complex{0.0, -0.5}), 1e-6);
+  ASSERT_NEAR(-2.5, c.angular, 1e-6);
+}
+
+TEST(Conservation, Empty) {
+  phy::Table<> t;
+  auto const c = t.conserved();
+  ASSERT_EQ(0.0, c.energy());
+  ASSERT_EQ(0.0, std::abs(c.momentum));
+}
+
+TEST(Conservation, TreeNearSummingEveryPair) {
+  main_program::Constants constants;
+  constants.PARTICLES_LIMIT = 2'000;
+  auto t = main_program::galaxies(constants, 5);
+  auto const tree = t.conserved();
+  // Open every group: sum over every pair.
+  t.tan_angle_threshold = 0.0f;
+  t.forget_tree();
+  auto const direct = t.conserved();
+  ASSERT_EQ(direct.kinetic, tree.kinetic);
+  ASSERT_NEAR(1.0, tree.potential / direct.potential, 0.01);
+}
+
+TEST(Conservation, MeasuredByTheStepAtItsStart) {
+  main_program::Constants constants;
+  constants.PARTICLES_LIMIT = 2'000;
+  auto t = main_program::galaxies(constants, 5);
+  auto copy = t;
+  t.measure = true;
+  t.step(1.0f / 90.0f);
+  ASSERT_FALSE(t.measure);
+  ASSERT_TRUE(t.measured.has_value());
+  auto const m = *t.measured, c = copy.conserved();
+  ASSERT_EQ(c.kinetic, m.kinetic);
+  ASSERT_EQ(c.potential, m.potential);
+  ASSERT_EQ(c.momentum, m.momentum);
+  ASSERT_EQ(c.angular, m.angular);
+  // Only when asked.
+  t.measured.reset();
+  t.step(1.0f / 90.0f);
+  ASSERT_FALSE(t.measured.has_value());
+}
+
+namespace {
+
+/// The conserved quantities of two equal masses on a circular orbit about
+/// their center of mass, before and after about one period in steps of dt.
+auto orbit(float dt) {
+  phy::Table<> t;
+  t.push_back({{-1.0f, 0.0f}, {0.0f, -0.5f}, 1.0f, 0.01f});
+  t.push_back({{1.0f, 0.0f}, {0.0f, 0.5f}, 1.0f, 0.01f});
+  auto const before = t.conserved();
+  for (auto k = 0; float(k) * dt < 4.0f * std::numbers::pi_v<float>; k++)
+    t.step(dt);
+  return std::pair{before, t.conserved()};
+}
+
+} // namespace
+
+TEST(Conservation, CircularOrbit) {
+  auto const [before, after] = orbit(1.0f / 90.0f);
+  ASSERT_NEAR(-0.25, before.energy(), 1e-6);
+  ASSERT_NEAR(1.0, before.angular, 1e-6);
+  ASSERT_NEAR(0.0, std::abs(after.momentum), 1e-4);
+  // The energy drifts (as the others' positions are those at the start of a
+  // step), less so in smaller steps.
+  auto const drift = std::abs(after.energy() - before.energy());
+  auto const [b, a] = orbit(1.0f / 180.0f);
+  ASSERT_LT(std::abs(a.energy() - b.energy()), 0.75 * drift);
+}
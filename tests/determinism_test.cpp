@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "Table.h"
+#include "initial.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace {
+
+/// Use this many threads until destroyed.
+class Threads {
+#ifdef _OPENMP
+  int before{omp_get_max_threads()};
+
+public:
+  explicit Threads(int n) { omp_set_num_threads(n); }
+  ~Threads() { omp_set_num_threads(before); }
+#else
+public:
+  explicit Threads(int) {}
+#endif
+};
+
+/// Numbers of threads to compare: 1, 2, and more.
+std::vector<int> threads() {
+#ifdef _OPENMP
+  return {1, 2, std::max(omp_get_num_procs(), 4)};
+#else
+  return {1};
+#endif
+}
+
+/// Whether two floating-point values are the same bits.
+template <class T> bool same(T const &a, T const &b) {
+  return !std::memcmp(&a, &b, sizeof a);
+}
+
+/// Galaxies with particles large enough to overlap (and merge).
+phy::Table<> table() {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 3'000;
+  auto t = main_program::galaxies(c, 9);
+  for (auto &&p : t)
+    p.radius *= 2.0f;
+  t.accretion = 0.5f;
+  return t;
+}
+
+} // namespace
+
+TEST(Determinism, Trajectories) {
+  std::vector<phy::Table<>> runs;
+  for (auto n : threads()) {
+    Threads const use{n};
+    auto t = table();
+    for (auto k = 0; k < 30; k++)
+      t.step(1.0f / 90.0f), t.refresh_disk();
+    runs.push_back(std::move(t));
+  }
+  ASSERT_LT(runs[0].size(), 3'000u);
+  for (auto &&t : runs) {
+    ASSERT_EQ(runs[0].size(), t.size());
+    ASSERT_EQ(runs[0].accreted, t.accreted);
+    for (size_t i = 0; i < t.size(); i++) {
+      auto &&p = runs[0][i], &&q = t[i];
+      ASSERT_TRUE(same(p.xy, q.xy) && same(p.v, q.v) &&
+                  same(p.mass, q.mass) && same(p.radius, q.radius))
+          << "particle " << i;
+    }
+  }
+}
+
+TEST(Determinism, Measurements) {
+  std::vector<phy::Table<>::Conserved> conserved;
+  std::vector<std::vector<float>> maps;
+  std::vector<dyn::fof::Catalog> catalogs;
+  std::vector<std::vector<std::pair<size_t, size_t>>> overlaps;
+  for (auto n : threads()) {
+    Threads const use{n};
+    auto t = table();
+    t.step(1.0f / 90.0f);
+    conserved.push_back(t.conserved());
+    overlaps.push_back(t.overlaps());
+    catalogs.push_back(t.clusters(0.05f, 2));
+    maps.emplace_back();
+    t.map(phy::Table<>::Map::field, {-4.0f, -4.0f}, {4.0f, 4.0f}, 64, 64,
+          maps.back());
+  }
+  for (size_t k = 1; k < conserved.size(); k++) {
+    auto &&a = conserved[0], &&b = conserved[k];
+    ASSERT_TRUE(same(a.kinetic, b.kinetic) && same(a.potential, b.potential) &&
+                same(a.momentum, b.momentum) && same(a.angular, b.angular));
+    ASSERT_EQ(overlaps[0], overlaps[k]);
+    ASSERT_EQ(catalogs[0].label, catalogs[k].label);
+    ASSERT_EQ(catalogs[0].clusters.size(), catalogs[k].clusters.size());
+    for (size_t c = 0; c < catalogs[k].clusters.size(); c++)
+      ASSERT_TRUE(same(catalogs[0].clusters[c].xy, catalogs[k].clusters[c].xy));
+    ASSERT_EQ(maps[0], maps[k]);
+  }
+}
@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <exception>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "Table.h"
+#include "distributed.h"
+#include "initial.h"
+
+namespace {
+
+namespace d = phy::distributed;
+
+/// Run f(comm) for each of n ranks, as threads, and rethrow the first error.
+void ranks(int n, auto &&f) {
+  auto fds = d::mesh(n);
+  std::vector<std::exception_ptr> errors(static_cast<size_t>(n));
+  std::vector<std::thread> threads;
+  for (auto r = 0; r < n; r++)
+    threads.emplace_back([&, r] {
+      try {
+        d::Comm comm{r, fds[size_t(r)]};
+        f(comm);
+      } catch (...) {
+        errors[size_t(r)] = std::current_exception();
+      }
+    });
+  for (auto &&t : threads)
+    t.join();
+  for (auto &&e : errors)
+    if (e)
+      std::rethrow_exception(e);
+}
+
+/// The largest distance from a particle of a to the nearest of b, and the
+/// largest difference of their velocities.
+std::pair<float, float> mismatch(phy::Table<> const &a, phy::Table<> &b) {
+  b.index();
+  float dx{}, dv{};
+  for (auto &&p : a) {
+    auto const i = b.nearest(p.xy, 1).front();
+    dx = std::max(dx, std::abs(b[i].xy - p.xy));
+    dv = std::max(dv, std::abs(b[i].v - p.v));
+  }
+  return {dx, dv};
+}
+
+double mass(phy::Table<> const &t) {
+  auto m = 0.0;
+  for (auto &&p : t)
+    m += p.mass;
+  return m;
+}
+
+} // namespace
+
+TEST(Distributed, Exchange) {
+  // Large enough messages not to fit in the sockets' buffers at once.
+  ranks(3, [](d::Comm &comm) {
+    auto const n = size_t(comm.size());
+    std::vector<d::Message> out(n), in;
+    for (size_t j = 0; j < n; j++)
+      out[j].assign((j + 1) * 1'000'000, std::byte(comm.rank() * 10 + int(j)));
+    comm.exchange(out, in);
+    ASSERT_EQ(in.size(), n);
+    for (size_t j = 0; j < n; j++) {
+      ASSERT_EQ(in[j].size(), (size_t(comm.rank()) + 1) * 1'000'000);
+      ASSERT_EQ(in[j].front(), std::byte(int(j) * 10 + comm.rank()));
+      ASSERT_EQ(in[j].back(), in[j].front());
+    }
+  });
+}
+
+TEST(Distributed, AsAccurateAsTheTable) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 10'000;
+  auto t = main_program::galaxies(c, 5);
+  auto exact = t, table = t;
+  exact.tan_angle_threshold = 0.0f;
+  auto const dt = 1.0f / 90.0f;
+  auto constexpr STEPS = 4;
+  std::vector<d::Stats> last;
+  ranks(4, [&](d::Comm &comm) {
+    d::run(comm, comm.rank() ? nullptr : &t, {STEPS, dt, 2, STEPS},
+           [&last](auto, std::span<d::Stats const> s) {
+             last.assign(s.begin(), s.end());
+           });
+  });
+  for (auto k = 0; k < STEPS; k++) {
+    table.step(dt), table.refresh_disk();
+    exact.step(dt), exact.refresh_disk();
+  }
+  ASSERT_EQ(t.size(), exact.size());
+  ASSERT_NEAR(mass(t), mass(exact), 1e-3 * mass(exact));
+  // The ranks approximate the forces (differently): they are about as far
+  // from the exact ones as the table's.
+  auto const [dx, dv] = mismatch(t, exact);
+  auto const [table_dx, table_dv] = mismatch(table, exact);
+  std::printf("distributed: %.3g, %.3g; table: %.3g, %.3g\n", dx, dv,
+              table_dx, table_dv);
+  ASSERT_LT(dx, 2.0f * table_dx + 1e-6f);
+  ASSERT_LT(dv, 2.0f * table_dv + 1e-5f);
+
+  // Rebalanced: every rank has a share of the particles, and imports fewer
+  // than all the others'.
+  ASSERT_EQ(last.size(), 4u);
+  size_t own{};
+  for (auto &&s : last) {
+    ASSERT_GT(s.own, t.size() / 16);
+    ASSERT_LT(s.imported, t.size() - s.own);
+    own += s.own;
+  }
+  ASSERT_EQ(own, t.size());
+}
+
+TEST(Distributed, ExactWhenOpeningEverything) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 5'000;
+  auto t = main_program::galaxies(c, 3);
+  t.tan_angle_threshold = 0.0f;
+  auto exact = t;
+  ranks(3, [&](d::Comm &comm) {
+    d::run(comm, comm.rank() ? nullptr : &t, {2, 1.0f / 90.0f, 1, 0},
+           [](auto &&...) {});
+  });
+  for (auto k = 0; k < 2; k++)
+    exact.step(1.0f / 90.0f), exact.refresh_disk();
+  auto const [dx, dv] = mismatch(t, exact);
+  ASSERT_LT(dx, 1e-5f);
+  ASSERT_LT(dv, 1e-4f);
+}
+
+TEST(Distributed, OneRankIsTheTable) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 2'000;
+  auto t = main_program::plummer(c, 6);
+  auto table = t;
+  ranks(1, [&](d::Comm &comm) {
+    d::run(comm, &t, {3, 1.0f / 90.0f, 1, 0}, [](auto &&...) {});
+  });
+  for (auto k = 0; k < 3; k++)
+    table.step(1.0f / 90.0f), table.refresh_disk();
+  auto const [dx, dv] = mismatch(t, table);
+  ASSERT_LT(dx, 1e-6f);
+  ASSERT_LT(dv, 1e-5f);
+}
+
+TEST(Distributed, MoreRanksThanParticles) {
+  phy::Table<> t;
+  t.push_back({{0.0f, 0.0f}, {}, 1.0f, 0.1f});
+  t.push_back({{1.0f, 0.0f}, {}, 1.0f, 0.1f});
+  ranks(4, [&](d::Comm &comm) {
+    d::run(comm, comm.rank() ? nullptr : &t, {5, 1.0f / 90.0f, 2, 0},
+           [](auto &&...) {});
+  });
+  ASSERT_EQ(t.size(), 2u);
+  // They fall toward each other.
+  ASSERT_LT(std::abs(t[0].xy - t[1].xy), 1.0f);
+}
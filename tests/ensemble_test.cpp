@@ -0,0 +1,138 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ensemble.h"
+#include "initial.h"
+
+namespace {
+
+/// A figure-eight member, its velocities scaled by 1 + jitter.
+phy::ensemble::Member figure8(float jitter, float dt, uint64_t steps) {
+  phy::ensemble::Member m;
+  m.label = "figure8", m.table = main_program::figure8();
+  m.dt = dt, m.steps = steps;
+  for (auto &&p : m.table)
+    p.v *= 1.0f + jitter;
+  return m;
+}
+
+std::vector<phy::ensemble::Member> sweep() {
+  std::vector<phy::ensemble::Member> members;
+  for (auto k = 0; k < 10; k++)
+    members.push_back(figure8(0.001f * float(k), 0.01f, 90));
+  return members;
+}
+
+} // namespace
+
+TEST(Ensemble, BatchedAsAlone) {
+  auto batched = sweep(), alone = sweep();
+  auto const b = phy::ensemble::run(batched);
+  ASSERT_EQ(10, b.batched);
+  ASSERT_EQ(2, b.batches);
+  ASSERT_EQ(0, b.alone);
+  auto const a = phy::ensemble::run(alone, {0});
+  ASSERT_EQ(10, a.alone);
+  ASSERT_EQ(b.particle_steps, a.particle_steps);
+  for (size_t k = 0; k < batched.size(); k++) {
+    ASSERT_EQ(90, batched[k].taken);
+    ASSERT_EQ(0, batched[k].failed);
+    for (size_t i = 0; i < batched[k].table.size(); i++) {
+      ASSERT_NEAR(0.0f,
+                  std::abs(batched[k].table[i].xy - alone[k].table[i].xy),
+                  1e-3f);
+      ASSERT_NEAR(0.0f, std::abs(batched[k].table[i].v - alone[k].table[i].v),
+                  1e-3f);
+    }
+    ASSERT_NEAR(batched[k].before.energy(), alone[k].before.energy(), 1e-9);
+    ASSERT_NEAR(batched[k].after.energy(), alone[k].after.energy(), 1e-3);
+  }
+}
+
+TEST(Ensemble, LanesOfTheirOwn) {
+  std::vector<phy::ensemble::Member> members;
+  for (auto k = 0; k < 5; k++) {
+    members.push_back(figure8(0.0f, 0.005f * float(k + 1), 10u * (k + 1)));
+    members.back().table.G = 1.0f + 0.25f * float(k);
+  }
+  // Alone, for comparison.
+  auto alone = members;
+  phy::ensemble::run(members);
+  phy::ensemble::run(alone, {0});
+  for (size_t k = 0; k < members.size(); k++) {
+    ASSERT_EQ(10u * (k + 1), members[k].taken);
+    for (size_t i = 0; i < members[k].table.size(); i++)
+      ASSERT_NEAR(0.0f,
+                  std::abs(members[k].table[i].xy - alone[k].table[i].xy),
+                  1e-3f);
+  }
+}
+
+TEST(Ensemble, WrongMemberStops) {
+  auto members = sweep();
+  members[3].table[0].v = {std::numeric_limits<float>::quiet_NaN(), 0.0f};
+  auto alone = sweep();
+  phy::ensemble::run(members);
+  phy::ensemble::run(alone, {0});
+  ASSERT_EQ(1, members[3].failed);
+  ASSERT_EQ(1, members[3].taken);
+  for (size_t k = 0; k < members.size(); k++) {
+    if (k == 3)
+      continue;
+    ASSERT_EQ(0, members[k].failed);
+    ASSERT_NEAR(0.0f, std::abs(members[k].table[1].xy - alone[k].table[1].xy),
+                1e-3f);
+  }
+}
+
+TEST(Ensemble, LoadAndWrite) {
+  auto const dir = std::filesystem::temp_directory_path();
+  auto const plan = (dir / "grass_ensemble_plan.csv").string();
+  auto const out = (dir / "grass_ensemble_out.csv").string();
+  {
+    auto *f = std::fopen(plan.c_str(), "w");
+    ASSERT_NE(nullptr, f);
+    std::fputs("initial,n,seed,G,dt,steps,jitter\n"
+               "figure8,,1,2.0,0.02,5,0.01\n"
+               "# a comment\n"
+               "\n"
+               "plummer,100,7,,,3,\n",
+               f);
+    std::fclose(f);
+  }
+  auto members = phy::ensemble::load(plan);
+  ASSERT_EQ(2, members.size());
+  ASSERT_EQ("figure8", members[0].label);
+  ASSERT_EQ(3, members[0].table.size());
+  ASSERT_EQ(2.0f, members[0].table.G);
+  ASSERT_EQ(0.02f, members[0].dt);
+  ASSERT_EQ(5, members[0].steps);
+  ASSERT_NE(main_program::figure8()[0].v, members[0].table[0].v);
+  ASSERT_EQ("plummer", members[1].label);
+  ASSERT_EQ(100, members[1].table.size());
+  ASSERT_EQ(3, members[1].steps);
+
+  phy::ensemble::run(members);
+  phy::ensemble::write(members, out);
+  auto *f = std::fopen(out.c_str(), "r");
+  ASSERT_NE(nullptr, f);
+  auto lines = 0;
+  for (int c; (c = std::fgetc(f)) != EOF;)
+    lines += c == '\n';
+  std::fclose(f);
+  ASSERT_EQ(3, lines);
+  std::filesystem::remove(plan);
+  std::filesystem::remove(out);
+
+  auto *bad = std::fopen(plan.c_str(), "w");
+  std::fputs("initial,n\nplummer,many\n", bad);
+  std::fclose(bad);
+  ASSERT_THROW(phy::ensemble::load(plan), std::runtime_error);
+  std::filesystem::remove(plan);
+}
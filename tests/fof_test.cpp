@@ -0,0 +1,86 @@
+#include "gtest/gtest.h"
+
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include <fof.h>
+
+#include "Table.h"
+#include "initial.h"
+
+namespace {
+
+/// The least index of the cluster of each particle, testing every pair.
+std::vector<size_t> brute_force(phy::Table<> const &t, float linking) {
+  std::vector<size_t> root(t.size());
+  std::iota(root.begin(), root.end(), size_t{});
+  auto const find = [&root](size_t i) {
+    while (root[i] != i)
+      i = root[i];
+    return i;
+  };
+  for (size_t i = 0; i < t.size(); i++)
+    for (size_t j = i + 1; j < t.size(); j++)
+      if (std::norm(t[i].xy - t[j].xy) <= linking * linking) {
+        auto a = find(i), b = find(j);
+        if (a != b)
+          root[std::max(a, b)] = std::min(a, b);
+      }
+  for (size_t i = 0; i < t.size(); i++)
+    root[i] = find(i);
+  return root;
+}
+
+} // namespace
+
+TEST(Fof, SameAsTestingEveryPair) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 15'000;
+  auto table = main_program::galaxies(c, 5);
+  table.step(1.0f / 90.0f);
+  for (auto linking : {0.01f, 0.05f, 0.2f}) {
+    auto const expected = brute_force(table, linking);
+    auto const catalog = table.clusters(linking);
+    ASSERT_TRUE(table.indexed());
+    ASSERT_EQ(table.size(), catalog.label.size());
+    for (size_t i = 0; i < table.size(); i++) {
+      auto &&cluster = catalog.clusters.at(catalog.label[i]);
+      ASSERT_EQ(expected[i], cluster.first) << "(i = " << i << ")";
+    }
+    // Members and masses add up.
+    size_t members{};
+    double mass{}, total{};
+    for (auto &&cluster : catalog.clusters)
+      members += cluster.members, mass += cluster.mass;
+    for (auto &&p : table)
+      total += p.mass;
+    ASSERT_EQ(table.size(), members);
+    ASSERT_NEAR(1.0, mass / total, 1e-5);
+  }
+}
+
+TEST(Fof, SmallClustersLeftOut) {
+  phy::Table<> t;
+  for (auto i = 0; i < 5; i++)
+    t.push_back({{0.1f * float(i), 0.0f}, {}, 2.0f, 0.01f});
+  t.push_back({{10.0f, 0.0f}, {}, 1.0f, 0.01f});
+  t.push_back({{10.1f, 0.0f}, {}, 1.0f, 0.01f});
+  t.push_back({{-10.0f, 0.0f}, {}, 1.0f, 0.01f});
+  auto const catalog = t.clusters(0.15f, 2);
+  ASSERT_EQ(2u, catalog.clusters.size());
+  auto const &a = catalog.clusters[0], &b = catalog.clusters[1];
+  auto const &big = a.members == 5 ? a : b, &pair = a.members == 5 ? b : a;
+  ASSERT_EQ(5u, big.members);
+  ASSERT_FLOAT_EQ(10.0f, big.mass);
+  ASSERT_NEAR(0.2f, big.xy.real(), 1e-6f);
+  ASSERT_NEAR(0.2f, big.radius, 1e-6f);
+  ASSERT_EQ(2u, pair.members);
+  ASSERT_NEAR(10.05f, pair.xy.real(), 1e-5f);
+  auto lone = 0;
+  for (auto l : catalog.label)
+    lone += l == dyn::fof::Catalog::NONE;
+  ASSERT_EQ(1, lone);
+}
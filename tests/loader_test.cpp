@@ -0,0 +1,119 @@
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Table.h"
+#include "loader.h"
+
+namespace {
+
+/// Write `contents` to a temporary file of the given name.
+std::string file(char const *name, std::string const &contents) {
+  auto const path = (std::filesystem::temp_directory_path() / name).string();
+  std::ofstream{path, std::ios::binary | std::ios::trunc} << contents;
+  return path;
+}
+
+/// The table of one particle, to see that a failed load leaves it alone.
+phy::Table<> one() {
+  phy::Table<> t;
+  t.push_back({{9.0f, 9.0f}, {}, 1.0f, 1.0f});
+  return t;
+}
+
+} // namespace
+
+TEST(Loader, Csv) {
+  // A header, a comment, a blank line, CRLF, and no final newline.
+  auto const path = file("grass_loader.csv", "x,y,vx,vy,mass,radius\r\n"
+                                             "# a comment\r\n"
+                                             "1, 2, 3, 4\r\n"
+                                             "\r\n"
+                                             "-1.5,0.5,0,0,2,0.25");
+  auto t = one();
+  phy::loader::load(path, t);
+  std::filesystem::remove(path);
+  ASSERT_EQ(t.size(), 3u);
+  ASSERT_EQ(t[1].xy, (std::complex<float>{1.0f, 2.0f}));
+  ASSERT_EQ(t[1].v, (std::complex<float>{3.0f, 4.0f}));
+  ASSERT_EQ(t[1].mass, 1.0f);
+  ASSERT_EQ(t[1].radius, 1.0f);
+  ASSERT_EQ(t[2].xy, (std::complex<float>{-1.5f, 0.5f}));
+  ASSERT_EQ(t[2].mass, 2.0f);
+  ASSERT_EQ(t[2].radius, 0.25f);
+  ASSERT_EQ(t[2].morton, dyn::bh32::morton(t[2].xy));
+}
+
+TEST(Loader, CsvErrorsHaveTheirLine) {
+  struct Case {
+    char const *text;
+    size_t line;
+    char const *message;
+  };
+  for (auto &&[text, line, message] :
+       std::vector<Case>{{"x,y,vx,vy\n1,2,3,4\n1,abc,3,4\n", 3,
+                          ":3: not a number: 'abc'"},
+                         {"1,2,3,4\r\n\r\n1,2,3\r\n", 3,
+                          ":3: expected at least 4 numbers"},
+                         {"1,2,3,4,-1\n", 1, ":1: the mass and the radius"},
+                         {"1,2,3,4,1,1,1", 1, ":1: more than 6 numbers"},
+                         {"1,2,3,4\n1 2,3,4\n", 2, ":2: expected a comma"}}) {
+    auto const path = file("grass_loader_bad.csv", text);
+    auto t = one();
+    try {
+      phy::loader::load(path, t);
+      FAIL() << "loaded " << text;
+    } catch (phy::loader::Error const &e) {
+      ASSERT_EQ(e.line, line) << text;
+      ASSERT_NE(std::string{e.what()}.find(path + message), std::string::npos)
+          << e.what();
+    }
+    // As it was.
+    ASSERT_EQ(t.size(), 1u);
+    ASSERT_EQ(t[0].xy, (std::complex<float>{9.0f, 9.0f}));
+    std::filesystem::remove(path);
+  }
+}
+
+TEST(Loader, Binary) {
+  std::vector<float> const f{1, 2, 3, 4, 5, 6, -1, -2, 0, 0, 1, 0.5f};
+  std::string bytes(reinterpret_cast<char const *>(f.data()),
+                    f.size() * sizeof(float));
+  auto const path = file("grass_loader.bin", bytes);
+  auto t = one();
+  phy::loader::load(path, t);
+  ASSERT_EQ(t.size(), 3u);
+  ASSERT_EQ(t[1].v, (std::complex<float>{3.0f, 4.0f}));
+  ASSERT_EQ(t[1].radius, 6.0f);
+  ASSERT_EQ(t[2].xy, (std::complex<float>{-1.0f, -2.0f}));
+
+  // Not a whole number of records.
+  file("grass_loader.bin", bytes + "abc");
+  t = one();
+  ASSERT_THROW(phy::loader::load(path, t), phy::loader::Error);
+  ASSERT_EQ(t.size(), 1u);
+
+  // A record with a non-positive radius (the second).
+  auto spoiled = f;
+  spoiled[11] = 0.0f;
+  file("grass_loader.bin",
+       {reinterpret_cast<char const *>(spoiled.data()),
+        spoiled.size() * sizeof(float)});
+  try {
+    phy::loader::load(path, t);
+    FAIL();
+  } catch (phy::loader::Error const &e) {
+    ASSERT_EQ(e.line, 2u);
+  }
+  ASSERT_EQ(t.size(), 1u);
+  std::filesystem::remove(path);
+}
+
+TEST(Loader, UnknownFormat) {
+  auto t = one();
+  ASSERT_THROW(phy::loader::load("particles.dat", t), std::runtime_error);
+}
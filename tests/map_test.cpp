@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include <newton.h>
+
+#include "Table.h"
+#include "initial.h"
+
+namespace {
+
+using Map = phy::Table<>::Map;
+
+/// The potential or the field at xy, summing over every particle.
+float exact(phy::Table<> const &t, Map what, std::complex<float> xy) {
+  double phi{};
+  std::complex<double> a;
+  dyn::Gravity<> g;
+  for (auto &&p : t) {
+    phi += g.potential(xy, p.circle(), p.mass);
+    a += std::complex<double>{g.field({xy, 0.0f}, p.circle(), p.mass)};
+  }
+  return float(t.G * (what == Map::potential ? phi : std::abs(a)));
+}
+
+} // namespace
+
+TEST(Map, NearSummingEveryParticle) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 10'000;
+  auto table = main_program::galaxies(c, 3);
+  // The map is of the particles where they were at the start of the latest
+  // step, in a step long enough for them to have moved well off since.
+  auto const before = table;
+  table.step(0.5f);
+  auto const after = table;
+  std::complex<float> const ll{-12.0f, -8.0f}, gg{12.0f, 8.0f};
+  auto constexpr W = 37, H = 21;
+  std::vector<float> out;
+  for (auto what : {Map::potential, Map::field}) {
+    table.map(what, ll, gg, W, H, out);
+    ASSERT_EQ(size_t(W * H), out.size());
+    auto worst = 0.0f;
+    for (auto y = 0; y < H; y += 4)
+      for (auto x = 0; x < W; x += 3) {
+        auto const xy =
+            ll + std::complex{(float(x) + 0.5f) * (gg.real() - ll.real()) / W,
+                              (float(y) + 0.5f) * (gg.imag() - ll.imag()) / H};
+        auto const e = exact(before, what, xy);
+        worst = std::max(worst, std::abs(out[y * W + x] - e) / std::abs(e));
+      }
+    ASSERT_LT(worst, 0.02f) << "(map " << int(what) << ")";
+  }
+  // Neither reordered nor moved.
+  ASSERT_TRUE(std::ranges::equal(after, table, {}, &phy::Particle::xy,
+                                 &phy::Particle::xy));
+}
+
+TEST(Map, Empty) {
+  phy::Table<> t;
+  std::vector<float> out{1.0f};
+  t.map(Map::potential, {-1.0f, -1.0f}, {1.0f, 1.0f}, 4, 3, out);
+  ASSERT_EQ(std::vector<float>(12), out);
+}
@@ -15,6 +15,18 @@ TEST(MortonDetail, Interleave0) {
                   << "\nhex (g) = 0x" << std::setw(16) << g;
 }
 
+TEST(MortonDetail, Deinterleave0) {
+  for (auto [a, b] : {std::array<uint32_t, 2>{0xffffffff, 0x00000000},
+                      {0x00000000, 0xffffffff},
+                      {0x12345678, 0x9abcdef0},
+                      {0x80000001, 0x7ffffffe}}) {
+    auto w = dyn::bh32::detail::interleave32(a, b);
+    auto g = dyn::bh32::detail::deinterleave32(w);
+    ASSERT_EQ(a, g[0]) << "w = 0x" << std::hex << w;
+    ASSERT_EQ(b, g[1]) << "w = 0x" << std::hex << w;
+  }
+}
+
 TEST(Morton, Fixed512_0) {
   auto X = 4194304; // INT32_MAX / 512
   std::complex<float> a{float(X), float(X)};
@@ -49,4 +61,16 @@ TEST(Morton, Fixed512_3) {
   ASSERT_EQ(z_expect, z_out);
 }
 
+TEST(Morton, Inverse512_0) {
+  typedef std::complex<float> C;
+  for (auto c : {C{-12.3f, 4.5f}, C{0.001f, -0.001f}, C{1000.0f, -2000.0f}}) {
+    auto z = dyn::bh32::morton<512>(c);
+    ASSERT_TRUE(z.has_value());
+    auto [x, y] = dyn::bh32::unmorton(z.value());
+    // Grid coordinates are truncated toward zero.
+    ASSERT_EQ(int32_t(c.real() * 512.0f), x);
+    ASSERT_EQ(int32_t(c.imag() * 512.0f), y);
+  }
+}
+
 // Notes: Order of NaN and infinite values are unspecified.
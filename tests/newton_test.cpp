@@ -138,3 +138,24 @@ TEST_F(NewtonSuite, Figure8) {
   for (int i = 0; i < 3; i++)
     ASSERT_NEAR(0.0f, qs[i], 0.1f) << "(i = " << i << ")";
 }
+
+TEST_F(NewtonSuite, PotentialGradientIsField) {
+  // At points outside and inside the circle c1, minus the gradient of the
+  // potential is the field on a test particle of radius 0.
+  dyn::Gravity<double, 30> g;
+  dyn::Circle<double> const c1{{0.3, -0.2}, 0.5};
+  auto constexpr H = 1e-6;
+  for (auto xy : {std::complex{2.0, 1.0}, std::complex{0.4, 0.0},
+                  std::complex{-1.0, -0.7}}) {
+    auto const dx = g.potential(xy + H, c1, 2.0) - g.potential(xy - H, c1, 2.0);
+    auto const dy = g.potential(xy + H * 1i, c1, 2.0) -
+                    g.potential(xy - H * 1i, c1, 2.0);
+    auto const f = g.field({xy, 0.0}, c1, 2.0);
+    ASSERT_NEAR(f.real(), -dx / (2 * H), 1e-6) << "(at " << xy << ")";
+    ASSERT_NEAR(f.imag(), -dy / (2 * H), 1e-6) << "(at " << xy << ")";
+  }
+  // Continuous across the edge.
+  auto const edge = std::complex{0.8, -0.2};
+  ASSERT_NEAR(g.potential(edge * (1.0 - H), c1, 2.0),
+              g.potential(edge * (1.0 + H), c1, 2.0), 1e-5);
+}
@@ -0,0 +1,97 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "Table.h"
+#include "initial.h"
+#include "numa.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+TEST(Numa, ParseLists) {
+  ASSERT_EQ(phy::numa::parse("0-3,8,10-11\n"),
+            (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+  ASSERT_EQ(phy::numa::parse("5"), std::vector<int>{5});
+  ASSERT_TRUE(phy::numa::parse("").empty());
+  for (auto bad : {"3-1", "a", "1,", "1-", "-1", "1;2"})
+    ASSERT_THROW(phy::numa::parse(bad), std::invalid_argument) << bad;
+}
+
+TEST(Numa, AutoIsEveryAllowedCpu) {
+  auto const nodes = phy::numa::nodes();
+  ASSERT_FALSE(nodes.empty());
+  auto cpus = phy::numa::cpus("auto");
+  ASSERT_FALSE(cpus.empty());
+  // Each once.
+  std::ranges::sort(cpus);
+  ASSERT_EQ(std::ranges::adjacent_find(cpus), cpus.end());
+}
+
+TEST(Numa, PlaceKeepsTheData) {
+  std::vector<phy::Particle> v(100'000);
+  for (size_t i = 0; i < v.size(); i++)
+    v[i] = {{float(i), -float(i)}, {1.0f, float(i)}, 2.0f, 0.5f};
+  auto const before = v;
+  auto const placed = phy::numa::place(std::span{v});
+  for (size_t i = 0; i < v.size(); i++) {
+    ASSERT_EQ(before[i].xy, v[i].xy);
+    ASSERT_EQ(before[i].v, v[i].v);
+  }
+#ifdef GRASS_NUMA
+  ASSERT_TRUE(placed);
+  // Every page somewhere, if the system tells.
+  if (auto const pages = phy::numa::census(std::span<phy::Particle const>{v});
+      !pages.empty()) {
+    auto const page = size_t(sysconf(_SC_PAGESIZE));
+    ASSERT_GE(std::accumulate(pages.begin(), pages.end(), size_t{}) * page,
+              v.size() * sizeof(phy::Particle));
+  }
+#else
+  ASSERT_FALSE(placed);
+#endif
+}
+
+#ifdef GRASS_NUMA
+TEST(Numa, PinnedThreadsRunOnTheirCpus) {
+  cpu_set_t all;
+  ASSERT_EQ(sched_getaffinity(0, sizeof all, &all), 0);
+  auto const cpus = phy::numa::cpus("auto");
+  auto const pinned = phy::numa::pin(cpus);
+  ASSERT_GT(pinned, 0u);
+  std::vector<int> wrong(pinned);
+#pragma omp parallel
+  {
+#ifdef _OPENMP
+    auto const t = size_t(omp_get_thread_num());
+#else
+    auto const t = size_t{};
+#endif
+    wrong[t] = sched_getcpu() != cpus[t % cpus.size()];
+    // (Unpinned again, for the other tests.)
+    sched_setaffinity(0, sizeof all, &all);
+  }
+  ASSERT_EQ(std::ranges::count(wrong, 1), 0);
+}
+#endif
+
+TEST(Numa, TableSameWhenPlaced) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 10'000;
+  auto a = main_program::galaxies(c, 5);
+  auto b = a;
+  b.first_touch = true;
+  for (auto k = 0; k < 3; k++)
+    a.step(1.0f / 90.0f), b.step(1.0f / 90.0f);
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); i++) {
+    ASSERT_EQ(a[i].xy, b[i].xy);
+    ASSERT_EQ(a[i].v, b[i].v);
+  }
+}
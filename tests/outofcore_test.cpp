@@ -0,0 +1,104 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+#include "Table.h"
+#include "checkpoint.h"
+#include "initial.h"
+#include "outofcore.h"
+
+namespace {
+
+/// Step a copy of the table out of core, through a checkpoint.
+phy::Table<> stepped(phy::Table<> const &t, int steps, float dt,
+                     phy::outofcore::Options const &o,
+                     phy::outofcore::Stats *stats = nullptr) {
+  auto const path =
+      (std::filesystem::temp_directory_path() / "grass_outofcore.ckpt")
+          .string();
+  phy::checkpoint::save(t, path);
+  phy::outofcore::Stepper stepper{path, o};
+  for (auto k = 0; k < steps; k++) {
+    auto const s = stepper.step(dt);
+    if (stats)
+      *stats = s;
+  }
+  auto result = phy::checkpoint::load(path);
+  std::filesystem::remove(path);
+  return result;
+}
+
+/// The largest distance from a particle of a to the nearest of b, and the
+/// largest difference of their velocities.
+std::pair<float, float> mismatch(phy::Table<> const &a, phy::Table<> &b) {
+  b.index();
+  float dx{}, dv{};
+  for (auto &&p : a) {
+    auto const i = b.nearest(p.xy, 1).front();
+    dx = std::max(dx, std::abs(b[i].xy - p.xy));
+    dv = std::max(dv, std::abs(b[i].v - p.v));
+  }
+  return {dx, dv};
+}
+
+} // namespace
+
+TEST(OutOfCore, ExactWhenOpeningEverything) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 5'000;
+  auto t = main_program::galaxies(c, 3);
+  t.tan_angle_threshold = 0.0f;
+  auto const out = stepped(t, 2, 1.0f / 90.0f, {128, 8, 2});
+  ASSERT_EQ(t.size(), out.size());
+  for (auto k = 0; k < 2; k++)
+    t.step(1.0f / 90.0f);
+  auto const [dx, dv] = mismatch(out, t);
+  ASSERT_LT(dx, 1e-5f);
+  ASSERT_LT(dv, 1e-4f);
+}
+
+TEST(OutOfCore, AsAccurateAsTheTable) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 10'000;
+  auto t = main_program::plummer(c, 4);
+  auto exact = t;
+  exact.tan_angle_threshold = 0.0f;
+  phy::outofcore::Stats stats;
+  auto const out = stepped(t, 3, 1.0f / 90.0f, {256, 16, 2}, &stats);
+  ASSERT_EQ(t.size(), out.size());
+  for (auto k = 0; k < 3; k++)
+    t.step(1.0f / 90.0f), exact.step(1.0f / 90.0f);
+  // Both approximate the forces (differently): out of core, they are about as
+  // far from the exact ones as the table's.
+  auto const [dx, dv] = mismatch(out, exact);
+  auto const [table_dx, table_dv] = mismatch(t, exact);
+  std::printf("out of core: %.3g, %.3g; table: %.3g, %.3g\n", dx, dv,
+              table_dx, table_dv);
+  ASSERT_LT(dx, 2.0f * table_dx);
+  ASSERT_LT(dv, 2.0f * table_dv);
+
+  ASSERT_TRUE(stats.good);
+  ASSERT_EQ(t.size(), stats.particles);
+  ASSERT_EQ((t.size() + 255) / 256, stats.blocks);
+  ASSERT_GE(stats.cells, t.size() / 16);
+  ASSERT_GT(stats.opened, 0.0);
+  // Written in Morton order within each block.
+  for (size_t b = 0; b < out.size(); b += 256)
+    ASSERT_TRUE(std::ranges::is_sorted(
+        out.begin() + ptrdiff_t(b),
+        out.begin() + ptrdiff_t(std::min(b + 256, out.size())), {},
+        [](auto &&p) { return p.morton; }));
+}
+
+TEST(OutOfCore, Empty) {
+  phy::Table<> t;
+  phy::outofcore::Stats stats;
+  auto const out = stepped(t, 1, 0.01f, {}, &stats);
+  ASSERT_TRUE(out.empty());
+  ASSERT_EQ(0u, stats.blocks);
+}
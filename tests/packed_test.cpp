@@ -0,0 +1,174 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <optional>
+#include <vector>
+
+#include <packed.h>
+
+#include "Table.h"
+#include "initial.h"
+
+namespace {
+
+struct Body {
+  std::complex<float> xy;
+  float radius{}, mass{};
+  std::optional<uint64_t> morton;
+};
+using I = std::vector<Body>::iterator;
+
+/// The least a group needs to be packed (see `phy::Table`).
+struct Moments {
+  std::complex<float> xy;
+  float radius{}, mass{};
+  I first, last;
+  bool many{};
+  Moments() = default;
+  Moments(I first, I last) : first{first}, last{last} {
+    std::complex<double> xyd;
+    for (auto i = first; i != last; ++i)
+      mass += i->mass, xyd += double(i->mass) * std::complex<double>{i->xy};
+    xy = std::complex<float>{xyd / double(mass)};
+    for (auto i = first; i != last; ++i)
+      radius = std::max(radius, i->radius + std::abs(i->xy - xy));
+    many = last - first > 1;
+  }
+  Moments &operator+=(Moments const &m) {
+    auto const sum = mass + m.mass;
+    xy = mass / sum * xy + m.mass / sum * m.xy;
+    mass = sum, last = m.last, many = true;
+    radius = 0.0f;
+    for (auto i = first; i != last; ++i)
+      radius = std::max(radius, i->radius + std::abs(i->xy - xy));
+    return *this;
+  }
+  [[nodiscard]] dyn::Circle<float> circle() const { return {xy, radius}; }
+};
+
+std::vector<Body> bodies(size_t n) {
+  std::vector<Body> v;
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 5 * n;
+  for (auto &&p : main_program::galaxies(c, 7))
+    v.push_back({p.xy, p.radius, p.mass, dyn::bh32::morton(p.xy)});
+  std::ranges::sort(v, {}, &Body::morton);
+  return v;
+}
+
+auto tree(std::vector<Body> &v) {
+  return dyn::bh32::tree<Moments>(
+      v.begin(), v.end(),
+      [](Body const &b, uint64_t m) -> std::optional<uint64_t> {
+        return b.morton ? std::optional{*b.morton & m} : std::nullopt;
+      });
+}
+
+} // namespace
+
+TEST(Packed, SameWalkAsTheTree) {
+  auto v = bodies(3'000);
+  auto const t = tree(v);
+  dyn::bh32::Packed const packed{t, v.begin()};
+  ASSERT_TRUE(packed);
+  // Opening everything, in the same order.
+  std::vector<Moments const *> groups;
+  t->depth_first([&](Moments const &m) { return groups.push_back(&m), true; });
+  std::vector<dyn::bh32::View> views;
+  packed.depth_first([&](auto &&view) { return views.push_back(view), true; });
+  ASSERT_EQ(groups.size(), views.size());
+  ASSERT_EQ(packed.size(), views.size());
+  auto worst = 0.0f;
+  for (size_t k = 0; k < views.size(); k++) {
+    auto &&m = *groups[k];
+    auto &&view = views[k];
+    ASSERT_EQ(m.many, view.many);
+    ASSERT_EQ(m.mass, view.mass);
+    if (!m.many) {
+      // Particles as they are, and found from their index.
+      ASSERT_EQ(m.circle(), view.circle);
+      ASSERT_EQ(packed.leaf(size_t(m.first - v.begin())), view.node);
+      continue;
+    }
+    // Groups still holding their particles, a little off-center.
+    auto const off = std::abs(view.circle - m.xy);
+    ASSERT_GE(view.circle.radius, m.radius + off);
+    worst = std::max(worst, off / m.radius);
+    ASSERT_LT(view.circle.radius, m.radius * 1.001f);
+  }
+  std::printf("centers off by up to %.3g of the radii\n", worst);
+  ASSERT_LT(worst, 1e-3f);
+}
+
+TEST(Packed, SixteenBytesANode) {
+  auto v = bodies(5'000);
+  dyn::bh32::Packed const packed{tree(v), v.begin()};
+  ASSERT_GE(packed.size(), v.size());
+  // (With a sixteenth to grow into.)
+  auto const least = packed.size() * 16 + v.size() * sizeof(uint32_t);
+  ASSERT_GE(packed.bytes(), least);
+  ASSERT_LE(packed.bytes(), least + least / 16);
+}
+
+TEST(Packed, PackedAgainInPlace) {
+  auto v = bodies(3'000);
+  dyn::bh32::Packed packed{tree(v), v.begin()};
+  std::vector<void const *> storage;
+  packed.place([&storage](auto s) { storage.push_back(s.data()); });
+  // Fewer particles, moved a little: the same storage, and the same nodes as
+  // packed anew.
+  v.resize(v.size() - 100);
+  for (auto &&b : v)
+    b.xy *= 1.001f, b.morton = dyn::bh32::morton(b.xy);
+  std::ranges::sort(v, {}, &Body::morton);
+  auto const t = tree(v);
+  ASSERT_FALSE(packed.pack(t, v.begin()));
+  packed.place([&storage](auto s) { storage.push_back(s.data()); });
+  ASSERT_EQ(storage[0], storage[2]);
+  ASSERT_EQ(storage[1], storage[3]);
+  dyn::bh32::Packed const anew{t, v.begin()};
+  std::vector<dyn::bh32::View> a, b;
+  packed.depth_first([&a](auto &&view) { return a.push_back(view), true; });
+  anew.depth_first([&b](auto &&view) { return b.push_back(view), true; });
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t k = 0; k < a.size(); k++) {
+    ASSERT_EQ(a[k].circle, b[k].circle);
+    ASSERT_EQ(a[k].mass, b[k].mass);
+  }
+  for (size_t i = 0; i < v.size(); i++)
+    ASSERT_EQ(packed.leaf(i), anew.leaf(i));
+  // Many more: new storage.
+  auto w = bodies(6'000);
+  ASSERT_TRUE(packed.pack(tree(w), w.begin()));
+}
+
+TEST(Packed, TableForcesNearlyExact) {
+  // The forces of the table's steps, over the packed tree, within the error of
+  // the angle threshold (the rounding of the circles adds next to nothing).
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 5'000;
+  auto t = main_program::galaxies(c, 3);
+  auto exact = t;
+  exact.tan_angle_threshold = 0.0f;
+  t.index(), exact.index();
+  float da{}, scale{};
+  for (size_t i = 0; i < t.size(); i++) {
+    auto const a = t.acceleration(i), b = exact.acceleration(i);
+    da = std::max(da, std::abs(a - b)), scale = std::max(scale, std::abs(b));
+  }
+  std::printf("forces off by up to %.3g of the largest\n", da / scale);
+  ASSERT_LT(da, 0.05f * scale);
+}
+
+TEST(Packed, Empty) {
+  std::vector<Body> v;
+  dyn::bh32::Packed const packed{tree(v), v.begin()};
+  ASSERT_FALSE(packed);
+  auto visited = false;
+  packed.depth_first([&](auto &&) { return visited = true; });
+  ASSERT_FALSE(visited);
+}
@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdint>
+
+#include <philox.h>
+
+// Known-answer vectors from the Random123 distribution (kat_vectors).
+
+TEST(Philox, KnownAnswer0) {
+  dyn::Philox<> g{0, 0};
+  dyn::Philox<>::Block e{0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8};
+  ASSERT_EQ(e, g({0, 0, 0, 0}));
+}
+
+TEST(Philox, KnownAnswer1) {
+  dyn::Philox<> g{0xffffffff, 0xffffffff};
+  dyn::Philox<>::Block e{0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd};
+  ASSERT_EQ(e, g({0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff}));
+}
+
+TEST(Philox, KnownAnswer2) {
+  dyn::Philox<> g{0xa4093822, 0x299f31d0};
+  dyn::Philox<>::Block e{0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1};
+  ASSERT_EQ(e, g({0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344}));
+}
+
+TEST(Philox, PureFunction) {
+  // Item 12345's draws do not depend on what was drawn before.
+  dyn::Philox<> g{2024};
+  auto a = g.stream(12345, 1);
+  for (auto i = 0; i < 1000; i++)
+    (void)g.stream(i, 1).uniform();
+  auto b = g.stream(12345, 1);
+  for (auto i = 0; i < 10; i++)
+    ASSERT_EQ(a.bits(), b.bits()) << "(i = " << i << ")";
+  // Different purposes give different streams.
+  ASSERT_NE(g.stream(7, 0).bits(), g.stream(7, 1).bits());
+}
+
+TEST(Philox, Moments) {
+  dyn::Philox<> g{7};
+  auto constexpr N = 200'000;
+  double su{}, sn{}, sn2{};
+  for (auto i = 0; i < N; i++) {
+    auto s = g.stream(i);
+    auto u = s.uniform();
+    ASSERT_GT(u, 0.0f);
+    ASSERT_LT(u, 1.0f);
+    auto z = s.normal();
+    su += u, sn += z, sn2 += double(z) * z;
+  }
+  ASSERT_NEAR(0.5, su / N, 0.005);
+  ASSERT_NEAR(0.0, sn / N, 0.01);
+  ASSERT_NEAR(1.0, sn2 / N, 0.01);
+}
@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <query.h>
+
+#include "Table.h"
+#include "initial.h"
+#include "tables.h"
+
+namespace {
+
+/// Indices of the particles visited, sorted.
+std::vector<size_t> indices(phy::Table<> const &t, auto &&query) {
+  std::vector<size_t> v;
+  query([&](auto &&p) { v.push_back(size_t(&p - t.data())); });
+  std::ranges::sort(v);
+  return v;
+}
+
+std::vector<std::complex<float>> const POINTS{
+    {0.0f, 0.0f}, {1.0f, -0.5f}, {-2.0f, 1.5f}, {0.3f, 0.7f}, {20.0f, 0.0f}};
+
+} // namespace
+
+TEST(Query, RangeSameAsTestingEveryParticle) {
+  auto const table = tests::stepped(3'000, 7);
+  auto copy = table; // (Without the tree.)
+  ASSERT_TRUE(table.indexed());
+  ASSERT_FALSE(copy.indexed());
+  std::complex<float> const ll{-1.5f, -2.0f}, gg{2.5f, 0.5f};
+  auto const a = indices(table, [&](auto &&f) { table.range(ll, gg, f); });
+  auto const b = indices(copy, [&](auto &&f) { copy.range(ll, gg, f); });
+  ASSERT_FALSE(a.empty());
+  ASSERT_EQ(b, a);
+}
+
+TEST(Query, WithinSameAsTestingEveryParticle) {
+  auto const table = tests::stepped(3'000, 7);
+  auto copy = table;
+  for (auto xy : POINTS)
+    for (auto r : {0.05f, 0.5f, 3.0f}) {
+      auto const a =
+          indices(table, [&](auto &&f) { table.within(xy, r, f); });
+      auto const b = indices(copy, [&](auto &&f) { copy.within(xy, r, f); });
+      ASSERT_EQ(b, a) << "(at " << xy << ", radius " << r << ")";
+    }
+}
+
+TEST(Query, NearestSameAsSorting) {
+  auto table = tests::stepped(3'000, 7);
+  auto copy = table;
+  auto const distance = [&table](size_t i, std::complex<float> xy) {
+    return std::abs(table[i].xy - xy);
+  };
+  for (auto xy : POINTS)
+    for (size_t k : {1, 7, 100}) {
+      auto const a = table.nearest(xy, k), b = copy.nearest(xy, k);
+      ASSERT_EQ(k, a.size());
+      ASSERT_EQ(k, b.size());
+      // (Same distances, whatever the order of ties.)
+      for (size_t i = 0; i < k; i++)
+        ASSERT_EQ(distance(b[i], xy), distance(a[i], xy));
+    }
+  // Asking for more than there are.
+  ASSERT_EQ(table.size(), table.nearest({}, table.size() + 5).size());
+}
+
+TEST(Query, BatchedSameAsOneByOne) {
+  // A tree of points, with the least the queries need of its groups.
+  struct Dot {
+    std::complex<float> xy;
+    std::optional<uint64_t> morton;
+  };
+  using I = std::vector<Dot>::iterator;
+  struct Bound {
+    std::complex<float> xy;
+    float radius{};
+    I first, last;
+    Bound() = default;
+    Bound(I first, I last) : xy{first->xy}, first{first}, last{last} {
+      for (auto i = first; i != last; ++i)
+        radius = std::max(radius, std::abs(i->xy - xy));
+    }
+    Bound &operator+=(Bound const &b) {
+      radius = std::max(radius, std::abs(b.xy - xy) + b.radius);
+      last = b.last;
+      return *this;
+    }
+    [[nodiscard]] dyn::Circle<float> circle() const { return {xy, radius}; }
+  };
+  std::vector<Dot> dots;
+  for (auto &&p : tests::stepped(2'000, 7))
+    dots.push_back({p.xy, dyn::bh32::morton(p.xy)});
+  std::ranges::sort(dots, {}, &Dot::morton);
+  auto const tree = dyn::bh32::tree<Bound>(
+      dots.begin(), dots.end(),
+      [](Dot const &d, uint64_t m) -> std::optional<uint64_t> {
+        return d.morton ? std::optional{*d.morton & m} : std::nullopt;
+      });
+
+  std::vector<std::complex<float>> points{POINTS};
+  for (auto i = 0; i < 200; i++)
+    points.push_back(std::polar(0.02f * float(i), 0.3f * float(i)));
+  std::vector<std::vector<I>> within, nearest;
+  dyn::bh32::within(tree, std::span{points}, 0.4f, within);
+  dyn::bh32::nearest(tree, std::span{points}, 5, nearest);
+  ASSERT_EQ(points.size(), within.size());
+  ASSERT_EQ(points.size(), nearest.size());
+  std::vector<I> one;
+  for (size_t i = 0; i < points.size(); i++) {
+    one.clear();
+    dyn::bh32::within(tree, points[i], 0.4f, [&](Dot &d) {
+      one.push_back(dots.begin() + (&d - dots.data()));
+    });
+    std::ranges::sort(one), std::ranges::sort(within[i]);
+    ASSERT_EQ(one, within[i]);
+    dyn::bh32::nearest(tree, points[i], 5, one);
+    ASSERT_EQ(one, nearest[i]);
+  }
+}
+
+TEST(Query, OverlapsSameAsTestingEveryPair) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 15'000;
+  auto table = main_program::galaxies(c, 7);
+  // Larger particles, for many overlaps.
+  for (auto &&p : table)
+    p.radius *= 4.0f;
+  table.step(1.0f / 90.0f);
+  std::vector<std::pair<size_t, size_t>> expected;
+  for (size_t i = 0; i < table.size(); i++)
+    for (size_t j = i + 1; j < table.size(); j++) {
+      auto const r = table[i].radius + table[j].radius;
+      if (std::norm(table[i].xy - table[j].xy) < r * r)
+        expected.emplace_back(i, j);
+    }
+  ASSERT_TRUE(table.indexed());
+  auto found = table.overlaps();
+  ASSERT_GT(expected.size(), 100u);
+  std::ranges::sort(found);
+  ASSERT_EQ(expected, found);
+}
@@ -0,0 +1,83 @@
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "Table.h"
+#include "initial.h"
+#include "replay.h"
+#include "trajectory.h"
+
+namespace {
+
+namespace tr = phy::trajectory;
+
+/// Record `frames` steps of a table, each frame.
+void record(std::string const &path, size_t frames) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 2'000;
+  auto t = main_program::plummer(c, 4);
+  tr::Recorder r{path, {1, 2, t.size(), tr::Recorder::Overflow::block}};
+  for (size_t i = 0; i < frames; i++) {
+    t.step(1.0f / 90.0f);
+    r.record(t, i, double(i) / 90.0);
+  }
+}
+
+std::vector<tr::Frame> decode_all(std::string const &path) {
+  tr::Reader const reader{path};
+  std::vector<tr::Frame> frames(reader.size());
+  for (size_t i = 0; i < frames.size(); i++)
+    EXPECT_TRUE(reader.decode(i, frames[i])) << "(frame " << i << ")";
+  return frames;
+}
+
+void expect_same(std::vector<tr::Frame> const &a,
+                 std::vector<tr::Frame> const &b) {
+  ASSERT_EQ(a.size(), b.size());
+  for (size_t i = 0; i < a.size(); i++) {
+    ASSERT_EQ(a[i].step, b[i].step);
+    ASSERT_EQ(a[i].particles.size(), b[i].particles.size());
+    for (size_t k = 0; k < a[i].particles.size(); k++) {
+      ASSERT_EQ(a[i].particles[k].xy, b[i].particles[k].xy);
+      ASSERT_EQ(a[i].particles[k].v, b[i].particles[k].v);
+    }
+  }
+}
+
+} // namespace
+
+TEST(Replay, EveryFrameWithOrWithoutTheIndex) {
+  auto const path =
+      (std::filesystem::temp_directory_path() / "grass_replay.trj").string();
+  auto constexpr N = 12;
+  record(path, N);
+  auto const frames = decode_all(path);
+  ASSERT_EQ(frames.size(), size_t(N));
+  for (size_t i = 0; i < frames.size(); i++) {
+    ASSERT_EQ(frames[i].step, i);
+    ASSERT_EQ(frames[i].time, double(i) / 90.0);
+    ASSERT_FALSE(frames[i].particles.empty());
+  }
+  // (Frames differ from one step to the next.)
+  ASSERT_NE(frames.front().particles.front().xy,
+            frames.back().particles.front().xy);
+
+  // Without the trailer (as if the recorder had been killed while writing
+  // it), and without the index either: the same frames, found by walking.
+  auto const size = std::filesystem::file_size(path);
+  std::filesystem::resize_file(path, size - sizeof(tr::Trailer));
+  expect_same(frames, decode_all(path));
+  std::filesystem::resize_file(path, size - sizeof(tr::Trailer) -
+                                         N * sizeof(uint64_t));
+  expect_same(frames, decode_all(path));
+  // And with the last frame cut short, the frames before it.
+  std::filesystem::resize_file(path, size - sizeof(tr::Trailer) -
+                                         N * sizeof(uint64_t) - 1);
+  auto const cut = decode_all(path);
+  expect_same({frames.begin(), frames.end() - 1}, cut);
+  std::filesystem::remove(path);
+}
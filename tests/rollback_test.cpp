@@ -0,0 +1,78 @@
+#include "gtest/gtest.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include "rollback.h"
+
+namespace {
+
+/// A toy system: x grows with time, and a step of more than `limit` taken
+/// past x = 1 gives NaN.
+struct Toy {
+  double x{};
+  float limit{};
+  int copies{};
+
+  Toy() = default;
+  explicit Toy(float limit) : limit{limit} {}
+  Toy(Toy const &t) = default;
+  Toy &operator=(Toy const &t) {
+    x = t.x, limit = t.limit, ++copies;
+    return *this;
+  }
+
+  [[nodiscard]] bool good() const { return std::isfinite(x); }
+};
+
+auto const advance = [](Toy &t, float dt) {
+  t.x = t.x > 1.0 && dt > t.limit ? std::numeric_limits<double>::quiet_NaN()
+                                   : t.x + dt;
+};
+
+} // namespace
+
+TEST(Rollback, RecoversInSmallerSteps) {
+  phy::rollback::Ring<Toy> ring{{4, 2, 3}};
+  Toy t{0.2f};
+  uint64_t i = 1;
+  for (; t.x <= 1.0; i++)
+    ASSERT_TRUE(ring.step(t, i, 0.5f, advance));
+  // x = 1.5 now: the next step goes wrong, and in halves too; in quarters,
+  // it does not.
+  ASSERT_TRUE(ring.step(t, i, 0.5f, advance));
+  ASSERT_DOUBLE_EQ(0.5 * double(i), t.x);
+  auto &&s = ring.stats();
+  ASSERT_EQ(1u, s.rollbacks);
+  ASSERT_EQ(1u, s.recovered);
+  ASSERT_EQ(i, s.step);
+  ASSERT_EQ(2u, s.halvings);
+}
+
+TEST(Rollback, GivesUp) {
+  phy::rollback::Ring<Toy> ring{{4, 2, 3}};
+  Toy t{0.01f};
+  uint64_t i = 1;
+  for (; t.x <= 1.0; i++)
+    ASSERT_TRUE(ring.step(t, i, 0.5f, advance));
+  ASSERT_FALSE(ring.step(t, i, 0.5f, advance));
+  ASSERT_EQ(1u, ring.stats().rollbacks);
+  ASSERT_EQ(0u, ring.stats().recovered);
+  // Without copies, no rollback.
+  phy::rollback::Ring<Toy> none{{4, 0, 3}};
+  Toy u{0.3f};
+  u.x = 2.0;
+  ASSERT_FALSE(none.step(u, 1, 0.5f, advance));
+  ASSERT_EQ(0u, none.stats().rollbacks);
+}
+
+TEST(Rollback, CopiesOnlyEveryFewSteps) {
+  phy::rollback::Ring<Toy> ring{{8, 2, 3}};
+  Toy t;
+  for (uint64_t i = 1; i <= 64; i++)
+    ASSERT_TRUE(ring.step(t, i, 0.001f, advance));
+  // Copies of t were assigned into the ring (t itself never was).
+  ASSERT_EQ(0, t.copies);
+  ASSERT_EQ(0u, ring.stats().rollbacks);
+}
@@ -0,0 +1,67 @@
+#include "gtest/gtest.h"
+
+#include <complex>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "shm.h"
+
+namespace {
+
+struct Body {
+  std::complex<float> xy, v;
+  float mass{1.0f}, radius{1.0f};
+};
+
+std::string unique_name() {
+  return "grass_test_" + std::to_string(::getpid());
+}
+
+} // namespace
+
+TEST(Shm, RoundTrip) {
+  auto const name = unique_name();
+  phy::shm::Publisher publisher{name, 2};
+  phy::shm::Reader const reader{name};
+  phy::shm::Snapshot s;
+  ASSERT_FALSE(reader.read(s));
+
+  std::vector<Body> bodies{{{1.0f, 2.0f}, {3.0f, 4.0f}, 5.0f, 6.0f},
+                           {{-1.0f, -2.0f}, {0.5f, 0.25f}, 2.0f, 0.5f},
+                           {{9.0f, 9.0f}, {}, 1.0f, 1.0f}};
+  publisher.publish(bodies, {7, 0.5, bodies.size(), {}, 1.5, 2.5});
+  ASSERT_TRUE(reader.read(s));
+  ASSERT_EQ(1u, s.number);
+  ASSERT_EQ(7u, s.stats.step);
+  ASSERT_EQ(3u, s.stats.particles);
+  // Only as many as fit.
+  ASSERT_EQ(2u, s.stats.published);
+  ASSERT_EQ(2u, s.particles.size());
+  auto &&r = s.particles[1];
+  ASSERT_EQ(-1.0f, r.x);
+  ASSERT_EQ(-2.0f, r.y);
+  ASSERT_EQ(0.5f, r.vx);
+  ASSERT_EQ(0.25f, r.vy);
+  ASSERT_EQ(2.0f, r.mass);
+  ASSERT_EQ(0.5f, r.radius);
+
+  // The next snapshot goes to the other slot.
+  bodies.resize(1);
+  publisher.publish(bodies, {8, 0.75, 1, {}, 1.0, 3.0});
+  ASSERT_TRUE(reader.read(s));
+  ASSERT_EQ(2u, s.number);
+  ASSERT_EQ(1u, s.particles.size());
+  ASSERT_FALSE(reader.finished());
+}
+
+TEST(Shm, FinishedAndRemoved) {
+  auto const name = unique_name();
+  auto publisher = std::make_unique<phy::shm::Publisher>(name, 8);
+  phy::shm::Reader const reader{name};
+  publisher.reset();
+  ASSERT_TRUE(reader.finished());
+  ASSERT_THROW(phy::shm::Reader{name}, std::runtime_error);
+}
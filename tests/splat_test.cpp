@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include <complex>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "splat.h"
+
+namespace {
+
+struct Dot {
+  std::complex<float> xy;
+  float mass{1.0f}, radius{0.1f};
+};
+
+float total(phy::splat::Image const &image) {
+  auto sum = 0.0;
+  for (auto y = 0; y < image.height(); y++)
+    for (auto x = 0; x < image.width(); x++)
+      sum += image(x, y);
+  return float(sum);
+}
+
+} // namespace
+
+TEST(Splat, Checksums) {
+  auto const s = std::string{"123456789"};
+  auto const *p = reinterpret_cast<uint8_t const *>(s.data());
+  ASSERT_EQ(0xCBF43926u, phy::splat::detail::crc32(p, s.size()));
+  ASSERT_EQ(0x091E01DEu, phy::splat::detail::adler32(p, s.size()));
+}
+
+TEST(Splat, MassIsConserved) {
+  // Dots well inside the image keep their mass, whatever their size.
+  std::vector<Dot> dots{{{0.0f, 0.0f}, 2.0f, 0.01f},
+                        {{1.0f, -0.5f}, 3.0f, 0.5f},
+                        {{-1.3f, 1.1f}, 0.5f, 0.2f}};
+  auto const camera = phy::splat::Camera::fit(200, 100);
+  auto image = phy::splat::render(dots, camera, 200, 100);
+  ASSERT_NEAR(5.5f, total(image), 1e-3f);
+  // Off the image: nothing.
+  std::vector<Dot> far{{{100.0f, 0.0f}}};
+  ASSERT_EQ(0.0f, total(phy::splat::render(far, camera, 200, 100)));
+}
+
+TEST(Splat, SameWithAnyBuffers) {
+  std::vector<Dot> dots;
+  for (auto i = 0; i < 1000; i++)
+    dots.push_back({std::polar(0.002f * float(i), 0.1f * float(i))});
+  auto const camera = phy::splat::Camera::fit(64, 64);
+  auto a = phy::splat::render(dots, camera, 64, 64, {1});
+  auto b = phy::splat::render(dots, camera, 64, 64, {7});
+  for (auto y = 0; y < 64; y++)
+    for (auto x = 0; x < 64; x++)
+      ASSERT_NEAR(a(x, y), b(x, y), 1e-4f * (1.0f + a(x, y)));
+}
+
+TEST(Splat, CameraLikeRaylib) {
+  // Screen = (world - target) * zoom + offset.
+  phy::splat::Camera c{{1.0f, 2.0f}, {50.0f, 40.0f}, 10.0f};
+  ASSERT_EQ(std::complex(60.0f, 30.0f), c.to_screen({2.0f, 1.0f}));
+}
@@ -0,0 +1,41 @@
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <thread>
+
+#include <spsc.h>
+
+TEST(Spsc, FullAndEmpty) {
+  dyn::Spsc<int, 4> q;
+  ASSERT_FALSE(q.pop());
+  for (auto i = 0; i < 4; i++)
+    ASSERT_TRUE(q.push(i));
+  ASSERT_FALSE(q.push(4));
+  ASSERT_EQ(0, q.pop());
+  ASSERT_TRUE(q.push(4));
+  for (auto i = 1; i <= 4; i++)
+    ASSERT_EQ(i, q.pop());
+  ASSERT_FALSE(q.pop());
+}
+
+TEST(Spsc, InOrderAcrossThreads) {
+  dyn::Spsc<uint64_t, 64> q;
+  auto constexpr N = uint64_t(200'000);
+  std::thread producer{[&q] {
+    for (uint64_t i = 0; i < N;)
+      if (q.push(i))
+        ++i;
+      else
+        std::this_thread::yield();
+  }};
+  uint64_t expected{};
+  while (expected < N) {
+    auto i = q.pop();
+    if (!i) {
+      std::this_thread::yield();
+      continue;
+    }
+    ASSERT_EQ(expected++, *i);
+  }
+  producer.join();
+}
@@ -0,0 +1,27 @@
+#ifndef GRASS_TESTS_TABLES_H
+#define GRASS_TESTS_TABLES_H
+
+/// @file tables.h
+/// @brief The stepped table the query and visible tests start from.
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Table.h"
+#include "initial.h"
+
+namespace tests {
+
+/// About `n` particles in clumps (see `galaxies`) that have taken a step, so
+/// that the table has a tree, a step old.
+inline phy::Table<> stepped(size_t n, uint64_t seed) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 5 * n;
+  auto table = main_program::galaxies(c, seed);
+  table.step(1.0f / 90.0f);
+  return table;
+}
+
+} // namespace tests
+
+#endif // GRASS_TESTS_TABLES_H
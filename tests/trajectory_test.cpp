@@ -0,0 +1,146 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "Table.h"
+#include "initial.h"
+#include "replay.h"
+#include "trajectory.h"
+
+namespace {
+
+namespace tr = phy::trajectory;
+
+/// A frame of a stepped table, with a particle far away and one at NaN.
+tr::Frame stepped_frame() {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 5'000;
+  auto t = main_program::galaxies(c, 5);
+  t.step(1.0f / 90.0f);
+  tr::Frame f{7, 0.5, {}};
+  for (auto &&p : t)
+    f.particles.push_back({p.xy, p.v, p.mass, p.radius});
+  auto const nan = std::numeric_limits<float>::quiet_NaN();
+  f.particles.push_back({{1e12f, -3.0f}, {0.5f, 0.25f}, 2.0f, 0.125f});
+  f.particles.push_back({{nan, 1.0f}, {1.0f, nan}, 1.0f, 1.0f});
+  return f;
+}
+
+/// Split an encoded frame into its header and its payload.
+tr::FrameHeader split(std::vector<std::byte> const &encoded,
+                      std::span<std::byte const> &payload) {
+  tr::FrameHeader fh;
+  std::memcpy(&fh, encoded.data(), sizeof fh);
+  payload = std::span{encoded}.subspan(sizeof fh);
+  return fh;
+}
+
+} // namespace
+
+TEST(Trajectory, RoundTrip) {
+  auto const f = stepped_frame();
+  tr::Header const h;
+  std::vector<std::byte> out;
+  std::vector<std::pair<uint64_t, uint32_t>> scratch;
+  tr::encode(f, h, out, scratch);
+  std::span<std::byte const> payload;
+  auto const fh = split(out, payload);
+  ASSERT_EQ(fh.magic, tr::FRAME_MAGIC);
+  ASSERT_EQ(fh.bytes, payload.size());
+  ASSERT_EQ(fh.keyed + fh.loose, f.particles.size());
+  ASSERT_EQ(fh.loose, 2u);
+  // Less than the samples themselves (about half).
+  ASSERT_LT(out.size(), f.particles.size() * sizeof(tr::Sample) * 2 / 3);
+
+  tr::Frame g;
+  ASSERT_TRUE(tr::decode(fh, payload, h, g));
+  ASSERT_EQ(g.step, f.step);
+  ASSERT_EQ(g.time, f.time);
+  ASSERT_EQ(g.particles.size(), f.particles.size());
+  // In Morton order: find each particle by its nearest decoded one.
+  std::vector<tr::Sample> sorted{g.particles.begin(),
+                                 g.particles.begin() + fh.keyed};
+  auto const cell = 1.0f / float(tr::PRECISION);
+  for (size_t i = 0; i + 2 < f.particles.size(); i++) {
+    auto &&s = f.particles[i];
+    auto const z = dyn::bh32::morton<tr::PRECISION>(s.xy).value();
+    auto const near = std::ranges::min_element(sorted, {}, [&](auto &&d) {
+      return std::abs(d.xy - s.xy);
+    });
+    ASSERT_EQ(dyn::bh32::morton<tr::PRECISION>(near->xy).value(), z);
+    // Within a step of the offsets, of the velocity quantum, and of the
+    // logarithm quantum.
+    ASSERT_LE(std::abs(near->xy - s.xy), 2.0f * cell / 32767.0f);
+    ASSERT_LE(std::abs(near->v.real() - s.v.real()), h.velocity_quantum);
+    ASSERT_LE(std::abs(near->v.imag() - s.v.imag()), h.velocity_quantum);
+    ASSERT_NEAR(near->mass / s.mass, 1.0f, 2.0f * h.log_quantum);
+    ASSERT_NEAR(near->radius / s.radius, 1.0f, 2.0f * h.log_quantum);
+  }
+  // The loose ones as they were (NaN included).
+  auto &&far = g.particles[fh.keyed];
+  auto &&nan = g.particles[fh.keyed + 1];
+  ASSERT_EQ(far.xy, (std::complex<float>{1e12f, -3.0f}));
+  ASSERT_EQ(far.radius, 0.125f);
+  ASSERT_TRUE(std::isnan(nan.xy.real()));
+  ASSERT_TRUE(std::isnan(nan.v.imag()));
+  ASSERT_EQ(nan.xy.imag(), 1.0f);
+}
+
+TEST(Trajectory, TruncatedPayloadIsMalformed) {
+  auto const f = stepped_frame();
+  tr::Header const h;
+  std::vector<std::byte> out;
+  std::vector<std::pair<uint64_t, uint32_t>> scratch;
+  tr::encode(f, h, out, scratch);
+  std::span<std::byte const> payload;
+  auto const fh = split(out, payload);
+  tr::Frame g;
+  for (size_t cut : {size_t(1), size_t(17), payload.size() / 2,
+                     payload.size()})
+    ASSERT_FALSE(tr::decode(fh, payload.first(payload.size() - cut), h, g))
+        << "(" << cut << " bytes cut)";
+  // (Nor with bytes to spare.)
+  auto longer = out;
+  longer.push_back(std::byte{});
+  ASSERT_FALSE(tr::decode(fh, std::span{longer}.subspan(sizeof fh), h, g));
+}
+
+TEST(Trajectory, RecorderDropsOrWaits) {
+  auto const path =
+      (std::filesystem::temp_directory_path() / "grass_trajectory.trj")
+          .string();
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = 50'000;
+  auto const t = main_program::galaxies(c, 3);
+  auto constexpr OFFERED = 40;
+  for (auto overflow : {tr::Recorder::Overflow::drop,
+                        tr::Recorder::Overflow::block}) {
+    uint64_t dropped{}, queued{};
+    {
+      tr::Recorder r{path, {2, 1, t.size(), overflow}};
+      for (auto i = 0; i < OFFERED; i++)
+        queued += r.record(t, uint64_t(i), double(i));
+      dropped = r.dropped();
+      ASSERT_TRUE(r.good());
+    }
+    // Every other step offered; each either written or dropped.
+    ASSERT_EQ(queued + dropped, OFFERED / 2);
+    if (overflow == tr::Recorder::Overflow::block) {
+      ASSERT_EQ(dropped, 0u);
+    }
+    tr::Reader const reader{path};
+    ASSERT_EQ(reader.size(), queued);
+    ASSERT_EQ(reader.header().every, 2u);
+  }
+  std::filesystem::remove(path);
+}
@@ -0,0 +1,46 @@
+#include "gtest/gtest.h"
+
+#include <array>
+#include <cstdint>
+#include <thread>
+
+#include <triple_buffer.h>
+
+TEST(TripleBuffer, Latest) {
+  dyn::TripleBuffer<int> b;
+  ASSERT_FALSE(b.refresh());
+  ASSERT_EQ(0, b.front());
+  b.back() = 1, b.publish();
+  b.back() = 2, b.publish();
+  ASSERT_TRUE(b.refresh());
+  ASSERT_EQ(2, b.front());
+  ASSERT_FALSE(b.refresh());
+  ASSERT_EQ(2, b.front());
+}
+
+TEST(TripleBuffer, WholeValuesAcrossThreads) {
+  // Each value is an array of copies of a counter; the reader must never see
+  // a mix of two values, nor an older value after a newer one.
+  using Value = std::array<uint64_t, 64>;
+  dyn::TripleBuffer<Value> b;
+  auto constexpr N = uint64_t(20'000);
+  std::thread writer{[&b] {
+    for (uint64_t i = 1; i <= N; i++) {
+      b.back().fill(i);
+      b.publish();
+    }
+  }};
+  uint64_t last{};
+  while (last < N) {
+    if (!b.refresh()) {
+      std::this_thread::yield();
+      continue;
+    }
+    auto const &v = b.front();
+    for (auto x : v)
+      ASSERT_EQ(v[0], x);
+    ASSERT_GT(v[0], last);
+    last = v[0];
+  }
+  writer.join();
+}
@@ -0,0 +1,84 @@
+#include "gtest/gtest.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Table.h"
+#include "initial.h"
+#include "view.h"
+
+namespace {
+
+phy::Table<> clumps(size_t n) {
+  main_program::Constants c;
+  c.PARTICLES_LIMIT = n;
+  return main_program::galaxies(c, 5);
+}
+
+} // namespace
+
+TEST(View, SpanSameAsTheTable) {
+  auto table = clumps(5'000);
+  std::vector<phy::Particle> mine{table.begin(), table.end()};
+  phy::view::Stepper stepper{table};
+  auto const dt = 1.0f / 90.0f;
+  for (auto k = 0; k < 3; k++) {
+    table.step(dt);
+    stepper.step(phy::view::Span{mine}, dt);
+    // The same particles, to the bit, in their own order.
+    auto const order = stepper.order();
+    ASSERT_EQ(order.size(), table.size());
+    for (size_t i = 0; i < table.size(); i++) {
+      auto &&p = mine[order[i]];
+      ASSERT_EQ(table[i].xy, p.xy) << "(i = " << i << ")";
+      ASSERT_EQ(table[i].v, p.v) << "(i = " << i << ")";
+      ASSERT_EQ(table[i].morton, p.morton) << "(i = " << i << ")";
+    }
+    // Sorted as the table's, for the next step.
+    phy::view::permute(phy::view::Span{mine}, order);
+    for (size_t i = 0; i < table.size(); i++)
+      ASSERT_EQ(table[i].mass, mine[i].mass);
+  }
+}
+
+TEST(View, SoaSameAsSpan) {
+  auto const table = clumps(3'000);
+  std::vector<phy::Particle> aos{table.begin(), table.end()};
+  auto const n = aos.size();
+  std::vector<float> x(n), y(n), vx(n), vy(n), mass(n), radius(n);
+  std::vector<uint64_t> keys(n);
+  for (size_t i = 0; i < n; i++) {
+    x[i] = aos[i].xy.real(), y[i] = aos[i].xy.imag();
+    vx[i] = aos[i].v.real(), vy[i] = aos[i].v.imag();
+    mass[i] = aos[i].mass, radius[i] = aos[i].radius;
+  }
+  phy::view::Soa soa{x, y, vx, vy, mass, radius, keys};
+  phy::view::Stepper a{table}, b{table};
+  for (auto k = 0; k < 2; k++) {
+    a.step(phy::view::Span{aos}, 0.01f);
+    b.step(soa, 0.01f);
+  }
+  for (size_t i = 0; i < n; i++) {
+    ASSERT_EQ(aos[i].xy, soa.xy(i));
+    ASSERT_EQ(aos[i].v, soa.v(i));
+    ASSERT_EQ(aos[i].morton.value_or(0), keys[i]);
+  }
+  // Sorted in place, along with their masses and radii.
+  phy::view::permute(soa, b.order());
+  for (size_t i = 1; i < n; i++)
+    ASSERT_LE(keys[i - 1], keys[i]);
+  for (size_t i = 0; i < n; i++) {
+    auto &&p = aos[b.order()[i]];
+    ASSERT_EQ(p.xy, soa.xy(i));
+    ASSERT_EQ(p.mass, soa.mass(i));
+    ASSERT_EQ(p.radius, soa.radius(i));
+  }
+}
+
+TEST(View, Empty) {
+  phy::view::Stepper stepper;
+  std::vector<phy::Particle> none;
+  stepper.step(phy::view::Span{none}, 0.1f);
+  ASSERT_TRUE(stepper.order().empty());
+}
@@ -0,0 +1,61 @@
+#include "gtest/gtest.h"
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+#include "Table.h"
+#include "tables.h"
+
+namespace {
+
+/// Indices of the particles `visible` reports.
+std::vector<size_t> visible(phy::Table<> const &t, std::complex<float> ll,
+                            std::complex<float> gg, float lod = 0.0f) {
+  std::vector<size_t> v;
+  t.visible(
+      ll, gg, lod, [&](auto &&p) { v.push_back(size_t(&p - t.data())); },
+      [](auto &&, float) {});
+  return v;
+}
+
+} // namespace
+
+TEST(Visible, SameAsTestingEveryParticle) {
+  auto const table = tests::stepped(3'000, 2024);
+  std::complex<float> const ll{-1.5f, -2.0f}, gg{2.5f, 0.5f};
+  std::vector<bool> expected(table.size());
+  for (size_t i = 0; i < table.size(); i++)
+    expected[i] = dyn::intersect::disk_rectangle(table[i].circle(), ll, gg);
+  std::vector<bool> found(table.size());
+  for (auto i : visible(table, ll, gg)) {
+    ASSERT_FALSE(found[i]) << "(reported twice: " << i << ")";
+    found[i] = true;
+  }
+  ASSERT_EQ(expected, found);
+}
+
+TEST(Visible, GroupsHoldTheirParticles) {
+  // Zoomed out: everything is visible, and each particle is either reported
+  // or inside a group that is.
+  auto const table = tests::stepped(3'000, 2024);
+  std::vector<dyn::Circle<float>> groups;
+  size_t particles{};
+  float mass{}, total{};
+  table.visible(
+      {-1e4f, -1e4f}, {1e4f, 1e4f}, 0.5f,
+      [&](auto &&p) { ++particles, mass += p.mass; },
+      [&](auto &&c, float m) { groups.push_back(c), mass += m; });
+  for (auto &&p : table)
+    total += p.mass;
+  ASSERT_FALSE(groups.empty());
+  ASSERT_LT(particles + groups.size(), table.size());
+  ASSERT_NEAR(total, mass, 1e-3f * total);
+}
+
+TEST(Visible, ChangedTableFallsBack) {
+  auto table = tests::stepped(300, 2024);
+  table.emplace_back(std::complex{100.0f, 100.0f}, 0.0f);
+  auto v = visible(table, {99.0f, 99.0f}, {101.0f, 101.0f});
+  ASSERT_EQ(std::vector<size_t>{table.size() - 1}, v);
+}